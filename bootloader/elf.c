@@ -0,0 +1,201 @@
+#include "elf.h"
+#include "string.h"
+#include "crc32c.h"
+
+static elf64_program_header program_headers[ELF_MAX_PROGRAM_HEADERS];
+static elf64_program_header* segments[ELF_MAX_SEGMENTS];
+
+// File bytes outside every segment (headers, padding) pass through here for elf_checksum()
+static uint8_t gap_buffer[512];
+
+// Helper functions
+
+static bool ranges_overlap(uint64_t start_a, uint64_t end_a, uint64_t start_b, uint64_t end_b) {
+    return start_a < end_b && start_b < end_a;
+}
+
+// Read exactly length bytes at offset
+static int read_exact(fat_file* file, uint64_t offset, uint64_t length, void* buffer) {
+    if (offset > file->file_size || length > file->file_size - offset) {
+        return ELF_ERROR_FORMAT; // Runs past the end of the file
+    }
+    if (length == 0) {
+        return 0;
+    }
+    if (fat_read_at(file, (uint32_t)offset, (uint32_t)length, (uint8_t*)buffer) != (int)length) {
+        return ELF_ERROR_IO;
+    }
+    return 0;
+}
+
+static int check_header(const elf64_header* header) {
+    if (header->magic != ELF_MAGIC) {
+        return ELF_ERROR_NOT_ELF;
+    }
+    if (header->file_class != ELF_CLASS_64 || header->data_encoding != ELF_DATA_LITTLE_ENDIAN ||
+        header->type != ELF_TYPE_EXECUTABLE || header->machine != ELF_MACHINE_AARCH64 ||
+        header->program_header_size != sizeof(elf64_program_header) ||
+        header->program_header_count == 0 || header->program_header_count > ELF_MAX_PROGRAM_HEADERS) {
+        return ELF_ERROR_FORMAT;
+    }
+    return 0;
+}
+
+// Check one PT_LOAD segment against the file, the layout and the segments before it
+static int check_segment(const fat_file* file, const elf64_program_header* segment,
+                         const elf_memory_layout* layout, uint32_t checked) {
+    if (segment->file_size > segment->memory_size ||
+        segment->offset > file->file_size || segment->file_size > file->file_size - segment->offset) {
+        return ELF_ERROR_FORMAT;
+    }
+
+    uint64_t start = segment->physical_address;
+    if (segment->memory_size > UINT64_MAX - start) {
+        return ELF_ERROR_PLACEMENT; // Wraps around
+    }
+    uint64_t end = start + segment->memory_size;
+
+    if (start < layout->ram_start || end > layout->ram_end ||
+        ranges_overlap(start, end, layout->reserved_start, layout->reserved_end)) {
+        return ELF_ERROR_PLACEMENT;
+    }
+    for (uint32_t i = 0; i < checked; i++) {
+        uint64_t other = segments[i]->physical_address;
+        if (ranges_overlap(start, end, other, other + segments[i]->memory_size)) {
+            return ELF_ERROR_PLACEMENT;
+        }
+    }
+
+    return 0;
+}
+
+// Library functions
+
+int elf_load(fat_file* file, const elf_memory_layout* layout, elf_image* image) {
+    if (file == NULL || layout == NULL || image == NULL || !file->is_open) {
+        return ELF_ERROR_IO; // Invalid parameters
+    }
+
+    elf64_header header;
+    if (file->file_size < sizeof(header)) {
+        return ELF_ERROR_NOT_ELF;
+    }
+    int result = read_exact(file, 0, sizeof(header), &header);
+    if (result < 0) {
+        return result;
+    }
+    result = check_header(&header);
+    if (result < 0) {
+        return result;
+    }
+
+    result = read_exact(file, header.program_header_offset,
+        (uint64_t)header.program_header_count * sizeof(elf64_program_header), program_headers);
+    if (result < 0) {
+        return result;
+    }
+
+    // Check every segment before writing anything, so a bad image cannot
+    // overwrite the bootloader halfway through loading
+    image->entry = header.entry;
+    image->lowest_address = UINT64_MAX;
+    image->highest_address = 0;
+    image->bytes_read = 0;
+    image->bytes_zeroed = 0;
+    image->segment_count = 0;
+
+    bool entry_loaded = false;
+    for (uint32_t i = 0; i < header.program_header_count; i++) {
+        elf64_program_header* segment = &program_headers[i];
+        if (segment->type != ELF_SEGMENT_LOAD || segment->memory_size == 0) {
+            continue;
+        }
+        if (image->segment_count == ELF_MAX_SEGMENTS) {
+            return ELF_ERROR_FORMAT;
+        }
+
+        result = check_segment(file, segment, layout, image->segment_count);
+        if (result < 0) {
+            return result;
+        }
+        segments[image->segment_count++] = segment;
+
+        uint64_t start = segment->physical_address;
+        uint64_t end = start + segment->memory_size;
+        if (start < image->lowest_address) {
+            image->lowest_address = start;
+        }
+        if (end > image->highest_address) {
+            image->highest_address = end;
+        }
+        if (header.entry >= start && header.entry < end) {
+            entry_loaded = true;
+        }
+    }
+    if (image->segment_count == 0 || !entry_loaded) {
+        return ELF_ERROR_FORMAT;
+    }
+
+    // Only the file bytes are read; the zero-filled tails (.bss, stack) never
+    // come from the disk
+    for (uint32_t i = 0; i < image->segment_count; i++) {
+        elf64_program_header* segment = segments[i];
+        uint8_t* destination = (uint8_t*)segment->physical_address;
+
+        result = read_exact(file, segment->offset, segment->file_size, destination);
+        if (result < 0) {
+            return ELF_ERROR_IO;
+        }
+        memset(destination + segment->file_size, 0, segment->memory_size - segment->file_size);
+
+        image->bytes_read += segment->file_size;
+        image->bytes_zeroed += segment->memory_size - segment->file_size;
+    }
+
+    return 0;
+}
+
+int elf_checksum(fat_file* file, const elf_image* image, uint32_t length, uint32_t* crc) {
+    if (file == NULL || image == NULL || crc == NULL || length > file->file_size) {
+        return ELF_ERROR_IO; // Invalid parameters
+    }
+
+    uint32_t value = 0;
+    uint64_t offset = 0;
+    while (offset < length) {
+        // Bytes of a loaded segment are taken from memory; segments may share
+        // file bytes, any one of them will do
+        const elf64_program_header* holder = NULL;
+        uint64_t next = length; // Where the next segment starts if none holds offset
+        for (uint32_t i = 0; i < image->segment_count; i++) {
+            const elf64_program_header* segment = segments[i];
+            if (offset >= segment->offset && offset < segment->offset + segment->file_size) {
+                holder = segment;
+                break;
+            }
+            if (segment->offset > offset && segment->offset < next) {
+                next = segment->offset;
+            }
+        }
+
+        uint64_t end;
+        if (holder != NULL) {
+            end = holder->offset + holder->file_size;
+            if (end > length) {
+                end = length;
+            }
+            const uint8_t* loaded = (const uint8_t*)holder->physical_address + (offset - holder->offset);
+            value = crc32c_update(value, loaded, end - offset);
+        } else {
+            end = next - offset > sizeof(gap_buffer) ? offset + sizeof(gap_buffer) : next;
+            if (read_exact(file, offset, end - offset, gap_buffer) < 0) {
+                return ELF_ERROR_IO;
+            }
+            value = crc32c_update(value, gap_buffer, end - offset);
+        }
+        offset = end;
+    }
+
+    *crc = value;
+    return 0;
+}
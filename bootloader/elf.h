@@ -0,0 +1,112 @@
+#ifndef ELF_H
+#define ELF_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "fat.h"
+
+// Loader for statically linked AArch64 ELF64 executables such as os.elf.
+// Only PT_LOAD segments are used: each segment's file bytes are read to its
+// physical address (p_paddr) and the rest of its memory is zeroed.
+
+#define ELF_MAGIC 0x464C457F // "\x7FELF" as a little-endian word
+#define ELF_CLASS_64 2
+#define ELF_DATA_LITTLE_ENDIAN 1
+#define ELF_TYPE_EXECUTABLE 2
+#define ELF_MACHINE_AARCH64 183
+#define ELF_SEGMENT_LOAD 1 // PT_LOAD
+
+// Program headers and PT_LOAD segments accepted per image
+#define ELF_MAX_PROGRAM_HEADERS 16
+#define ELF_MAX_SEGMENTS 8
+
+// elf_load() results
+#define ELF_ERROR_IO -1 // Reading the file failed
+#define ELF_ERROR_NOT_ELF -2 // No ELF magic; the file is something else
+#define ELF_ERROR_FORMAT -3 // ELF, but not a 64-bit little-endian AArch64 executable we can load
+#define ELF_ERROR_PLACEMENT -4 // A segment overlaps another, the reserved range, or leaves RAM
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic; // 0x00 - 0x03: ELF_MAGIC
+    uint8_t file_class; // 0x04: ELF_CLASS_64
+    uint8_t data_encoding; // 0x05: ELF_DATA_LITTLE_ENDIAN
+    uint8_t ident_version; // 0x06: 1
+    uint8_t os_abi; // 0x07: OS/ABI (ignored)
+    uint8_t padding[8]; // 0x08 - 0x0F: Rest of e_ident
+    uint16_t type; // 0x10 - 0x11: ELF_TYPE_EXECUTABLE
+    uint16_t machine; // 0x12 - 0x13: ELF_MACHINE_AARCH64
+    uint32_t version; // 0x14 - 0x17: 1
+    uint64_t entry; // 0x18 - 0x1F: Entry point
+    uint64_t program_header_offset; // 0x20 - 0x27: File offset of the program headers
+    uint64_t section_header_offset; // 0x28 - 0x2F: File offset of the section headers (unused)
+    uint32_t flags; // 0x30 - 0x33: Processor flags
+    uint16_t header_size; // 0x34 - 0x35: Size of this header
+    uint16_t program_header_size; // 0x36 - 0x37: Size of one program header
+    uint16_t program_header_count; // 0x38 - 0x39: Number of program headers
+    uint16_t section_header_size; // 0x3A - 0x3B: Size of one section header
+    uint16_t section_header_count; // 0x3C - 0x3D: Number of section headers
+    uint16_t section_names_index; // 0x3E - 0x3F: Section holding section names
+} elf64_header;
+
+typedef struct __attribute__((packed)) {
+    uint32_t type; // 0x00 - 0x03: ELF_SEGMENT_LOAD for loadable segments
+    uint32_t flags; // 0x04 - 0x07: Read/write/execute permissions
+    uint64_t offset; // 0x08 - 0x0F: File offset of the segment's bytes
+    uint64_t virtual_address; // 0x10 - 0x17: Address the code runs at
+    uint64_t physical_address; // 0x18 - 0x1F: Address to load the segment to
+    uint64_t file_size; // 0x20 - 0x27: Bytes in the file
+    uint64_t memory_size; // 0x28 - 0x2F: Bytes in memory; the rest past file_size is zeroed
+    uint64_t alignment; // 0x30 - 0x37: Required alignment
+} elf64_program_header;
+
+// Where an image may go: inside [ram_start, ram_end), outside [reserved_start, reserved_end)
+typedef struct {
+    uint64_t ram_start;
+    uint64_t ram_end;
+    uint64_t reserved_start;
+    uint64_t reserved_end;
+} elf_memory_layout;
+
+typedef struct {
+    uint64_t entry; // Address to jump to
+    uint64_t lowest_address; // First byte of the lowest segment
+    uint64_t highest_address; // Byte past the end of the highest segment
+    uint64_t bytes_read; // File bytes read into memory
+    uint64_t bytes_zeroed; // Bytes cleared past the end of the segments' file bytes
+    uint32_t segment_count; // PT_LOAD segments loaded
+} elf_image;
+
+/**
+ * @brief Loads an ELF executable from an open file into memory.
+ *
+ * Every PT_LOAD segment is checked before anything is written: it must fit in
+ * the file, lie inside the layout's RAM, stay clear of the reserved range (e.g.,
+ * the bootloader itself), and not overlap another segment. The entry point must
+ * fall inside a segment. Each segment's file bytes are then read to p_paddr with
+ * fat_read_at(), and its p_memsz - p_filesz tail is zeroed with memset().
+ *
+ * @param file The open executable.
+ * @param layout Where the segments may be placed.
+ * @param image Filled with the entry point and what was loaded.
+ * @return 0 on success, ELF_ERROR_* on error. Memory is untouched unless the
+ *         error is ELF_ERROR_IO.
+ */
+int elf_load(fat_file* file, const elf_memory_layout* layout, elf_image* image);
+
+/**
+ * @brief Computes the CRC32C of the first bytes of an executable just loaded.
+ *
+ * Bytes inside a loaded segment are taken from memory rather than read again,
+ * so only the headers and the padding between segments come from the file.
+ * Must follow a successful elf_load() of the same file, before the loaded
+ * segments change.
+ *
+ * @param file The file passed to elf_load().
+ * @param image The image filled by elf_load().
+ * @param length Number of bytes from the start of the file, at most its size.
+ * @param crc Receives the CRC, as crc32c_update() computes it.
+ * @return 0 on success, ELF_ERROR_IO on error.
+ */
+int elf_checksum(fat_file* file, const elf_image* image, uint32_t length, uint32_t* crc);
+
+#endif
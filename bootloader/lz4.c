@@ -0,0 +1,400 @@
+#include "lz4.h"
+#include "string.h"
+
+// Decoder states
+#define LZ4_STATE_MAGIC 0
+#define LZ4_STATE_DESCRIPTOR 1
+#define LZ4_STATE_BLOCK_SIZE 2
+#define LZ4_STATE_STORED 3 // Copying an uncompressed block
+#define LZ4_STATE_TOKEN 4
+#define LZ4_STATE_LITERAL_LENGTH 5 // Extra literal length bytes
+#define LZ4_STATE_LITERALS 6
+#define LZ4_STATE_OFFSET 7
+#define LZ4_STATE_MATCH_LENGTH 8 // Extra match length bytes
+#define LZ4_STATE_BLOCK_CHECKSUM 9
+#define LZ4_STATE_CONTENT_CHECKSUM 10
+#define LZ4_STATE_DONE 11
+#define LZ4_STATE_ERROR 12
+
+#define LZ4_MIN_MATCH 4
+
+// xxHash32 primes
+#define XXH_PRIME1 2654435761u
+#define XXH_PRIME2 2246822519u
+#define XXH_PRIME3 3266489917u
+#define XXH_PRIME4 668265263u
+#define XXH_PRIME5 374761393u
+
+// Helper functions
+
+static inline uint32_t read_le32(const uint8_t* p) {
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static inline uint32_t rotate_left(uint32_t value, uint32_t bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+static inline uint32_t xxh32_round(uint32_t accumulator, uint32_t input) {
+    accumulator += input * XXH_PRIME2;
+    return rotate_left(accumulator, 13) * XXH_PRIME1;
+}
+
+static int fail(lz4_stream* stream, int error) {
+    stream->state = LZ4_STATE_ERROR;
+    return error;
+}
+
+// Start collecting a fixed-size field
+static void expect_field(lz4_stream* stream, uint32_t state, uint32_t bytes) {
+    stream->state = state;
+    stream->field_length = 0;
+    stream->field_needed = bytes;
+}
+
+// Add input to the current field; true once it is complete
+static bool collect_field(lz4_stream* stream, const uint8_t** data, const uint8_t* end) {
+    while (stream->field_length < stream->field_needed && *data < end) {
+        stream->field[stream->field_length++] = *(*data)++;
+    }
+    return stream->field_length == stream->field_needed;
+}
+
+static void end_block(lz4_stream* stream) {
+    if (stream->flags & LZ4_FLAG_BLOCK_CHECKSUM) {
+        expect_field(stream, LZ4_STATE_BLOCK_CHECKSUM, 4);
+    } else {
+        expect_field(stream, LZ4_STATE_BLOCK_SIZE, 4);
+    }
+}
+
+static int begin_literals(lz4_stream* stream) {
+    if (stream->literal_length > stream->block_remaining) {
+        return fail(stream, LZ4_ERROR_FORMAT);
+    }
+    if (stream->literal_length > (size_t)(stream->output_end - stream->output)) {
+        return fail(stream, LZ4_ERROR_OVERFLOW);
+    }
+    stream->block_remaining -= stream->literal_length;
+    stream->state = LZ4_STATE_LITERALS;
+    return 0;
+}
+
+// Copy a match from the output already written; the source may overlap the
+// destination, in which case the copied pattern repeats
+static int copy_match(lz4_stream* stream) {
+    if (stream->match_length > (size_t)(stream->output_end - stream->output)) {
+        return fail(stream, LZ4_ERROR_OVERFLOW);
+    }
+    if (stream->block_remaining == 0) {
+        return fail(stream, LZ4_ERROR_FORMAT); // A block always ends with literals
+    }
+
+    // Each copy takes at most what lies between source and output, so memcpy
+    // never overlaps; the span doubles every round for short offsets
+    const uint8_t* source = stream->output - stream->match_offset;
+    uint32_t remaining = stream->match_length;
+    while (remaining > 0) {
+        uint32_t available = (uint32_t)(stream->output - source);
+        uint32_t take = remaining < available ? remaining : available;
+        memcpy(stream->output, source, take);
+        stream->output += take;
+        remaining -= take;
+    }
+
+    stream->state = LZ4_STATE_TOKEN;
+    return 0;
+}
+
+static int finish_frame(lz4_stream* stream) {
+    if ((stream->flags & LZ4_FLAG_CONTENT_SIZE) && stream->content_size != lz4_stream_output_size(stream)) {
+        return fail(stream, LZ4_ERROR_FORMAT);
+    }
+    stream->state = LZ4_STATE_DONE;
+    return 0;
+}
+
+// Check FLG and BD once they are in; returns the descriptor's full length
+static int descriptor_length(lz4_stream* stream) {
+    uint8_t flags = stream->field[0];
+    uint8_t block_descriptor = stream->field[1];
+    if ((flags & LZ4_FLAG_VERSION_MASK) != LZ4_FLAG_VERSION || (flags & 0x02) != 0 ||
+        (flags & LZ4_FLAG_DICTIONARY_ID) != 0 || (block_descriptor & 0x8F) != 0) {
+        return fail(stream, LZ4_ERROR_FORMAT); // Reserved bits, or a dictionary we do not have
+    }
+    stream->flags = flags;
+    return 2 + ((flags & LZ4_FLAG_CONTENT_SIZE) ? 8 : 0) + 1;
+}
+
+// Library functions
+
+void lz4_stream_init(lz4_stream* stream, uint8_t* destination, size_t capacity) {
+    stream->output_start = destination;
+    stream->output = destination;
+    stream->output_end = destination + capacity;
+    stream->flags = 0;
+    stream->content_size = 0;
+    stream->block_remaining = 0;
+    stream->literal_length = 0;
+    stream->match_length = 0;
+    stream->match_offset = 0;
+    stream->token = 0;
+    stream->input_bytes = 0;
+    expect_field(stream, LZ4_STATE_MAGIC, 4);
+}
+
+int lz4_stream_feed(lz4_stream* stream, const uint8_t* data, uint32_t length) {
+    const uint8_t* end = data + length;
+    stream->input_bytes += length;
+
+    for (;;) {
+        switch (stream->state) {
+        case LZ4_STATE_MAGIC:
+            if (!collect_field(stream, &data, end)) {
+                return 0;
+            }
+            if (read_le32(stream->field) != LZ4_FRAME_MAGIC) {
+                return fail(stream, LZ4_ERROR_FORMAT);
+            }
+            expect_field(stream, LZ4_STATE_DESCRIPTOR, 2);
+            break;
+
+        case LZ4_STATE_DESCRIPTOR:
+            if (!collect_field(stream, &data, end)) {
+                return 0;
+            }
+            if (stream->field_needed == 2) {
+                // FLG and BD tell how long the rest is
+                int needed = descriptor_length(stream);
+                if (needed < 0) {
+                    return needed;
+                }
+                stream->field_needed = (uint32_t)needed;
+                break;
+            }
+            if (((lz4_xxh32(stream->field, stream->field_needed - 1, 0) >> 8) & 0xFF) !=
+                stream->field[stream->field_needed - 1]) {
+                return fail(stream, LZ4_ERROR_CHECKSUM);
+            }
+            if (stream->flags & LZ4_FLAG_CONTENT_SIZE) {
+                stream->content_size = read_le32(stream->field + 2) |
+                    ((uint64_t)read_le32(stream->field + 6) << 32);
+            }
+            expect_field(stream, LZ4_STATE_BLOCK_SIZE, 4);
+            break;
+
+        case LZ4_STATE_BLOCK_SIZE: {
+            if (!collect_field(stream, &data, end)) {
+                return 0;
+            }
+            uint32_t size = read_le32(stream->field);
+            if (size == 0) {
+                // End mark
+                if (stream->flags & LZ4_FLAG_CONTENT_CHECKSUM) {
+                    expect_field(stream, LZ4_STATE_CONTENT_CHECKSUM, 4);
+                    break;
+                }
+                return finish_frame(stream);
+            }
+            if (size & LZ4_BLOCK_UNCOMPRESSED) {
+                stream->literal_length = size & ~LZ4_BLOCK_UNCOMPRESSED;
+                if (stream->literal_length > (size_t)(stream->output_end - stream->output)) {
+                    return fail(stream, LZ4_ERROR_OVERFLOW);
+                }
+                stream->state = LZ4_STATE_STORED;
+            } else {
+                stream->block_remaining = size;
+                stream->state = LZ4_STATE_TOKEN;
+            }
+            break;
+        }
+
+        case LZ4_STATE_STORED: {
+            uint32_t available = (uint32_t)(end - data);
+            uint32_t take = stream->literal_length < available ? stream->literal_length : available;
+            memcpy(stream->output, data, take);
+            stream->output += take;
+            data += take;
+            stream->literal_length -= take;
+            if (stream->literal_length > 0) {
+                return 0;
+            }
+            end_block(stream);
+            break;
+        }
+
+        case LZ4_STATE_TOKEN:
+            if (data == end) {
+                return 0;
+            }
+            stream->token = *data++;
+            stream->block_remaining--;
+            stream->literal_length = stream->token >> 4;
+            if (stream->literal_length == 15) {
+                stream->state = LZ4_STATE_LITERAL_LENGTH;
+            } else {
+                int result = begin_literals(stream);
+                if (result < 0) {
+                    return result;
+                }
+            }
+            break;
+
+        case LZ4_STATE_LITERAL_LENGTH: {
+            if (data == end) {
+                return 0;
+            }
+            if (stream->block_remaining == 0) {
+                return fail(stream, LZ4_ERROR_FORMAT);
+            }
+            uint8_t extra = *data++;
+            stream->block_remaining--;
+            stream->literal_length += extra;
+            if (extra != 255) {
+                int result = begin_literals(stream);
+                if (result < 0) {
+                    return result;
+                }
+            }
+            break;
+        }
+
+        case LZ4_STATE_LITERALS: {
+            uint32_t available = (uint32_t)(end - data);
+            uint32_t take = stream->literal_length < available ? stream->literal_length : available;
+            memcpy(stream->output, data, take);
+            stream->output += take;
+            data += take;
+            stream->literal_length -= take;
+            if (stream->literal_length > 0) {
+                return 0;
+            }
+
+            // The last sequence of a block has no match
+            if (stream->block_remaining == 0) {
+                end_block(stream);
+            } else if (stream->block_remaining < 2) {
+                return fail(stream, LZ4_ERROR_FORMAT);
+            } else {
+                stream->block_remaining -= 2;
+                expect_field(stream, LZ4_STATE_OFFSET, 2);
+            }
+            break;
+        }
+
+        case LZ4_STATE_OFFSET:
+            if (!collect_field(stream, &data, end)) {
+                return 0;
+            }
+            stream->match_offset = (uint32_t)stream->field[0] | ((uint32_t)stream->field[1] << 8);
+            if (stream->match_offset == 0 ||
+                stream->match_offset > (size_t)(stream->output - stream->output_start)) {
+                return fail(stream, LZ4_ERROR_FORMAT); // Reaches before the start of the output
+            }
+            stream->match_length = (stream->token & 0x0F) + LZ4_MIN_MATCH;
+            if ((stream->token & 0x0F) == 15) {
+                stream->state = LZ4_STATE_MATCH_LENGTH;
+            } else {
+                int result = copy_match(stream);
+                if (result < 0) {
+                    return result;
+                }
+            }
+            break;
+
+        case LZ4_STATE_MATCH_LENGTH: {
+            if (data == end) {
+                return 0;
+            }
+            if (stream->block_remaining == 0) {
+                return fail(stream, LZ4_ERROR_FORMAT);
+            }
+            uint8_t extra = *data++;
+            stream->block_remaining--;
+            stream->match_length += extra;
+            if (extra != 255) {
+                int result = copy_match(stream);
+                if (result < 0) {
+                    return result;
+                }
+            }
+            break;
+        }
+
+        case LZ4_STATE_BLOCK_CHECKSUM:
+            // Skipped: the content checksum covers the whole output
+            if (!collect_field(stream, &data, end)) {
+                return 0;
+            }
+            expect_field(stream, LZ4_STATE_BLOCK_SIZE, 4);
+            break;
+
+        case LZ4_STATE_CONTENT_CHECKSUM:
+            if (!collect_field(stream, &data, end)) {
+                return 0;
+            }
+            if (lz4_xxh32(stream->output_start, lz4_stream_output_size(stream), 0) != read_le32(stream->field)) {
+                return fail(stream, LZ4_ERROR_CHECKSUM);
+            }
+            return finish_frame(stream);
+
+        case LZ4_STATE_DONE:
+            return 0; // Anything after the frame is ignored
+
+        default:
+            return LZ4_ERROR_FORMAT;
+        }
+    }
+}
+
+bool lz4_stream_done(const lz4_stream* stream) {
+    return stream->state == LZ4_STATE_DONE;
+}
+
+size_t lz4_stream_output_size(const lz4_stream* stream) {
+    return (size_t)(stream->output - stream->output_start);
+}
+
+bool lz4_is_frame(const uint8_t* data, uint32_t length) {
+    return length >= 4 && read_le32(data) == LZ4_FRAME_MAGIC;
+}
+
+uint32_t lz4_xxh32(const uint8_t* data, size_t length, uint32_t seed) {
+    const uint8_t* end = data + length;
+    uint32_t hash;
+
+    if (length >= 16) {
+        uint32_t v1 = seed + XXH_PRIME1 + XXH_PRIME2;
+        uint32_t v2 = seed + XXH_PRIME2;
+        uint32_t v3 = seed;
+        uint32_t v4 = seed - XXH_PRIME1;
+        do {
+            v1 = xxh32_round(v1, read_le32(data));
+            v2 = xxh32_round(v2, read_le32(data + 4));
+            v3 = xxh32_round(v3, read_le32(data + 8));
+            v4 = xxh32_round(v4, read_le32(data + 12));
+            data += 16;
+        } while (end - data >= 16);
+        hash = rotate_left(v1, 1) + rotate_left(v2, 7) + rotate_left(v3, 12) + rotate_left(v4, 18);
+    } else {
+        hash = seed + XXH_PRIME5;
+    }
+    hash += (uint32_t)length;
+
+    while (end - data >= 4) {
+        hash += read_le32(data) * XXH_PRIME3;
+        hash = rotate_left(hash, 17) * XXH_PRIME4;
+        data += 4;
+    }
+    while (data < end) {
+        hash += *data++ * XXH_PRIME5;
+        hash = rotate_left(hash, 11) * XXH_PRIME1;
+    }
+
+    hash ^= hash >> 15;
+    hash *= XXH_PRIME2;
+    hash ^= hash >> 13;
+    hash *= XXH_PRIME3;
+    hash ^= hash >> 16;
+    return hash;
+}
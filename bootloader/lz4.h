@@ -0,0 +1,110 @@
+#ifndef LZ4_H
+#define LZ4_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Streaming decoder for the LZ4 frame format (lz4.org, as written by
+// scripts/lz4pack.py). Input can arrive in pieces of any size, e.g. the
+// chunks of fat_read_stream(), and is decoded straight into one contiguous
+// output buffer, so matches may reach back into earlier blocks (linked blocks)
+// without a separate history window.
+
+#define LZ4_FRAME_MAGIC 0x184D2204
+
+// Frame descriptor flags (FLG byte)
+#define LZ4_FLAG_VERSION_MASK 0xC0
+#define LZ4_FLAG_VERSION 0x40 // Version 01
+#define LZ4_FLAG_BLOCK_CHECKSUM 0x10
+#define LZ4_FLAG_CONTENT_SIZE 0x08
+#define LZ4_FLAG_CONTENT_CHECKSUM 0x04
+#define LZ4_FLAG_DICTIONARY_ID 0x01
+
+// Block size field: the high bit marks a block stored uncompressed
+#define LZ4_BLOCK_UNCOMPRESSED 0x80000000u
+
+// Decoder results
+#define LZ4_ERROR_FORMAT -1 // Not a frame we can decode, or damaged data
+#define LZ4_ERROR_OVERFLOW -2 // Output does not fit the buffer
+#define LZ4_ERROR_CHECKSUM -3 // Header or content checksum mismatch
+
+typedef struct {
+    uint8_t* output_start;
+    uint8_t* output; // Next byte to write
+    uint8_t* output_end;
+
+    uint32_t state;
+    uint8_t field[16]; // Fixed-size fields (magic, descriptor, block size, checksums)
+    uint32_t field_length; // Bytes collected in field
+    uint32_t field_needed; // Bytes the current field has
+
+    uint8_t flags; // FLG byte of the frame
+    uint64_t content_size; // From the descriptor, when LZ4_FLAG_CONTENT_SIZE is set
+    uint32_t block_remaining; // Input bytes left in the current block
+    uint32_t literal_length; // Literals left to copy (or raw bytes, for stored blocks)
+    uint32_t match_length;
+    uint32_t match_offset;
+    uint8_t token;
+
+    uint64_t input_bytes; // Bytes fed so far
+} lz4_stream;
+
+/**
+ * @brief Prepares a decoder that writes into a buffer.
+ *
+ * @param stream The decoder state.
+ * @param destination Receives the decompressed data.
+ * @param capacity Size of destination in bytes.
+ */
+void lz4_stream_init(lz4_stream* stream, uint8_t* destination, size_t capacity);
+
+/**
+ * @brief Decodes the next piece of a frame.
+ *
+ * Pieces must be fed in order; a piece may end anywhere, even inside a header
+ * or a sequence. Bytes after the end of the frame are ignored.
+ *
+ * @param stream The decoder state.
+ * @param data The next input bytes.
+ * @param length Number of input bytes.
+ * @return 0 on success, LZ4_ERROR_* on error (the stream is then unusable).
+ */
+int lz4_stream_feed(lz4_stream* stream, const uint8_t* data, uint32_t length);
+
+/**
+ * @brief Checks whether the whole frame, including its checksum, was decoded.
+ *
+ * @param stream The decoder state.
+ * @return true once the end of the frame has been reached and verified.
+ */
+bool lz4_stream_done(const lz4_stream* stream);
+
+/**
+ * @brief Returns how many bytes have been decompressed so far.
+ *
+ * @param stream The decoder state.
+ * @return Bytes written to the destination.
+ */
+size_t lz4_stream_output_size(const lz4_stream* stream);
+
+/**
+ * @brief Checks whether data starts with the LZ4 frame magic number.
+ *
+ * @param data The first bytes of a file.
+ * @param length Number of bytes available.
+ * @return true if the data looks like an LZ4 frame.
+ */
+bool lz4_is_frame(const uint8_t* data, uint32_t length);
+
+/**
+ * @brief Computes the xxHash32 of a buffer, the checksum LZ4 frames use.
+ *
+ * @param data The bytes to hash.
+ * @param length Number of bytes.
+ * @param seed Initial value (0 for LZ4).
+ * @return The hash.
+ */
+uint32_t lz4_xxh32(const uint8_t* data, size_t length, uint32_t seed);
+
+#endif
@@ -6,32 +6,102 @@
  * 2. Initializes the VIO block device
  * 3. Initializes the FAT32 filesystem
  * 4. Searches for the kernel file
- * 5. Loads the kernel into memory
- * 6. Jumps to the kernel entry point
+ * 5. Loads the kernel into memory (ELF segments, or a flat binary, LZ4 or raw)
+ *    and checks it against its CRC32C footer, if it has one
+ * 6. Prints where the time went and jumps to the kernel entry point, passing
+ *    it the boot timeline in x0
+ *
+ * Built with tracing (cmake -DTRACE=ON), the event trace of the disk and
+ * filesystem is printed before the jump, or when the boot fails.
  */
 
 #include "uart.h"
+#include "mmu.h"
+#include "irq.h"
 #include "vio.h"
 #include "fat.h"
+#include "elf.h"
+#include "lz4.h"
+#include "crc32c.h"
+#include "timer.h"
+#include "trace.h"
+#include "string.h"
 #include <stdint.h>
 #include <stdbool.h>
 
 // Configuration
+#define KERNEL_ELF_PATH "/KERNEL.ELF"     // os.elf, loaded segment by segment
+#define KERNEL_PATH "/KERNEL.BIN"         // Flat os.bin or os.bin.lz4, for disks made before ELF loading
 #define KERNEL_FILENAME "KERNEL  BIN"
-#define KERNEL_LOAD_ADDR 0x40080000    // Where to load kernel in memory
+#define KERNEL_LOAD_ADDR 0x40080000    // Where to load a flat kernel in memory
 #define MAX_KERNEL_SIZE (16 * 1024 * 1024)  // 16MB max kernel size
 
-// Simple string functions (no libc available)
-void* memset(void* s, int c, size_t n) {
-    uint8_t* p = (uint8_t*)s;
-    while (n--) *p++ = (uint8_t)c;
-    return s;
+// RAM of the QEMU virt machine (default -m 128M)
+#define RAM_START 0x40000000
+#define RAM_SIZE (128 * 1024 * 1024)
+
+// From linker.ld: the bootloader image, its BSS and then its stack
+extern uint8_t __text_boot_start[];
+extern uint8_t boot_stack_top[];
+
+// One phase per step of boot_main(); handed to the kernel, which carries on with it
+static timer_timeline boot_timeline;
+static vio_stats boot_io; // Disk counters at the last mark
+
+// End the running phase with the disk requests it issued and start the next
+static void mark_phase(const char* name) {
+    vio_stats io;
+    vio_get_stats(&io);
+    timer_mark(&boot_timeline, name, io.requests - boot_io.requests,
+        (io.sectors_read - boot_io.sectors_read) + (io.sectors_written - boot_io.sectors_written));
+    boot_io = io;
+}
+
+// Where the chunks of a flat or LZ4 kernel go
+typedef struct {
+    uint8_t* destination; // Flat image: copied here
+    lz4_stream* lz4; // LZ4 image: fed to this decoder instead
+    uint32_t image_size; // File bytes before the CRC32C footer, if there is one
+    uint32_t crc; // CRC32C of the bytes seen so far
+    int lz4_error; // LZ4_ERROR_* that stopped the decoder, 0 while it is fine
+} kernel_stream;
+
+// fat_read_stream() callback: checksum each chunk and copy or decompress it
+// while the next one loads; the footer is left out of both
+static int load_chunk(const uint8_t* data, uint32_t length, uint32_t offset, void* context) {
+    kernel_stream* stream = (kernel_stream*)context;
+    if (offset >= stream->image_size) {
+        return 0;
+    }
+    if (length > stream->image_size - offset) {
+        length = stream->image_size - offset;
+    }
+
+    stream->crc = crc32c_update(stream->crc, data, length);
+    if (stream->lz4 != NULL) {
+        // Kept apart from the return value, which fat_read_stream() shares
+        // with its own read errors
+        stream->lz4_error = lz4_stream_feed(stream->lz4, data, length);
+        return stream->lz4_error;
+    }
+    memcpy(stream->destination + offset, data, length);
+    return 0;
 }
 
-size_t strlen(const char* s) {
-    size_t len = 0;
-    while (s[len]) len++;
-    return len;
+// Whether length bytes at address lie in RAM and clear of the bootloader
+static bool fits_layout(const elf_memory_layout* layout, uint64_t address, uint64_t length) {
+    uint64_t end = address + length;
+    return address >= layout->ram_start && end <= layout->ram_end &&
+        (end <= layout->reserved_start || address >= layout->reserved_end);
+}
+
+static void report_overlap(const elf_memory_layout* layout) {
+    uart_puts("FATAL: Kernel load area overlaps the bootloader or leaves RAM!\n\r");
+    uart_puts("Bootloader ends at 0x");
+    uart_print_hex(layout->reserved_end);
+    uart_puts(", kernel loads at 0x");
+    uart_print_hex(KERNEL_LOAD_ADDR);
+    uart_puts("\n\r");
 }
 
 /**
@@ -39,6 +109,7 @@ size_t strlen(const char* s) {
  * Called from start.s after basic setup
  */
 void boot_main(void) {
+    timer_timeline_init(&boot_timeline);
     uart_init();
     
     // Banner
@@ -52,7 +123,11 @@ void boot_main(void) {
     // PHASE 1: Initialize Block Device
     // ============================================================================
     uart_puts("[1] Initializing VIO block device...\n\r");
+    mark_phase("vio init");
     
+    // Exception vectors and GIC first so disk completions can wake us from WFI
+    irq_init();
+
     if (vio_init() < 0) {
         uart_puts("FATAL: VIO initialization failed!\n\r");
         uart_puts("The bootloader cannot access the disk.\n\r");
@@ -66,6 +141,7 @@ void boot_main(void) {
     // PHASE 2: Initialize Filesystem
     // ============================================================================
     uart_puts("[2] Initializing FAT32 filesystem...\n\r");
+    mark_phase("mbr read");
     
     if (fat_init() < 0) {
         uart_puts("FATAL: FAT initialization failed!\n\r");
@@ -77,6 +153,7 @@ void boot_main(void) {
     
     // Mount the first partition
     uart_puts("[2.1] Mounting partition 0...\n\r");
+    mark_phase("mount");
     if (fat_mount(0) < 0) {
         uart_puts("FATAL: FAT mount failed!\n\r");
         uart_puts("Could not mount partition or invalid FAT32.\n\r");
@@ -90,16 +167,23 @@ void boot_main(void) {
     // PHASE 3: Search for Kernel File
     // ============================================================================
     uart_puts("[3] Searching for kernel file...\n\r");
+    mark_phase("lookup");
     uart_puts("    Looking for: ");
-    uart_puts(KERNEL_FILENAME);
+    uart_puts(KERNEL_ELF_PATH);
+    uart_puts(", then ");
+    uart_puts(KERNEL_PATH);
     uart_puts("\n\r");
     
     fat_file kernel_file = {0};
 
     uart_puts("Opening kernel file...\n\r");
-    if (fat_open(KERNEL_FILENAME, &kernel_file) < 0) {
+    // Prefer the ELF; a flat KERNEL.BIN is looked for in the root directory
+    // first, then on the whole volume
+    if (fat_open_path(KERNEL_ELF_PATH, &kernel_file) < 0 &&
+        fat_open_path(KERNEL_PATH, &kernel_file) < 0 &&
+        fat_open(KERNEL_FILENAME, &kernel_file) < 0) {
         uart_puts("FATAL: Kernel file not found!\n\r");
-        uart_puts("Make sure KERNEL.BIN exists on the disk.\n\r");
+        uart_puts("Make sure KERNEL.ELF or KERNEL.BIN exists on the disk.\n\r");
         goto fatal_error;
     }
     
@@ -109,98 +193,218 @@ void boot_main(void) {
     uart_puts(" (");
     uart_print_dec(kernel_file.file_size);
     uart_puts(" bytes)\n\r");
-    uart_puts("\n\r");
-    
-    // Sanity check: kernel size
-    if (kernel_file.file_size > MAX_KERNEL_SIZE) {
-        uart_puts("FATAL: Kernel too large!\n\r");
-        uart_puts("Maximum size: 0x");
-        uart_print_hex(MAX_KERNEL_SIZE);
-        uart_puts("\n\r");
+
+    // Images stamped by scripts/crcstamp.py end in a CRC32C footer
+    crc32c_footer footer;
+    int footer_result = crc32c_read_footer(&kernel_file, &footer);
+    if (footer_result == CRC32C_ERROR_IO) {
+        uart_puts("FATAL: Could not read kernel from disk.\n\r");
         goto fatal_error;
     }
-    
-    if (kernel_file.file_size < 100) {
-        uart_puts("WARNING: Kernel suspiciously small (< 100 bytes)\n\r");
+    bool verify = footer_result == 0;
+    uint32_t image_size = verify ? footer.length : kernel_file.file_size;
+    if (verify) {
+        uart_puts("    CRC32C footer: 0x");
+        uart_print_hex(footer.crc);
+        uart_puts("\n\r");
+    } else {
+        uart_puts("    WARNING: No CRC32C footer, kernel will not be verified\n\r");
     }
+    uart_puts("\n\r");
     
     // ============================================================================
     // PHASE 4: Load Kernel into Memory
     // ============================================================================
     uart_puts("[4] Loading kernel into memory...\n\r");
-    uart_puts("    Load address: 0x");
-    uart_print_hex(KERNEL_LOAD_ADDR);
-    uart_puts("\n\r");
-    uart_puts("    Reading from disk...\n\r");
-    
-    //uart_puts("DEBUG main: About to call fat_read()...\n\r");
-    
-    uint64_t sp_main;
-    asm volatile("mov %0, sp" : "=r"(sp_main));
-    //uart_puts("DEBUG main: SP before call: 0x");
-    //uart_print_hex(sp_main);
-    //uart_puts("\n\r");
-    
-    if (fat_read(&kernel_file, (uint8_t*)KERNEL_LOAD_ADDR) < 0) {
+    mark_phase("load");
+
+    // Segments, and flat or LZ4 kernels at KERNEL_LOAD_ADDR, may go anywhere
+    // in RAM except over the bootloader, its BSS and the stack right after it
+    elf_memory_layout layout = {
+        .ram_start = RAM_START,
+        .ram_end = (uint64_t)RAM_START + RAM_SIZE,
+        .reserved_start = (uint64_t)__text_boot_start,
+        .reserved_end = (uint64_t)boot_stack_top,
+    };
+    elf_image image;
+    uint64_t kernel_entry_address;
+    uint64_t bytes_from_disk; // File bytes read, compressed or not
+    uint64_t bytes_loaded; // Bytes of kernel in memory
+    uint32_t crc = 0; // CRC32C of the image bytes
+    uint8_t magic[4];
+    uint64_t load_start = timer_now();
+
+    int load_result = elf_load(&kernel_file, &layout, &image);
+    if (load_result == 0) {
+        uart_puts("    ELF image, ");
+        uart_print_dec(image.segment_count);
+        uart_puts(" segment(s) at 0x");
+        uart_print_hex(image.lowest_address);
+        uart_puts(" - 0x");
+        uart_print_hex(image.highest_address);
+        uart_puts("\n\r");
+        uart_puts("    Read ");
+        uart_print_dec((uint32_t)image.bytes_read);
+        uart_puts(" bytes, zeroed ");
+        uart_print_dec((uint32_t)image.bytes_zeroed);
+        uart_puts(" bytes\n\r");
+        kernel_entry_address = image.entry;
+        bytes_from_disk = image.bytes_read;
+        bytes_loaded = image.highest_address - image.lowest_address;
+
+        // The segments are already in memory; only headers and padding are read
+        if (verify && elf_checksum(&kernel_file, &image, image_size, &crc) < 0) {
+            uart_puts("FATAL: Could not read kernel from disk.\n\r");
+            goto fatal_error;
+        }
+    } else if (load_result != ELF_ERROR_NOT_ELF) {
         uart_puts("FATAL: Kernel load failed!\n\r");
-        uart_puts("Could not read kernel from disk.\n\r");
+        if (load_result == ELF_ERROR_FORMAT) {
+            uart_puts("Not a 64-bit AArch64 executable, or its headers are damaged.\n\r");
+        } else if (load_result == ELF_ERROR_PLACEMENT) {
+            uart_puts("A segment overlaps the bootloader or another segment, or lies outside RAM.\n\r");
+        } else {
+            uart_puts("Could not read kernel from disk.\n\r");
+        }
         goto fatal_error;
-    }
-    
-    //uart_puts("DEBUG main: fat_read() returned successfully\n\r");
+    } else if (fat_read_at(&kernel_file, 0, sizeof(magic), magic) == sizeof(magic) &&
+               lz4_is_frame(magic, sizeof(magic))) {
+        // LZ4 frame: decompress to the fixed load address as the chunks arrive,
+        // so decoding one chunk overlaps reading the next
+        uart_puts("    LZ4 image, load address: 0x");
+        uart_print_hex(KERNEL_LOAD_ADDR);
+        uart_puts("\n\r");
 
-    // Force a small delay
-    for (volatile int delay = 0; delay < 100000; delay++);
+        // The decoder may write up to MAX_KERNEL_SIZE bytes from the load address
+        if (!fits_layout(&layout, KERNEL_LOAD_ADDR, MAX_KERNEL_SIZE)) {
+            report_overlap(&layout);
+            goto fatal_error;
+        }
 
-   // uart_puts("DEBUG main: Delay done\n\r");
+        lz4_stream decoder;
+        lz4_stream_init(&decoder, (uint8_t*)KERNEL_LOAD_ADDR, MAX_KERNEL_SIZE);
+        kernel_stream stream = { .lz4 = &decoder, .image_size = image_size };
+        int result = fat_read_stream(&kernel_file, load_chunk, &stream);
+        if (result < 0 || !lz4_stream_done(&decoder)) {
+            uart_puts("FATAL: Kernel load failed!\n\r");
+            if (stream.lz4_error == LZ4_ERROR_OVERFLOW) {
+                uart_puts("Decompressed kernel larger than 0x");
+                uart_print_hex(MAX_KERNEL_SIZE);
+                uart_puts(" bytes.\n\r");
+            } else if (stream.lz4_error != 0 || result == 0) {
+                uart_puts("Compressed kernel is damaged or truncated.\n\r");
+            } else {
+                uart_puts("Could not read kernel from disk.\n\r");
+            }
+            goto fatal_error;
+        }
+        kernel_entry_address = KERNEL_LOAD_ADDR;
+        bytes_from_disk = kernel_file.file_size;
+        bytes_loaded = lz4_stream_output_size(&decoder);
+        crc = stream.crc;
+    } else {
+        // Flat binary: the whole file goes to the fixed load address
+        if (image_size > MAX_KERNEL_SIZE) {
+            uart_puts("FATAL: Kernel too large!\n\r");
+            uart_puts("Maximum size: 0x");
+            uart_print_hex(MAX_KERNEL_SIZE);
+            uart_puts("\n\r");
+            goto fatal_error;
+        }
 
-    uart_puts("[5] Boot Information:\n\r");
+        if (!fits_layout(&layout, KERNEL_LOAD_ADDR, image_size)) {
+            report_overlap(&layout);
+            goto fatal_error;
+        }
+
+        if (image_size < 100) {
+            uart_puts("WARNING: Kernel suspiciously small (< 100 bytes)\n\r");
+        }
+
+        uart_puts("    Flat binary, load address: 0x");
+        uart_print_hex(KERNEL_LOAD_ADDR);
+        uart_puts("\n\r");
+        uart_puts("    Reading from disk...\n\r");
 
+        kernel_stream stream = { .destination = (uint8_t*)KERNEL_LOAD_ADDR, .image_size = image_size };
+        if (fat_read_stream(&kernel_file, load_chunk, &stream) < 0) {
+            uart_puts("FATAL: Kernel load failed!\n\r");
+            uart_puts("Could not read kernel from disk.\n\r");
+            goto fatal_error;
+        }
+        kernel_entry_address = KERNEL_LOAD_ADDR;
+        bytes_from_disk = kernel_file.file_size;
+        bytes_loaded = image_size;
+        crc = stream.crc;
+    }
+
+    if (verify && crc != footer.crc) {
+        uart_puts("FATAL: Kernel image is damaged!\n\r");
+        uart_puts("CRC32C 0x");
+        uart_print_hex(crc);
+        uart_puts(", expected 0x");
+        uart_print_hex(footer.crc);
+        uart_puts("\n\r");
+        goto fatal_error;
+    }
+
+    uint64_t load_ticks = timer_now() - load_start;
     uart_puts("    SUCCESS: Kernel loaded\n\r");
+    uart_puts("    Load time: ");
+    uart_print_dec((uint32_t)timer_ticks_to_us(load_ticks));
+    uart_puts(" us, ");
+    uart_print_dec((uint32_t)bytes_from_disk);
+    uart_puts(" bytes read from disk for ");
+    uart_print_dec((uint32_t)bytes_loaded);
+    uart_puts(" bytes of kernel\n\r");
+    if (verify) {
+        uart_puts("    CRC32C verified\n\r");
+    }
     uart_puts("\n\r");
     
     // ============================================================================
     // PHASE 5: Boot Information
     // ============================================================================
-    //uart_puts("DEBUG main: Starting Phase 5\n\r");
     uart_puts("[5] Boot Information:\n\r");
+    mark_phase("handoff"); // Ended by the kernel
     uart_puts("    Kernel Entry Point: 0x");
-    uart_print_hex(KERNEL_LOAD_ADDR);
+    uart_print_hex(kernel_entry_address);
     uart_puts("\n\r");
     uart_puts("    Kernel Size:        0x");
     uart_print_hex(kernel_file.file_size);
     uart_puts(" bytes\n\r");
+    uart_puts("    Time per phase:\n\r");
+    timer_timeline_print(&boot_timeline);
     uart_puts("\n\r");
-    //uart_puts("DEBUG main: Phase 5 complete\n\r");
+    trace_dump();
     
     // ============================================================================
     // PHASE 6: Transfer Control to Kernel
     // ============================================================================
-   // uart_puts("DEBUG main: Starting Phase 6\n\r");
     uart_puts("[6] Transferring control to kernel...\n\r");
     uart_puts("    Jumping to 0x");
-    uart_print_hex(KERNEL_LOAD_ADDR);
+    uart_print_hex(kernel_entry_address);
     uart_puts("\n\r");
     uart_puts("\n\r");
     uart_puts("===========================================\n\r");
     uart_puts("Bootloader complete. Starting kernel.\n\r");
     uart_puts("===========================================\n\r");
     uart_puts("\n\r");
-    
-   // uart_puts("DEBUG main: Creating kernel_entry function pointer\n\r");
+
+    // The kernel installs its own vectors; leave it a quiet GIC with IRQs masked
+    irq_shutdown();
+
+    // Hand over with the MMU off and the loaded image in memory rather than in
+    // the data cache, and no stale instructions cached for the kernel's addresses
+    mmu_disable();
     
     // Jump to kernel
-    // Cast the address as a function pointer with void return and no arguments
-    typedef void (*kernel_entry_t)(void);
-    kernel_entry_t kernel_entry = (kernel_entry_t)KERNEL_LOAD_ADDR;
-    
-    /*uart_puts("DEBUG main: About to call kernel entry point at 0x");
-    uart_print_hex(KERNEL_LOAD_ADDR);
-    uart_puts("\n\r");
-    */
+    // Cast the address as a function pointer with void return; the timeline goes in x0
+    typedef void (*kernel_entry_t)(const timer_timeline* timeline);
+    kernel_entry_t kernel_entry = (kernel_entry_t)kernel_entry_address;
     
     // Call the kernel
-    kernel_entry();
+    kernel_entry(&boot_timeline);
     
     // ============================================================================
     // ERROR HANDLING: Should never reach here
@@ -208,6 +412,10 @@ void boot_main(void) {
     uart_puts("FATAL: Kernel returned to bootloader!\n\r");
     
 fatal_error:
+    // What the disk and filesystem did up to the failure
+    TRACE(TRACE_FATAL, boot_timeline.phase_count - 1, 0);
+    trace_dump();
+
     uart_puts("\n\r");
     uart_puts("SYSTEM HALTED\n\r");
     uart_puts("Bootloader cannot continue.\n\r");
@@ -10,17 +10,21 @@ _start:
     bic x0, x0, #0xF
     mov sp, x0
     
+    // C code and memcpy/memset use FP/SIMD registers; stop them from trapping (CPACR_EL1.FPEN = 0b11)
+    mov x0, #(3 << 20)
+    msr cpacr_el1, x0
+    isb
+
     // Clear BSS section (required for C runtime)
     ldr x0, =__bss_start
-    ldr x1, =__bss_end
-    
-clear_bss_loop:
-    cmp x0, x1
-    beq bss_cleared
-    str xzr, [x0], #8      // Write zero and increment by 8
-    b clear_bss_loop
-    
-bss_cleared:
+    ldr x2, =__bss_end
+    sub x2, x2, x0
+    mov w1, #0
+    bl memset
+
+    // Identity map with caches on before any real work; the tables live in BSS
+    bl mmu_init
+
     // Call C main bootloader function
     bl boot_main
     
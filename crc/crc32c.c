@@ -0,0 +1,115 @@
+#include "crc32c.h"
+
+// Loads through this type may alias the caller's buffer
+typedef uint64_t __attribute__((may_alias)) crc32c_word;
+
+// Helper functions
+
+static inline uint32_t crc32c_byte(uint32_t crc, uint8_t value) {
+    asm("crc32cb %w0, %w0, %w1" : "+r"(crc) : "r"((uint32_t)value));
+    return crc;
+}
+
+static inline uint32_t crc32c_word64(uint32_t crc, uint64_t value) {
+    asm("crc32cx %w0, %w0, %x1" : "+r"(crc) : "r"(value));
+    return crc;
+}
+
+// Library functions
+
+uint32_t crc32c_update(uint32_t crc, const void* data, size_t length) {
+    const uint8_t* bytes = (const uint8_t*)data;
+    crc = ~crc;
+
+    // Single bytes up to an 8-byte boundary, so the word loads below are aligned
+    while (length > 0 && ((uintptr_t)bytes & 7) != 0) {
+        crc = crc32c_byte(crc, *bytes++);
+        length--;
+    }
+
+    // Each crc32cx depends on the one before, so the loads of a 32-byte group
+    // are issued ahead of the chain
+    const crc32c_word* words = (const crc32c_word*)bytes;
+    while (length >= 32) {
+        uint64_t a = words[0];
+        uint64_t b = words[1];
+        uint64_t c = words[2];
+        uint64_t d = words[3];
+        crc = crc32c_word64(crc, a);
+        crc = crc32c_word64(crc, b);
+        crc = crc32c_word64(crc, c);
+        crc = crc32c_word64(crc, d);
+        words += 4;
+        length -= 32;
+    }
+    while (length >= 8) {
+        crc = crc32c_word64(crc, *words++);
+        length -= 8;
+    }
+
+    bytes = (const uint8_t*)words;
+    while (length > 0) {
+        crc = crc32c_byte(crc, *bytes++);
+        length--;
+    }
+
+    return ~crc;
+}
+
+int crc32c_file(fat_file* file, uint32_t offset, uint32_t length, uint32_t* crc) {
+    if (file == NULL || crc == NULL || !file->is_open ||
+        offset > file->file_size || length > file->file_size - offset) {
+        return CRC32C_ERROR_IO; // Invalid parameters
+    }
+
+    uint32_t value = 0;
+    while (length > 0) {
+        fat_view view;
+        int mapped = fat_map(file, offset, length, &view);
+        if (mapped <= 0) {
+            return CRC32C_ERROR_IO;
+        }
+        value = crc32c_update(value, view.data, view.length);
+        fat_unmap(&view);
+
+        offset += (uint32_t)mapped;
+        length -= (uint32_t)mapped;
+    }
+
+    *crc = value;
+    return 0;
+}
+
+int crc32c_read_footer(fat_file* file, crc32c_footer* footer) {
+    if (file == NULL || footer == NULL || !file->is_open) {
+        return CRC32C_ERROR_IO; // Invalid parameters
+    }
+    if (file->file_size < CRC32C_FOOTER_SIZE) {
+        return CRC32C_ERROR_NO_FOOTER;
+    }
+
+    uint32_t covered = file->file_size - CRC32C_FOOTER_SIZE;
+    if (fat_read_at(file, covered, CRC32C_FOOTER_SIZE, (uint8_t*)footer) != CRC32C_FOOTER_SIZE) {
+        return CRC32C_ERROR_IO;
+    }
+    if (footer->magic != CRC32C_FOOTER_MAGIC || footer->length != covered) {
+        return CRC32C_ERROR_NO_FOOTER;
+    }
+
+    return 0;
+}
+
+int crc32c_verify_file(fat_file* file) {
+    crc32c_footer footer;
+    int result = crc32c_read_footer(file, &footer);
+    if (result < 0) {
+        return result;
+    }
+
+    uint32_t crc;
+    if (crc32c_file(file, 0, footer.length, &crc) < 0) {
+        return CRC32C_ERROR_IO;
+    }
+
+    return crc == footer.crc ? 0 : CRC32C_ERROR_MISMATCH;
+}
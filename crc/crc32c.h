@@ -0,0 +1,78 @@
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "fat.h"
+
+// CRC32C (Castagnoli, as used by iSCSI, ext4 and SSE4.2) computed with the ARMv8
+// CRC extension's crc32cx, 8 bytes per instruction.
+//
+// A file can carry its own CRC in a footer appended by scripts/crcstamp.py: the
+// last CRC32C_FOOTER_SIZE bytes of the file hold a crc32c_footer whose CRC
+// covers every byte before it. The footer is ignored by anything that does not
+// look for it (an ELF loader, the LZ4 decoder given only the covered bytes).
+
+#define CRC32C_FOOTER_MAGIC 0x43323343 // "C32C" as a little-endian word
+#define CRC32C_FOOTER_SIZE 12
+
+// Results of the file functions
+#define CRC32C_ERROR_IO -1
+#define CRC32C_ERROR_NO_FOOTER -2
+#define CRC32C_ERROR_MISMATCH -3
+
+typedef struct __attribute__((packed)) {
+    uint32_t magic; // 0x00: CRC32C_FOOTER_MAGIC
+    uint32_t length; // 0x04: Bytes covered, always the file size minus the footer
+    uint32_t crc; // 0x08: CRC32C of those bytes
+} crc32c_footer;
+
+/**
+ * @brief Extends a CRC32C with more data.
+ *
+ * Works like zlib's crc32(): start with 0 and pass each result back in, so
+ * crc32c_update(crc32c_update(0, a, n), b, m) is the CRC of a followed by b.
+ * Safe with the MMU off: loads are aligned.
+ *
+ * @param crc The CRC of the data so far, or 0 to start.
+ * @param data The next bytes.
+ * @param length Number of bytes.
+ * @return The CRC of everything so far.
+ */
+uint32_t crc32c_update(uint32_t crc, const void* data, size_t length);
+
+/**
+ * @brief Computes the CRC32C of a byte range of an open file.
+ *
+ * The range is read through fat_map() views, so the CRC is taken straight from
+ * the block cache without copying.
+ *
+ * @param file The open file.
+ * @param offset Byte offset of the first byte.
+ * @param length Number of bytes; must lie inside the file.
+ * @param crc Receives the CRC.
+ * @return 0 on success, CRC32C_ERROR_IO on error (e.g., range past the end, I/O error).
+ */
+int crc32c_file(fat_file* file, uint32_t offset, uint32_t length, uint32_t* crc);
+
+/**
+ * @brief Reads and checks the footer of an open file.
+ *
+ * @param file The open file.
+ * @param footer Receives the footer.
+ * @return 0 if the file ends in a footer covering the rest of it,
+ *         CRC32C_ERROR_NO_FOOTER if it does not, CRC32C_ERROR_IO on I/O error.
+ */
+int crc32c_read_footer(fat_file* file, crc32c_footer* footer);
+
+/**
+ * @brief Checks an open file against its footer.
+ *
+ * @param file The open file.
+ * @return 0 if the CRC matches, CRC32C_ERROR_MISMATCH if it does not,
+ *         CRC32C_ERROR_NO_FOOTER if the file has no footer, CRC32C_ERROR_IO on I/O error.
+ */
+int crc32c_verify_file(fat_file* file);
+
+#endif
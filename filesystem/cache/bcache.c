@@ -0,0 +1,411 @@
+#include "bcache.h"
+#include "../../libc-lite/string.h"
+
+// Entry states
+#define BCACHE_FREE 0 // Not holding any block
+#define BCACHE_LOADING 1 // Read submitted, request not collected yet
+#define BCACHE_VALID 2 // Data matches the disk
+
+typedef struct bcache_entry {
+    uint32_t block_sector; // First sector of the block
+    uint8_t state;
+    bool stale; // Invalidated while pinned; dropped at the last release
+    bool counted; // The lookup that caused the load was already counted as a miss
+    uint16_t pins;
+    int request; // VIO request filling the block while loading
+    struct bcache_entry* hash_next;
+    struct bcache_entry* newer; // LRU list neighbours
+    struct bcache_entry* older;
+} bcache_entry;
+
+static uint8_t bcache_data[BCACHE_POOL_BLOCKS][BCACHE_BLOCK_SIZE] __attribute__((aligned(64)));
+static bcache_entry bcache_entries[BCACHE_POOL_BLOCKS];
+static bcache_entry* bcache_buckets[BCACHE_HASH_BUCKETS];
+
+// Every entry holding a block, most recently used first
+static bcache_entry* bcache_newest;
+static bcache_entry* bcache_oldest;
+
+static uint32_t bcache_used; // Entries holding a block
+static uint32_t bcache_budget = BCACHE_POOL_BLOCKS; // Entries allowed to hold a block
+static bcache_stats bcache_counters;
+
+// Helper functions
+
+static inline uint32_t block_of(uint32_t sector) {
+    return sector & ~(uint32_t)(BCACHE_BLOCK_SECTORS - 1);
+}
+
+static inline uint32_t bucket_of(uint32_t block_sector) {
+    return (block_sector / BCACHE_BLOCK_SECTORS) & (BCACHE_HASH_BUCKETS - 1);
+}
+
+static inline uint8_t* entry_data(bcache_entry* entry) {
+    return bcache_data[entry - bcache_entries];
+}
+
+static void lru_unlink(bcache_entry* entry) {
+    if (entry->newer != NULL) {
+        entry->newer->older = entry->older;
+    } else {
+        bcache_newest = entry->older;
+    }
+    if (entry->older != NULL) {
+        entry->older->newer = entry->newer;
+    } else {
+        bcache_oldest = entry->newer;
+    }
+    entry->newer = NULL;
+    entry->older = NULL;
+}
+
+static void lru_push_newest(bcache_entry* entry) {
+    entry->newer = NULL;
+    entry->older = bcache_newest;
+    if (bcache_newest != NULL) {
+        bcache_newest->newer = entry;
+    } else {
+        bcache_oldest = entry;
+    }
+    bcache_newest = entry;
+}
+
+static bcache_entry* find_entry(uint32_t block_sector) {
+    for (bcache_entry* entry = bcache_buckets[bucket_of(block_sector)]; entry != NULL; entry = entry->hash_next) {
+        if (entry->block_sector == block_sector) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+// Return an entry to the free pool; a read still in flight is collected first
+// since the device is writing into the entry's data
+static void drop_entry(bcache_entry* entry) {
+    if (entry->state == BCACHE_LOADING) {
+        vio_wait(entry->request);
+    }
+
+    bcache_entry** link = &bcache_buckets[bucket_of(entry->block_sector)];
+    while (*link != entry) {
+        link = &(*link)->hash_next;
+    }
+    *link = entry->hash_next;
+
+    lru_unlink(entry);
+    entry->state = BCACHE_FREE;
+    bcache_used--;
+}
+
+// Drop the least recently used block nobody has pinned or is still loading
+// With take_loading, a read nobody collected (e.g. prefetched by a directory
+// walk that ended early) is waited for and dropped when nothing else can go
+static bool evict_one(bool take_loading) {
+    bcache_entry* victim = NULL;
+    for (bcache_entry* entry = bcache_oldest; entry != NULL; entry = entry->newer) {
+        if (entry->pins > 0) {
+            continue;
+        }
+        if (entry->state == BCACHE_VALID) {
+            victim = entry;
+            break;
+        }
+        if (take_loading && victim == NULL) {
+            victim = entry;
+        }
+    }
+    if (victim == NULL) {
+        return false;
+    }
+
+    drop_entry(victim);
+    bcache_counters.evictions++;
+    return true;
+}
+
+// Claim an entry for a block, evicting if the budget is used up
+// Only a block someone is waiting for may wait out another block's read
+static bcache_entry* allocate_entry(uint32_t block_sector, bool demand) {
+    if (bcache_used >= bcache_budget && !evict_one(demand)) {
+        return NULL; // Everything within the budget is pinned or loading
+    }
+
+    bcache_entry* entry = NULL;
+    for (uint32_t i = 0; i < BCACHE_POOL_BLOCKS; i++) {
+        if (bcache_entries[i].state == BCACHE_FREE) {
+            entry = &bcache_entries[i];
+            break;
+        }
+    }
+    if (entry == NULL) {
+        return NULL;
+    }
+
+    entry->block_sector = block_sector;
+    entry->state = BCACHE_LOADING;
+    entry->stale = false;
+    entry->counted = false;
+    entry->pins = 0;
+    entry->request = -1;
+
+    uint32_t bucket = bucket_of(block_sector);
+    entry->hash_next = bcache_buckets[bucket];
+    bcache_buckets[bucket] = entry;
+    lru_push_newest(entry);
+    bcache_used++;
+
+    return entry;
+}
+
+// Start loading a block that is not cached yet; returns false if it could not be submitted
+static bool submit_block(uint32_t block_sector, bool counted, bool demand) {
+    bcache_entry* entry = allocate_entry(block_sector, demand);
+    if (entry == NULL) {
+        return false;
+    }
+
+    entry->request = vio_submit_read(block_sector, BCACHE_BLOCK_SECTORS, entry_data(entry));
+    if (entry->request < 0) {
+        entry->state = BCACHE_VALID; // Nothing in flight to collect
+        drop_entry(entry);
+        return false;
+    }
+    entry->counted = counted;
+
+    return true;
+}
+
+// Find a block, loading it if needed, and mark it most recently used
+static bcache_entry* fetch_block(uint32_t sector) {
+    uint32_t block_sector = block_of(sector);
+    bcache_entry* entry = find_entry(block_sector);
+
+    if (entry != NULL && entry->stale && entry->pins == 0) {
+        drop_entry(entry);
+        entry = NULL;
+    }
+
+    if (entry == NULL) {
+        bcache_counters.misses++;
+        if (!submit_block(block_sector, true, true)) {
+            return NULL;
+        }
+        entry = find_entry(block_sector);
+    } else if (!entry->counted) {
+        bcache_counters.hits++;
+    }
+    entry->counted = false;
+
+    if (entry->state == BCACHE_LOADING) {
+        int result = vio_wait(entry->request);
+        entry->state = BCACHE_VALID;
+        if (result < 0) {
+            drop_entry(entry);
+            return NULL;
+        }
+    }
+
+    lru_unlink(entry);
+    lru_push_newest(entry);
+
+    return entry;
+}
+
+// Submit every block of the range that is not cached yet
+static int prefetch_blocks(uint32_t sector, uint32_t count, bool counted) {
+    int submitted = 0;
+
+    vio_batch_begin();
+    for (uint32_t block_sector = block_of(sector); block_sector < sector + count; block_sector += BCACHE_BLOCK_SECTORS) {
+        if (find_entry(block_sector) != NULL) {
+            continue; // Cached or already loading
+        }
+        if (!submit_block(block_sector, counted, false)) {
+            break; // Out of entries or requests; the rest loads on demand
+        }
+        submitted++;
+        if (counted) {
+            bcache_counters.misses++;
+        }
+    }
+    vio_batch_end();
+
+    return submitted;
+}
+
+// Library functions
+
+void bcache_init(void) {
+    for (uint32_t i = 0; i < BCACHE_POOL_BLOCKS; i++) {
+        if (bcache_entries[i].state == BCACHE_LOADING) {
+            vio_wait(bcache_entries[i].request);
+        }
+        bcache_entries[i].state = BCACHE_FREE;
+        bcache_entries[i].hash_next = NULL;
+        bcache_entries[i].newer = NULL;
+        bcache_entries[i].older = NULL;
+    }
+    for (uint32_t i = 0; i < BCACHE_HASH_BUCKETS; i++) {
+        bcache_buckets[i] = NULL;
+    }
+
+    bcache_newest = NULL;
+    bcache_oldest = NULL;
+    bcache_used = 0;
+    bcache_budget = BCACHE_POOL_BLOCKS;
+    bcache_reset_stats();
+}
+
+uint32_t bcache_set_budget(size_t bytes) {
+    size_t blocks = bytes / BCACHE_BLOCK_SIZE;
+    if (blocks < 1) {
+        blocks = 1;
+    }
+    if (blocks > BCACHE_POOL_BLOCKS) {
+        blocks = BCACHE_POOL_BLOCKS;
+    }
+    bcache_budget = (uint32_t)blocks;
+
+    // Pinned and loading blocks stay until they can go; allocation keeps
+    // evicting until the cache is back within budget
+    while (bcache_used > bcache_budget && evict_one(false)) {
+    }
+
+    return bcache_budget;
+}
+
+int bcache_read(uint32_t sector, uint32_t count, uint8_t* buffer) {
+    if (buffer == NULL || count == 0) {
+        return -1; // Invalid parameters
+    }
+
+    if (count >= BCACHE_BYPASS_SECTORS) {
+        bcache_counters.bypasses++;
+        return vio_read_sectors(sector, count, buffer);
+    }
+
+    // Get every missing block on its way at once, then copy block by block
+    prefetch_blocks(sector, count, true);
+
+    while (count > 0) {
+        uint32_t offset = sector - block_of(sector);
+        uint32_t sectors = BCACHE_BLOCK_SECTORS - offset;
+        if (sectors > count) {
+            sectors = count;
+        }
+
+        bcache_entry* entry = fetch_block(sector);
+        if (entry != NULL) {
+            memcpy(buffer, entry_data(entry) + offset * VIO_SECTOR_SIZE, sectors * VIO_SECTOR_SIZE);
+        } else if (vio_read_sectors(sector, sectors, buffer) < 0) {
+            // Could not cache the block (e.g., it runs past the end of the disk)
+            return -1;
+        }
+
+        sector += sectors;
+        count -= sectors;
+        buffer += sectors * VIO_SECTOR_SIZE;
+    }
+
+    return 0;
+}
+
+int bcache_write(uint32_t sector, uint32_t count, const uint8_t* buffer) {
+    if (buffer == NULL || count == 0) {
+        return -1; // Invalid parameters
+    }
+
+    if (vio_write_sectors(sector, count, buffer) < 0) {
+        return -1;
+    }
+
+    // Bring every cached copy of the range up to date
+    for (uint32_t block_sector = block_of(sector); block_sector < sector + count; block_sector += BCACHE_BLOCK_SECTORS) {
+        bcache_entry* entry = find_entry(block_sector);
+        if (entry == NULL) {
+            continue;
+        }
+
+        if (entry->state == BCACHE_LOADING) {
+            // A read still in flight may carry the old data; let it land first
+            int result = vio_wait(entry->request);
+            entry->state = BCACHE_VALID;
+            if (result < 0) {
+                drop_entry(entry);
+                continue;
+            }
+        }
+
+        uint32_t first = block_sector > sector ? block_sector : sector;
+        uint32_t end = block_sector + BCACHE_BLOCK_SECTORS < sector + count
+            ? block_sector + BCACHE_BLOCK_SECTORS
+            : sector + count;
+        memcpy(entry_data(entry) + (first - block_sector) * VIO_SECTOR_SIZE,
+            buffer + (first - sector) * VIO_SECTOR_SIZE, (end - first) * VIO_SECTOR_SIZE);
+    }
+
+    return 0;
+}
+
+const uint8_t* bcache_get(uint32_t sector) {
+    bcache_entry* entry = fetch_block(sector);
+    if (entry == NULL) {
+        return NULL;
+    }
+
+    entry->pins++;
+    return entry_data(entry) + (sector - entry->block_sector) * VIO_SECTOR_SIZE;
+}
+
+void bcache_release(uint32_t sector) {
+    bcache_entry* entry = find_entry(block_of(sector));
+    if (entry == NULL || entry->pins == 0) {
+        return;
+    }
+
+    if (--entry->pins == 0 && entry->stale) {
+        drop_entry(entry);
+    }
+}
+
+int bcache_prefetch(uint32_t sector, uint32_t count) {
+    if (count == 0) {
+        return -1; // Invalid parameters
+    }
+
+    int submitted = prefetch_blocks(sector, count, false);
+    bcache_counters.prefetches += (uint32_t)submitted;
+    return submitted;
+}
+
+void bcache_invalidate(uint32_t sector, uint32_t count) {
+    if (count == 0) {
+        return;
+    }
+
+    for (uint32_t block_sector = block_of(sector); block_sector < sector + count; block_sector += BCACHE_BLOCK_SECTORS) {
+        bcache_entry* entry = find_entry(block_sector);
+        if (entry == NULL) {
+            continue;
+        }
+        if (entry->pins > 0) {
+            entry->stale = true;
+        } else {
+            drop_entry(entry);
+        }
+    }
+}
+
+void bcache_get_stats(bcache_stats* stats) {
+    if (stats != NULL) {
+        *stats = bcache_counters;
+    }
+}
+
+void bcache_reset_stats(void) {
+    bcache_counters.hits = 0;
+    bcache_counters.misses = 0;
+    bcache_counters.evictions = 0;
+    bcache_counters.bypasses = 0;
+    bcache_counters.prefetches = 0;
+}
@@ -0,0 +1,138 @@
+#ifndef BCACHE_H
+#define BCACHE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "vio.h"
+
+// Block buffer cache between the filesystem and the VIO block driver.
+// The disk is cached in blocks of BCACHE_BLOCK_SECTORS sectors, aligned to that
+// many sectors, so a directory cluster or a run of FAT sectors is usually one block.
+
+#define BCACHE_BLOCK_SECTORS 8
+#define BCACHE_BLOCK_SIZE (BCACHE_BLOCK_SECTORS * VIO_SECTOR_SIZE)
+
+// Blocks backing the cache; the budget (bcache_set_budget()) can only lower this
+#ifndef BCACHE_POOL_BLOCKS
+#define BCACHE_POOL_BLOCKS 16
+#endif
+
+// Lookup buckets (power of 2)
+#define BCACHE_HASH_BUCKETS 64
+
+// Reads of at least this many sectors go straight to the device; file data that
+// is read once would only push metadata out of the cache
+#define BCACHE_BYPASS_SECTORS 64
+
+typedef struct {
+    uint32_t hits; // Lookups served from memory
+    uint32_t misses; // Lookups that had to read the block from the device
+    uint32_t evictions; // Blocks dropped to make room for others
+    uint32_t bypasses; // Large reads sent straight to the device
+    uint32_t prefetches; // Blocks read ahead by bcache_prefetch()
+} bcache_stats;
+
+/**
+ * @brief Empties the cache and resets the budget and the counters.
+ *
+ * Must be called after vio_init() and before any other bcache function,
+ * and again whenever the disk behind the VIO driver changes.
+ */
+void bcache_init(void);
+
+/**
+ * @brief Limits how much memory the cache may use.
+ *
+ * Unpinned blocks beyond the new budget are evicted right away.
+ *
+ * @param bytes The budget in bytes; rounded down to whole blocks and capped at
+ *              BCACHE_POOL_BLOCKS * BCACHE_BLOCK_SIZE. At least one block is kept.
+ * @return The number of blocks the cache may now hold.
+ */
+uint32_t bcache_set_budget(size_t bytes);
+
+/**
+ * @brief Reads sectors through the cache.
+ *
+ * Missing blocks in the range are fetched together, so a multi-block miss costs
+ * one round trip. Reads of BCACHE_BYPASS_SECTORS sectors or more skip the cache.
+ *
+ * @param sector The first sector to read.
+ * @param count The number of sectors to read.
+ * @param buffer Receives count * VIO_SECTOR_SIZE bytes.
+ * @return 0 on success, negative value on error (e.g., I/O error).
+ */
+int bcache_read(uint32_t sector, uint32_t count, uint8_t* buffer);
+
+/**
+ * @brief Writes sectors through the cache.
+ *
+ * The data goes to the device with vio_write_sectors() (so it is staged until
+ * vio_flush() like any other write), and cached copies of the sectors are
+ * updated in place, including pinned ones. Blocks that are not cached are not
+ * loaded.
+ *
+ * @param sector The first sector to write.
+ * @param count The number of sectors to write.
+ * @param buffer Holds count * VIO_SECTOR_SIZE bytes.
+ * @return 0 on success, negative value on error (e.g., read-only device, I/O error).
+ */
+int bcache_write(uint32_t sector, uint32_t count, const uint8_t* buffer);
+
+/**
+ * @brief Returns the cached copy of a sector and pins its block.
+ *
+ * The data stays valid and in place until bcache_release() is called for the
+ * same sector. The rest of the block (up to BCACHE_BLOCK_SECTORS sectors from
+ * the block start) is valid too.
+ *
+ * @param sector The sector to look up.
+ * @return Pointer to the sector's data, or NULL on error (I/O error, or every
+ *         block within the budget is pinned).
+ */
+const uint8_t* bcache_get(uint32_t sector);
+
+/**
+ * @brief Unpins the block of a sector returned by bcache_get().
+ *
+ * @param sector The sector passed to bcache_get().
+ */
+void bcache_release(uint32_t sector);
+
+/**
+ * @brief Starts reading blocks into the cache without waiting for them.
+ *
+ * Blocks that are already cached or loading are skipped. The reads complete
+ * in the background and are collected by the next lookup that needs them;
+ * blocks nobody collects are dropped once a lookup needs their entries.
+ *
+ * @param sector The first sector to prefetch.
+ * @param count The number of sectors to prefetch.
+ * @return The number of blocks submitted, or negative value on error.
+ */
+int bcache_prefetch(uint32_t sector, uint32_t count);
+
+/**
+ * @brief Drops cached copies of sectors, e.g. after writing them behind the cache.
+ *
+ * Pinned blocks are kept but marked so they are re-read once released.
+ *
+ * @param sector The first sector.
+ * @param count The number of sectors.
+ */
+void bcache_invalidate(uint32_t sector, uint32_t count);
+
+/**
+ * @brief Copies the hit/miss counters.
+ *
+ * @param stats Filled with the counters since bcache_init() or bcache_reset_stats().
+ */
+void bcache_get_stats(bcache_stats* stats);
+
+/**
+ * @brief Resets the hit/miss counters to zero.
+ */
+void bcache_reset_stats(void);
+
+#endif
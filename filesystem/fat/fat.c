@@ -1,16 +1,9 @@
 #include "fat.h"
 #include "vio.h"
+#include "bcache.h"
 #include "../../uart/uart.h"
-
-// Simple memcpy implementation for freestanding environment
-static void* memcpy_local(void* dest, const void* src, size_t n) {
-    uint8_t* d = (uint8_t*)dest;
-    const uint8_t* s = (const uint8_t*)src;
-    for (size_t i = 0; i < n; i++) {
-        d[i] = s[i];
-    }
-    return dest;
-}
+#include "../../trace/trace.h"
+#include "../../libc-lite/string.h"
 
 static fat_master_boot_record mbr;
 static fat_volume_id volume_id;
@@ -19,14 +12,75 @@ static uint32_t fat_begin_lba;
 static uint32_t cluster_start_lba;
 static uint8_t sectors_per_cluster;
 static uint32_t root_cluster;
+static uint32_t fat_size_sectors;
+static uint32_t fat_count; // Copies of the FAT
+static uint32_t max_cluster; // Highest cluster number with data behind it
+
+// FSInfo: free cluster count and next-free hint, written back by fat_sync()
+static uint32_t fs_info_lba; // 0 when the volume has no valid FSInfo sector
+static uint32_t free_count; // FAT_FS_INFO_UNKNOWN until every cluster has been looked at
+static uint32_t next_free_hint;
+static bool fs_info_dirty;
+
+// Scratch sector for read-modify-write of directory entries, FSInfo and partial data sectors
+static uint8_t sector_buffer[FAT_SECTOR_SIZE] __attribute__((aligned(64)));
+
+// FAT cache: windows of FAT_TABLE_WINDOW_SECTORS consecutive FAT sectors
+// When the whole FAT fits, fat_mount() loads all of it and nothing is evicted;
+// otherwise the least recently used window is replaced on a miss
+#define FAT_TABLE_WINDOWS (FAT_TABLE_CACHE_SIZE / (FAT_TABLE_WINDOW_SECTORS * FAT_SECTOR_SIZE))
+#define FAT_TABLE_WINDOW_ENTRIES (FAT_TABLE_WINDOW_SECTORS * FAT_SECTOR_SIZE / sizeof(uint32_t))
+#define FAT_TABLE_NO_WINDOW 0xFFFFFFFF
+
+static uint32_t fat_table[FAT_TABLE_WINDOWS][FAT_TABLE_WINDOW_ENTRIES] __attribute__((aligned(64)));
+static uint32_t fat_table_window[FAT_TABLE_WINDOWS]; // Window of the FAT held by each slot
+static uint32_t fat_table_last_used[FAT_TABLE_WINDOWS];
+static uint16_t fat_table_dirty[FAT_TABLE_WINDOWS]; // Changed sectors of each slot, one bit per sector
+static uint32_t fat_table_clock;
+
+// Free-cluster bitmap, one bit per cluster (1 = free), built from the FAT one
+// window of FAT_TABLE_WINDOW_ENTRIES clusters at a time: all at mount when the
+// FAT cache holds the whole FAT, otherwise as allocation reaches each window
+#define FAT_BITMAP_WINDOWS (FAT_FREE_BITMAP_CLUSTERS / FAT_TABLE_WINDOW_ENTRIES)
+
+static uint32_t free_bitmap[FAT_FREE_BITMAP_CLUSTERS / 32];
+static bool free_bitmap_scanned[FAT_BITMAP_WINDOWS];
+static uint32_t free_bitmap_windows_scanned;
+
+// Two chunk buffers for fat_read_stream(): one loading while the other is handed out
+static uint8_t stream_buffer[2][FAT_STREAM_CHUNK_SIZE] __attribute__((aligned(64)));
+
+// Readahead for sequential fat_read_at() calls: one request in flight at a time,
+// for the file that read last
+static uint8_t readahead_buffer[FAT_READAHEAD_SIZE] __attribute__((aligned(64)));
+static const fat_file* readahead_file; // NULL when the buffer holds nothing
+static uint32_t readahead_start; // File offset of the first byte in the buffer
+static uint32_t readahead_length;
+static int readahead_request = -1; // Still loading when not negative
+
+// Directory-entry cache: entries found by fat_open_path(), keyed by
+// (parent directory cluster, 8.3 name) and replaced in round-robin order
+#define FAT_DENTRY_BUCKETS 64 // Power of 2
+#define FAT_DENTRY_NONE 0xFFFF
+
+typedef struct {
+    uint32_t parent_cluster;
+    char name[11];
+    uint8_t attr;
+    uint32_t first_cluster;
+    uint32_t file_size;
+    uint32_t entry_sector; // Where the entry lives on disk
+    uint16_t entry_offset;
+    uint16_t hash_next; // Next entry in the bucket, or FAT_DENTRY_NONE
+    bool used;
+} fat_dentry;
 
-// Static buffer for reading FAT sectors to avoid stack overflow
-static uint32_t fat_sector_buffer[FAT_SECTOR_SIZE / sizeof(uint32_t)];
+static fat_dentry dentry_cache[FAT_DENTRY_CACHE_SIZE];
+static uint16_t dentry_buckets[FAT_DENTRY_BUCKETS];
+static uint32_t dentry_next_victim;
 
-// Static buffer for directory entries (supports up to 128 sectors per cluster)
-// Max size: 128 sectors * 512 bytes / 32 bytes per entry = 2048 entries
-#define MAX_DIR_ENTRIES 2048
-static fat_directory_entry dir_entry_buffer[MAX_DIR_ENTRIES];
+// fat_open() searches at most this many directory levels deep
+#define FAT_MAX_SEARCH_DEPTH 8
 
 
 // Helper functions for safe packed struct access
@@ -34,47 +88,1058 @@ static fat_directory_entry dir_entry_buffer[MAX_DIR_ENTRIES];
 // Safe read of uint32_t from potentially unaligned packed struct
 static inline uint32_t read_uint32_packed(const void* ptr) {
     uint32_t value;
-    memcpy_local(&value, ptr, sizeof(uint32_t));
+    memcpy(&value, ptr, sizeof(uint32_t));
     return value;
 }
 
 // Safe read of uint16_t from potentially unaligned packed struct
 static inline uint16_t read_uint16_packed(const void* ptr) {
     uint16_t value;
-    memcpy_local(&value, ptr, sizeof(uint16_t));
+    memcpy(&value, ptr, sizeof(uint16_t));
     return value;
 }
 
 // Helper functions
 
-// Convert a cluster number to its corresponding LBA
-static inline uint32_t cluster_to_lba(uint32_t cluster) {
-    return cluster_start_lba + ((cluster - 2) * sectors_per_cluster);
+// Convert a cluster number to its corresponding LBA
+static inline uint32_t cluster_to_lba(uint32_t cluster) {
+    return cluster_start_lba + ((cluster - 2) * sectors_per_cluster);
+}
+
+// Get the size of a cluster in bytes
+static inline uint32_t cluster_size_bytes() {
+    return sectors_per_cluster * FAT_SECTOR_SIZE;
+}
+
+// Write the changed sectors of a FAT cache slot to every copy of the FAT
+// Consecutive changed sectors go out as one write per copy
+static int flush_fat_slot(uint32_t slot) {
+    uint16_t dirty = fat_table_dirty[slot];
+    uint32_t first_sector = fat_table_window[slot] * FAT_TABLE_WINDOW_SECTORS;
+    uint32_t sector = 0;
+
+    while (sector < FAT_TABLE_WINDOW_SECTORS) {
+        if (!(dirty & (1u << sector))) {
+            sector++;
+            continue;
+        }
+
+        uint32_t run = 1;
+        while (sector + run < FAT_TABLE_WINDOW_SECTORS && (dirty & (1u << (sector + run)))) {
+            run++;
+        }
+
+        const uint8_t* data = (const uint8_t*)fat_table[slot] + sector * FAT_SECTOR_SIZE;
+        for (uint32_t copy = 0; copy < fat_count; copy++) {
+            uint32_t lba = fat_begin_lba + copy * fat_size_sectors + first_sector + sector;
+            if (vio_write_sectors(lba, run, data) < 0) {
+                return -1;
+            }
+        }
+        sector += run;
+    }
+
+    fat_table_dirty[slot] = 0;
+    return 0;
+}
+
+// Read one window of the FAT into a slot of the FAT cache
+static int load_fat_window(uint32_t slot, uint32_t window) {
+    if (fat_table_dirty[slot] != 0 && flush_fat_slot(slot) < 0) {
+        return -1; // Could not write back the window being replaced
+    }
+
+    uint32_t first_sector = window * FAT_TABLE_WINDOW_SECTORS;
+    uint32_t sectors = fat_size_sectors - first_sector;
+    if (sectors > FAT_TABLE_WINDOW_SECTORS) {
+        sectors = FAT_TABLE_WINDOW_SECTORS;
+    }
+
+    fat_table_window[slot] = FAT_TABLE_NO_WINDOW;
+    TRACE(TRACE_FAT_FETCH, fat_begin_lba + first_sector, sectors);
+    if (vio_read_sectors(fat_begin_lba + first_sector, sectors, (uint8_t*)fat_table[slot]) < 0) {
+        return -1;
+    }
+    fat_table_window[slot] = window;
+
+    return 0;
+}
+
+// Fill the FAT cache from the start of the FAT, where the chains of the files
+// written first (and the root directory) live; one bulk read covers every slot
+static int load_fat_table() {
+    uint32_t windows = (fat_size_sectors + FAT_TABLE_WINDOW_SECTORS - 1) / FAT_TABLE_WINDOW_SECTORS;
+    if (windows > FAT_TABLE_WINDOWS) {
+        windows = FAT_TABLE_WINDOWS;
+    }
+
+    uint32_t sectors = windows * FAT_TABLE_WINDOW_SECTORS;
+    if (sectors > fat_size_sectors) {
+        sectors = fat_size_sectors;
+    }
+
+    for (uint32_t slot = 0; slot < FAT_TABLE_WINDOWS; slot++) {
+        fat_table_window[slot] = FAT_TABLE_NO_WINDOW;
+        fat_table_last_used[slot] = 0;
+        fat_table_dirty[slot] = 0;
+    }
+    fat_table_clock = 0;
+
+    // The slots are contiguous, so window i lands in slot i
+    TRACE(TRACE_FAT_FETCH, fat_begin_lba, sectors);
+    if (vio_read_sectors(fat_begin_lba, sectors, (uint8_t*)fat_table) < 0) {
+        return -1;
+    }
+    for (uint32_t slot = 0; slot < windows; slot++) {
+        fat_table_window[slot] = slot;
+    }
+
+    return 0;
+}
+
+// Find the FAT cache slot holding a cluster's entry, loading its window if needed
+static int find_fat_slot(uint32_t cluster, uint32_t* slot_out) {
+    if (cluster / (FAT_SECTOR_SIZE / sizeof(uint32_t)) >= fat_size_sectors) {
+        return -1; // Cluster outside the FAT
+    }
+    uint32_t window = cluster / FAT_TABLE_WINDOW_ENTRIES;
+
+    uint32_t slot = FAT_TABLE_WINDOWS;
+    uint32_t oldest = 0;
+    for (uint32_t i = 0; i < FAT_TABLE_WINDOWS; i++) {
+        if (fat_table_window[i] == window) {
+            slot = i;
+            break;
+        }
+        if (fat_table_last_used[i] < fat_table_last_used[oldest]) {
+            oldest = i;
+        }
+    }
+
+    if (slot == FAT_TABLE_WINDOWS) {
+        // Only reached when the FAT is larger than the cache
+        slot = oldest;
+        if (load_fat_window(slot, window) < 0) {
+            return -1;
+        }
+    }
+
+    fat_table_last_used[slot] = ++fat_table_clock;
+    *slot_out = slot;
+
+    return 0;
+}
+
+// Look up the FAT entry for a cluster (the next cluster in its chain)
+static int read_fat_entry(uint32_t cluster, uint32_t* entry) {
+    uint32_t slot;
+    if (find_fat_slot(cluster, &slot) < 0) {
+        return -1;
+    }
+
+    *entry = fat_table[slot][cluster % FAT_TABLE_WINDOW_ENTRIES] & 0x0FFFFFFF;
+
+    return 0;
+}
+
+// Change the FAT entry for a cluster in the FAT cache; fat_sync() writes it out
+static int write_fat_entry(uint32_t cluster, uint32_t value) {
+    uint32_t slot;
+    if (find_fat_slot(cluster, &slot) < 0) {
+        return -1;
+    }
+
+    uint32_t index = cluster % FAT_TABLE_WINDOW_ENTRIES;
+    // The top 4 bits are reserved and must be kept
+    fat_table[slot][index] = (fat_table[slot][index] & 0xF0000000) | (value & 0x0FFFFFFF);
+    fat_table_dirty[slot] |= 1u << (index * sizeof(uint32_t) / FAT_SECTOR_SIZE);
+
+    return 0;
+}
+
+// Fill in the free-cluster bitmap for one window of clusters from the FAT
+static int scan_bitmap_window(uint32_t window) {
+    uint32_t first = window * FAT_TABLE_WINDOW_ENTRIES;
+    uint32_t end = first + FAT_TABLE_WINDOW_ENTRIES;
+
+    for (uint32_t cluster = first; cluster < end; cluster++) {
+        uint32_t entry = 1; // Clusters 0 and 1 and those past the volume are never free
+        if (cluster >= 2 && cluster <= max_cluster && read_fat_entry(cluster, &entry) < 0) {
+            return -1;
+        }
+        if (entry == 0) {
+            free_bitmap[cluster / 32] |= 1u << (cluster % 32);
+        } else {
+            free_bitmap[cluster / 32] &= ~(1u << (cluster % 32));
+        }
+    }
+
+    free_bitmap_scanned[window] = true;
+    free_bitmap_windows_scanned++;
+
+    return 0;
+}
+
+// Count the free clusters once the whole bitmap is known (FSInfo did not say)
+static void count_free_clusters() {
+    if (free_count != FAT_FS_INFO_UNKNOWN || free_bitmap_windows_scanned * FAT_TABLE_WINDOW_ENTRIES <= max_cluster) {
+        return;
+    }
+
+    free_count = 0;
+    for (uint32_t i = 0; i < FAT_FREE_BITMAP_CLUSTERS / 32; i++) {
+        free_count += (uint32_t)__builtin_popcount(free_bitmap[i]);
+    }
+    fs_info_dirty = true;
+}
+
+// Take a free cluster, searching the bitmap from the next-free hint and wrapping
+// around once; the new cluster is marked end of chain
+static int allocate_cluster(uint32_t* cluster_out) {
+    if (free_count == 0) {
+        return -1; // Disk full
+    }
+
+    uint32_t limit = max_cluster + 1 < FAT_FREE_BITMAP_CLUSTERS ? max_cluster + 1 : FAT_FREE_BITMAP_CLUSTERS;
+    uint32_t start = next_free_hint >= 2 && next_free_hint < limit ? next_free_hint : 2;
+    uint32_t cluster = start;
+    bool wrapped = false;
+
+    for (;;) {
+        if (cluster >= limit) {
+            if (wrapped) {
+                return -1; // No free cluster below the bitmap limit
+            }
+            wrapped = true;
+            cluster = 2;
+        }
+        if (wrapped && cluster >= start) {
+            return -1;
+        }
+
+        uint32_t window = cluster / FAT_TABLE_WINDOW_ENTRIES;
+        if (!free_bitmap_scanned[window] && scan_bitmap_window(window) < 0) {
+            return -1;
+        }
+
+        // Look at the rest of this 32-cluster word at once
+        uint32_t bits = free_bitmap[cluster / 32] & (0xFFFFFFFFu << (cluster % 32));
+        if (bits == 0) {
+            cluster = (cluster / 32 + 1) * 32;
+            continue;
+        }
+
+        cluster = (cluster / 32) * 32 + (uint32_t)__builtin_ctz(bits);
+        if (cluster >= limit) {
+            continue; // Past the end; wraps on the next pass
+        }
+        break;
+    }
+
+    count_free_clusters();
+    if (write_fat_entry(cluster, 0x0FFFFFFF) < 0) {
+        return -1;
+    }
+    free_bitmap[cluster / 32] &= ~(1u << (cluster % 32));
+    if (free_count != FAT_FS_INFO_UNKNOWN) {
+        free_count--;
+    }
+    next_free_hint = cluster + 1;
+    fs_info_dirty = true;
+
+    *cluster_out = cluster;
+    return 0;
+}
+
+// Free every cluster of a chain, starting at cluster
+static int free_chain(uint32_t cluster) {
+    uint32_t freed = 0;
+
+    while (cluster >= 2 && cluster < FAT_END_OF_CHAIN) {
+        if (freed++ > max_cluster) {
+            return -1; // Chain loops back on itself
+        }
+
+        uint32_t next_cluster;
+        if (read_fat_entry(cluster, &next_cluster) < 0 || write_fat_entry(cluster, 0) < 0) {
+            return -1;
+        }
+
+        if (cluster < FAT_FREE_BITMAP_CLUSTERS) {
+            free_bitmap[cluster / 32] |= 1u << (cluster % 32);
+        }
+        if (free_count != FAT_FS_INFO_UNKNOWN) {
+            free_count++;
+        }
+        if (cluster < next_free_hint) {
+            next_free_hint = cluster;
+        }
+        fs_info_dirty = true;
+
+        cluster = next_cluster;
+    }
+
+    return 0;
+}
+
+// Follow a chain from a cluster while the clusters are contiguous
+// Returns the run length and the cluster the chain continues with
+static int walk_run(uint32_t first_cluster, uint32_t* length, uint32_t* next_cluster) {
+    uint32_t cluster = first_cluster;
+    uint32_t count = 1;
+    uint32_t entry;
+
+    for (;;) {
+        if (read_fat_entry(cluster, &entry) < 0) {
+            return -1;
+        }
+        if (entry != cluster + 1) {
+            break;
+        }
+        cluster = entry;
+        count++;
+    }
+
+    if (entry < 2) {
+        return -1; // Chain runs into a free cluster
+    }
+
+    *length = count;
+    *next_cluster = entry;
+    return 0;
+}
+
+// Map the cluster chain of a file into runs of contiguous clusters
+static int map_extents(fat_file* file) {
+    file->extent_count = 0;
+    file->current_extent = 0;
+    file->current_index = 0;
+    file->unmapped_cluster = FAT_END_OF_CHAIN;
+
+    if (file->start_cluster < 2) {
+        // Empty files have no clusters
+        file->current_cluster = FAT_END_OF_CHAIN;
+        return 0;
+    }
+
+    uint32_t max_clusters = fat_size_sectors * (FAT_SECTOR_SIZE / sizeof(uint32_t));
+    uint32_t cluster = file->start_cluster;
+    uint32_t file_cluster = 0;
+
+    while (cluster < FAT_END_OF_CHAIN) {
+        if (file->extent_count == FAT_MAX_EXTENTS) {
+            file->unmapped_cluster = cluster; // fat_read() follows the FAT from here
+            break;
+        }
+
+        uint32_t length;
+        uint32_t next_cluster;
+        if (walk_run(cluster, &length, &next_cluster) < 0) {
+            return -1;
+        }
+
+        fat_extent* extent = &file->extents[file->extent_count++];
+        extent->start_cluster = cluster;
+        extent->cluster_count = length;
+        extent->file_cluster = file_cluster;
+
+        file_cluster += length;
+        if (file_cluster > max_clusters) {
+            return -1; // Chain loops back on itself
+        }
+        cluster = next_cluster;
+    }
+
+    return 0;
+}
+
+// Position in a file's chain, advanced one run of contiguous clusters at a time
+typedef struct {
+    uint32_t cluster; // Next cluster to hand out
+    uint32_t extent; // Extent holding cluster, or extent_count past the mapped runs
+} run_cursor;
+
+// Find the cluster at an index within the file: a binary search of the extents,
+// then a walk through the FAT only for files with more than FAT_MAX_EXTENTS runs
+static int locate_cluster(fat_file* file, uint32_t index, run_cursor* cursor) {
+    uint32_t low = 0;
+    uint32_t high = file->extent_count;
+    while (low < high) {
+        uint32_t middle = (low + high) / 2;
+        if (file->extents[middle].file_cluster <= index) {
+            low = middle + 1;
+        } else {
+            high = middle;
+        }
+    }
+
+    if (low > 0) {
+        fat_extent* extent = &file->extents[low - 1];
+        if (index < extent->file_cluster + extent->cluster_count) {
+            cursor->cluster = extent->start_cluster + (index - extent->file_cluster);
+            cursor->extent = low - 1;
+            return 0;
+        }
+    }
+
+    // Past the mapped runs: follow the FAT from the first unmapped cluster
+    uint32_t cluster = file->unmapped_cluster;
+    uint32_t position = 0;
+    if (file->extent_count > 0) {
+        fat_extent* last = &file->extents[file->extent_count - 1];
+        position = last->file_cluster + last->cluster_count;
+    }
+    while (cluster < FAT_END_OF_CHAIN && position < index) {
+        if (read_fat_entry(cluster, &cluster) < 0) {
+            return -1;
+        }
+        position++;
+    }
+
+    // An index just past the last cluster leaves the cursor at the end of the chain
+    cursor->cluster = cluster;
+    cursor->extent = file->extent_count;
+    return 0;
+}
+
+// Hand out the run of contiguous clusters at the cursor and move past it
+// Returns 1 with a run, 0 at the end of the chain, negative on error
+static int next_run(fat_file* file, run_cursor* cursor, uint32_t* first_cluster, uint32_t* length) {
+    if (cursor->cluster >= FAT_END_OF_CHAIN) {
+        return 0;
+    }
+
+    uint32_t next_cluster;
+    if (cursor->extent < file->extent_count) {
+        fat_extent* extent = &file->extents[cursor->extent];
+        *length = extent->cluster_count - (cursor->cluster - extent->start_cluster);
+        cursor->extent++;
+        next_cluster = cursor->extent < file->extent_count
+            ? file->extents[cursor->extent].start_cluster
+            : file->unmapped_cluster;
+    } else if (walk_run(cursor->cluster, length, &next_cluster) < 0) {
+        return -1; // Corrupt chain
+    }
+
+    *first_cluster = cursor->cluster;
+    cursor->cluster = next_cluster;
+    TRACE(TRACE_FAT_CLUSTER, *first_cluster, *length);
+    return 1;
+}
+
+// Copy part of one sector through the block cache
+static int read_partial_sector(uint32_t lba, uint32_t offset, uint32_t length, uint8_t* buffer) {
+    TRACE(TRACE_FAT_FETCH, lba, 1);
+    const uint8_t* sector = bcache_get(lba);
+    if (sector == NULL) {
+        return -1;
+    }
+    memcpy(buffer, sector + offset, length);
+    bcache_release(lba);
+    return 0;
+}
+
+// Read bytes from consecutive sectors; whole sectors go straight into the buffer,
+// only a partial first or last sector is copied through the block cache
+static int read_bytes(uint32_t lba, uint32_t offset, uint32_t length, uint8_t* buffer) {
+    if (offset != 0) {
+        uint32_t head = FAT_SECTOR_SIZE - offset;
+        if (head > length) {
+            head = length;
+        }
+        if (read_partial_sector(lba, offset, head, buffer) < 0) {
+            return -1;
+        }
+        lba++;
+        buffer += head;
+        length -= head;
+    }
+
+    uint32_t sectors = length / FAT_SECTOR_SIZE;
+    if (sectors > 0) {
+        TRACE(TRACE_FAT_FETCH, lba, sectors);
+        if (vio_read_sectors(lba, sectors, buffer) < 0) {
+            return -1;
+        }
+        lba += sectors;
+        buffer += sectors * FAT_SECTOR_SIZE;
+        length -= sectors * FAT_SECTOR_SIZE;
+    }
+
+    if (length > 0) {
+        return read_partial_sector(lba, 0, length, buffer);
+    }
+    return 0;
+}
+
+// Forget the readahead buffer, collecting its read first since the device may
+// still be writing into it
+static void readahead_drop() {
+    if (readahead_request >= 0) {
+        vio_wait(readahead_request);
+        readahead_request = -1;
+    }
+    readahead_file = NULL;
+}
+
+// Copy what the readahead buffer holds from offset on
+// Returns the bytes copied (0 if offset is not in the buffer), negative on error
+static int readahead_copy(const fat_file* file, uint32_t offset, uint32_t length, uint8_t* buffer) {
+    if (readahead_file != file || offset < readahead_start || offset >= readahead_start + readahead_length) {
+        return 0;
+    }
+
+    if (readahead_request >= 0) {
+        int status = vio_wait(readahead_request);
+        readahead_request = -1;
+        if (status < 0) {
+            readahead_file = NULL;
+            return -1; // Read failed
+        }
+    }
+
+    uint32_t available = readahead_start + readahead_length - offset;
+    uint32_t take = available < length ? available : length;
+    memcpy(buffer, readahead_buffer + (offset - readahead_start), take);
+    return (int)take;
+}
+
+// Start reading the window after offset into the readahead buffer, unless the
+// buffer already holds the bytes at offset; stays within one run of clusters
+static void readahead_submit(fat_file* file, uint32_t offset) {
+    if (readahead_file == file && offset >= readahead_start && offset < readahead_start + readahead_length) {
+        return; // The next read is covered already
+    }
+    readahead_drop();
+
+    uint32_t cluster_bytes = cluster_size_bytes();
+    run_cursor cursor;
+    if (offset >= file->file_size || locate_cluster(file, offset / cluster_bytes, &cursor) < 0) {
+        return;
+    }
+    uint32_t first_cluster;
+    uint32_t run_length;
+    if (next_run(file, &cursor, &first_cluster, &run_length) <= 0) {
+        return;
+    }
+
+    // Whole sectors from the one holding offset, clipped to the run, the file,
+    // the window and the largest single request
+    uint32_t start = offset - offset % FAT_SECTOR_SIZE;
+    uint32_t run_bytes = run_length * cluster_bytes - start % cluster_bytes;
+    uint32_t length = file->readahead_window;
+    if (length > run_bytes) {
+        length = run_bytes;
+    }
+    if (length > file->file_size - start) {
+        length = file->file_size - start;
+    }
+    if (length > vio_max_request_sectors() * FAT_SECTOR_SIZE) {
+        length = vio_max_request_sectors() * FAT_SECTOR_SIZE;
+    }
+
+    uint32_t sectors = (length + FAT_SECTOR_SIZE - 1) / FAT_SECTOR_SIZE;
+    uint32_t lba = cluster_to_lba(first_cluster) + (start % cluster_bytes) / FAT_SECTOR_SIZE;
+    TRACE(TRACE_FAT_FETCH, lba, sectors);
+    readahead_request = vio_submit_read(lba, sectors, readahead_buffer);
+    if (readahead_request < 0) {
+        return; // Out of requests; the next read goes to the device
+    }
+
+    readahead_file = file;
+    readahead_start = start;
+    readahead_length = length;
+}
+
+// Change part of one sector: read it through the block cache, patch it, write it back
+static int write_partial_sector(uint32_t lba, uint32_t offset, uint32_t length, const uint8_t* data) {
+    if (bcache_read(lba, 1, sector_buffer) < 0) {
+        return -1;
+    }
+    memcpy(sector_buffer + offset, data, length);
+    return bcache_write(lba, 1, sector_buffer);
+}
+
+// Write bytes to consecutive sectors; the counterpart of read_bytes()
+static int write_bytes(uint32_t lba, uint32_t offset, uint32_t length, const uint8_t* data) {
+    if (offset != 0) {
+        uint32_t head = FAT_SECTOR_SIZE - offset;
+        if (head > length) {
+            head = length;
+        }
+        if (write_partial_sector(lba, offset, head, data) < 0) {
+            return -1;
+        }
+        lba++;
+        data += head;
+        length -= head;
+    }
+
+    uint32_t sectors = length / FAT_SECTOR_SIZE;
+    if (sectors > 0) {
+        if (bcache_write(lba, sectors, data) < 0) {
+            return -1;
+        }
+        lba += sectors;
+        data += sectors * FAT_SECTOR_SIZE;
+        length -= sectors * FAT_SECTOR_SIZE;
+    }
+
+    if (length > 0) {
+        return write_partial_sector(lba, 0, length, data);
+    }
+    return 0;
+}
+
+// Write bytes at an offset within a file whose chain already covers them
+static int write_at(fat_file* file, uint32_t offset, uint32_t length, const uint8_t* data) {
+    uint32_t cluster_bytes = cluster_size_bytes();
+    run_cursor cursor;
+    if (locate_cluster(file, offset / cluster_bytes, &cursor) < 0) {
+        return -1;
+    }
+
+    uint32_t skip = offset % cluster_bytes;
+    while (length > 0) {
+        uint32_t first_cluster;
+        uint32_t run_length;
+        if (next_run(file, &cursor, &first_cluster, &run_length) <= 0) {
+            return -1; // Chain shorter than the data
+        }
+
+        uint32_t run_bytes = run_length * cluster_bytes - skip;
+        uint32_t take = run_bytes < length ? run_bytes : length;
+        uint32_t lba = cluster_to_lba(first_cluster) + skip / FAT_SECTOR_SIZE;
+        if (write_bytes(lba, skip % FAT_SECTOR_SIZE, take, data) < 0) {
+            return -1;
+        }
+
+        data += take;
+        length -= take;
+        skip = 0;
+    }
+
+    return 0;
+}
+
+// Add a newly allocated cluster to the end of a file's extents
+static void extend_extents(fat_file* file, uint32_t cluster, uint32_t file_cluster) {
+    if (file->unmapped_cluster < FAT_END_OF_CHAIN) {
+        return; // The chain is already followed through the FAT past the extents
+    }
+
+    if (file->extent_count > 0) {
+        fat_extent* last = &file->extents[file->extent_count - 1];
+        if (last->start_cluster + last->cluster_count == cluster) {
+            last->cluster_count++;
+            return;
+        }
+    }
+
+    if (file->extent_count == FAT_MAX_EXTENTS) {
+        file->unmapped_cluster = cluster;
+        return;
+    }
+
+    fat_extent* extent = &file->extents[file->extent_count++];
+    extent->start_cluster = cluster;
+    extent->cluster_count = 1;
+    extent->file_cluster = file_cluster;
+}
+
+// Get the starting cluster of a directory entry
+static inline uint32_t get_cluster(const fat_directory_entry* entry) {
+    return (entry->first_cluster_high << 16) | entry->first_cluster_low;
+}
+
+// Compare two filenames
+static bool filename_compare(const char* name1, const char* name2) {
+    return memcmp(name1, name2, 11) == 0;
+}
+
+// Position in a directory, advanced one entry at a time across its cluster chain
+typedef struct {
+    uint32_t cluster; // Directory cluster being read
+    uint32_t index; // Next entry within the cluster
+    uint32_t entry_sector; // Where the last entry returned lives
+    uint32_t entry_offset;
+} dir_cursor;
+
+// Return the next short-name entry of a directory, skipping long-name parts,
+// deleted entries and the volume label
+// Entries are copied out of the block cache, so every level of a search keeps
+// its own entry and nothing is shared between nested directory walks
+// Returns 1 with an entry, 0 at the end of the directory, negative on error
+static int next_dir_entry(dir_cursor* cursor, fat_directory_entry* entry) {
+    uint32_t entries_per_cluster = cluster_size_bytes() / sizeof(fat_directory_entry);
+
+    for (;;) {
+        if (cursor->cluster < 2 || cursor->cluster >= FAT_END_OF_CHAIN) {
+            return 0;
+        }
+
+        if (cursor->index == entries_per_cluster) {
+            // Directories span clusters like files do
+            if (read_fat_entry(cursor->cluster, &cursor->cluster) < 0) {
+                return -1;
+            }
+            cursor->index = 0;
+            continue;
+        }
+
+        if (cursor->index == 0) {
+            // Entering a cluster: get it and the start of the next one in the chain
+            // on their way, so a walk that carries on does not stall at the boundary
+            // Only one block of the next cluster: most lookups end before it, and
+            // with large clusters a whole one would fill much of the cache
+            uint32_t next_cluster;
+            bcache_prefetch(cluster_to_lba(cursor->cluster), sectors_per_cluster);
+            if (read_fat_entry(cursor->cluster, &next_cluster) == 0 &&
+                next_cluster >= 2 && next_cluster < FAT_END_OF_CHAIN) {
+                bcache_prefetch(cluster_to_lba(next_cluster),
+                    sectors_per_cluster < BCACHE_BLOCK_SECTORS ? sectors_per_cluster : BCACHE_BLOCK_SECTORS);
+            }
+        }
+
+        uint32_t byte_offset = cursor->index * sizeof(fat_directory_entry);
+        uint32_t sector = cluster_to_lba(cursor->cluster) + byte_offset / FAT_SECTOR_SIZE;
+        const uint8_t* data = bcache_get(sector);
+        if (data == NULL) {
+            return -1; // Read failed
+        }
+        memcpy(entry, data + byte_offset % FAT_SECTOR_SIZE, sizeof(fat_directory_entry));
+        bcache_release(sector);
+        cursor->index++;
+        cursor->entry_sector = sector;
+        cursor->entry_offset = byte_offset % FAT_SECTOR_SIZE;
+
+        if (entry->name[0] == 0x00) {
+            // No more entries
+            cursor->cluster = FAT_END_OF_CHAIN;
+            return 0;
+        }
+
+        if ((entry->attr & 0x0F) == 0x0F || (entry->attr & 0x08)) {
+            // Long file name entry or volume label, skip
+            continue;
+        }
+
+        if (entry->name[0] == 0xE5) {
+            // Deleted file, skip
+            continue;
+        }
+
+        // Edge case of 0x05 representing 0xE5
+        if (entry->name[0] == 0x05) {
+            entry->name[0] = 0xE5;
+        }
+
+        return 1;
+    }
+}
+
+// Fill an open file from its directory entry
+static int open_entry(fat_file* file, uint32_t first_cluster, uint32_t file_size,
+        uint32_t entry_sector, uint32_t entry_offset) {
+    file->start_cluster = first_cluster;
+    file->file_size = file_size;
+    file->current_cluster = file->start_cluster;
+    file->is_open = true;
+    file->entry_sector = entry_sector;
+    file->entry_offset = entry_offset;
+    file->readahead_offset = 0;
+    file->readahead_window = 0;
+    if (readahead_file == file) {
+        readahead_drop(); // The structure is being reused for another file
+    }
+
+    return map_extents(file);
+}
+
+static uint32_t dentry_hash(uint32_t parent_cluster, const char* name) {
+    uint32_t hash = parent_cluster * 2654435761u;
+    for (int i = 0; i < 11; i++) {
+        hash = (hash ^ (uint8_t)name[i]) * 16777619u;
+    }
+    return hash & (FAT_DENTRY_BUCKETS - 1);
+}
+
+static void dentry_cache_clear() {
+    for (uint32_t i = 0; i < FAT_DENTRY_CACHE_SIZE; i++) {
+        dentry_cache[i].used = false;
+    }
+    for (uint32_t i = 0; i < FAT_DENTRY_BUCKETS; i++) {
+        dentry_buckets[i] = FAT_DENTRY_NONE;
+    }
+    dentry_next_victim = 0;
+}
+
+static fat_dentry* dentry_cache_find(uint32_t parent_cluster, const char* name) {
+    uint16_t index = dentry_buckets[dentry_hash(parent_cluster, name)];
+    while (index != FAT_DENTRY_NONE) {
+        fat_dentry* dentry = &dentry_cache[index];
+        if (dentry->parent_cluster == parent_cluster && filename_compare(dentry->name, name)) {
+            return dentry;
+        }
+        index = dentry->hash_next;
+    }
+    return NULL;
+}
+
+static fat_dentry* dentry_cache_insert(uint32_t parent_cluster, const fat_directory_entry* entry,
+        uint32_t entry_sector, uint32_t entry_offset) {
+    uint16_t index = (uint16_t)dentry_next_victim;
+    dentry_next_victim = (dentry_next_victim + 1) % FAT_DENTRY_CACHE_SIZE;
+    fat_dentry* dentry = &dentry_cache[index];
+
+    if (dentry->used) {
+        // Unlink the entry being replaced from its bucket
+        uint16_t* link = &dentry_buckets[dentry_hash(dentry->parent_cluster, dentry->name)];
+        while (*link != index) {
+            link = &dentry_cache[*link].hash_next;
+        }
+        *link = dentry->hash_next;
+    }
+
+    dentry->parent_cluster = parent_cluster;
+    for (int i = 0; i < 11; i++) {
+        dentry->name[i] = (char)entry->name[i];
+    }
+    dentry->attr = entry->attr;
+    dentry->first_cluster = get_cluster(entry);
+    dentry->file_size = entry->file_size;
+    dentry->entry_sector = entry_sector;
+    dentry->entry_offset = (uint16_t)entry_offset;
+    dentry->used = true;
+
+    uint32_t bucket = dentry_hash(parent_cluster, dentry->name);
+    dentry->hash_next = dentry_buckets[bucket];
+    dentry_buckets[bucket] = index;
+
+    return dentry;
+}
+
+// Find a name in one directory, through the dentry cache
+// Returns 1 with the entry in *result, 0 if the name is not there, negative on error
+static int lookup(uint32_t parent_cluster, const char* name, fat_dentry** result) {
+    fat_dentry* dentry = dentry_cache_find(parent_cluster, name);
+    if (dentry != NULL) {
+        *result = dentry;
+        return 1;
+    }
+
+    dir_cursor cursor = { parent_cluster, 0, 0, 0 };
+    fat_directory_entry entry;
+    int found;
+    while ((found = next_dir_entry(&cursor, &entry)) > 0) {
+        if (filename_compare((const char*)entry.name, name)) {
+            *result = dentry_cache_insert(parent_cluster, &entry, cursor.entry_sector, cursor.entry_offset);
+            return 1;
+        }
+    }
+
+    return found; // 0 at the end of the directory, negative if a read failed
+}
+
+// First cluster of a directory entry's directory; ".." entries of first-level
+// directories point at cluster 0, which means the root
+static inline uint32_t dentry_directory(const fat_dentry* dentry) {
+    return dentry->first_cluster < 2 ? root_cluster : dentry->first_cluster;
+}
+
+// Walk a path from the root, one component at a time, up to end
+// Returns 0 with the last component's entry in *result (NULL for the root itself)
+static int resolve_path(const char* path, const char* end, fat_dentry** result) {
+    uint32_t directory = root_cluster;
+    fat_dentry* dentry = NULL;
+
+    while (path < end) {
+        if (*path == '/') {
+            path++;
+            continue;
+        }
+
+        // Copy out one component ("NAME.EXT" is at most 12 characters)
+        char component[13];
+        size_t length = 0;
+        while (path + length < end && path[length] != '/') {
+            if (length == 12) {
+                return -1; // Not an 8.3 name
+            }
+            component[length] = path[length];
+            length++;
+        }
+        component[length] = '\0';
+        path += length;
+
+        if (dentry != NULL && !(dentry->attr & 0x10)) {
+            return -1; // A file in the middle of the path
+        }
+
+        char name[11];
+        if (component[0] == '.' && (length == 1 || (length == 2 && component[1] == '.'))) {
+            // "." and ".." are stored as-is rather than as name and extension
+            for (int i = 0; i < 11; i++) {
+                name[i] = i < (int)length ? '.' : ' ';
+            }
+        } else {
+            format_filename(component, name);
+        }
+
+        if (lookup(directory, name, &dentry) <= 0) {
+            return -1; // Not found or read failed
+        }
+        directory = dentry_directory(dentry);
+    }
+
+    *result = dentry;
+    return 0;
+}
+
+// End of a null-terminated path
+static const char* path_end(const char* path) {
+    while (*path != '\0') {
+        path++;
+    }
+    return path;
+}
+
+// Write a file's first cluster and size back to its directory entry
+static int update_dir_entry(fat_file* file) {
+    if (file->entry_sector == 0) {
+        return -1; // Not opened from a directory entry
+    }
+
+    if (bcache_read(file->entry_sector, 1, sector_buffer) < 0) {
+        return -1;
+    }
+    fat_directory_entry* entry = (fat_directory_entry*)(sector_buffer + file->entry_offset);
+    entry->first_cluster_high = (uint16_t)(file->start_cluster >> 16);
+    entry->first_cluster_low = (uint16_t)(file->start_cluster & 0xFFFF);
+    entry->file_size = file->file_size;
+    if (bcache_write(file->entry_sector, 1, sector_buffer) < 0) {
+        return -1;
+    }
+
+    // Keep cached lookups of the same entry in step
+    for (uint32_t i = 0; i < FAT_DENTRY_CACHE_SIZE; i++) {
+        fat_dentry* dentry = &dentry_cache[i];
+        if (dentry->used && dentry->entry_sector == file->entry_sector &&
+            dentry->entry_offset == file->entry_offset) {
+            dentry->first_cluster = file->start_cluster;
+            dentry->file_size = file->file_size;
+        }
+    }
+
+    return 0;
+}
+
+// Find an unused entry in a directory, growing the directory by a zeroed
+// cluster when every entry is taken
+static int find_free_dir_slot(uint32_t directory, uint32_t* sector_out, uint32_t* offset_out) {
+    uint32_t cluster = directory;
+    uint32_t last_cluster = directory;
+    uint32_t clusters = 0;
+
+    while (cluster >= 2 && cluster < FAT_END_OF_CHAIN) {
+        if (clusters++ > max_cluster) {
+            return -1; // Chain loops back on itself
+        }
+
+        for (uint32_t i = 0; i < sectors_per_cluster; i++) {
+            uint32_t sector = cluster_to_lba(cluster) + i;
+            const uint8_t* data = bcache_get(sector);
+            if (data == NULL) {
+                return -1;
+            }
+
+            for (uint32_t offset = 0; offset < FAT_SECTOR_SIZE; offset += sizeof(fat_directory_entry)) {
+                if (data[offset] == 0x00 || data[offset] == 0xE5) {
+                    bcache_release(sector);
+                    *sector_out = sector;
+                    *offset_out = offset;
+                    return 0;
+                }
+            }
+            bcache_release(sector);
+        }
+
+        last_cluster = cluster;
+        if (read_fat_entry(cluster, &cluster) < 0) {
+            return -1;
+        }
+    }
+
+    // Directory is full: link a new cluster onto its chain
+    uint32_t new_cluster;
+    if (allocate_cluster(&new_cluster) < 0) {
+        return -1;
+    }
+
+    memset(sector_buffer, 0, FAT_SECTOR_SIZE);
+    for (uint32_t i = 0; i < sectors_per_cluster; i++) {
+        if (bcache_write(cluster_to_lba(new_cluster) + i, 1, sector_buffer) < 0) {
+            free_chain(new_cluster);
+            return -1;
+        }
+    }
+
+    if (write_fat_entry(last_cluster, new_cluster) < 0) {
+        free_chain(new_cluster);
+        return -1;
+    }
+
+    *sector_out = cluster_to_lba(new_cluster);
+    *offset_out = 0;
+    return 0;
 }
 
-// Get the size of a cluster in bytes
-static inline uint32_t cluster_size_bytes() {
-    return sectors_per_cluster * FAT_SECTOR_SIZE;
-}
+// Whether a name fits an 8.3 entry as it is: 1-8 name characters, optionally a
+// dot and 1-3 extension characters, nothing FAT forbids in short names
+// Lower case is allowed; format_filename() converts it
+static bool valid_short_name(const char* name) {
+    static const char forbidden[] = "\"*+,/:;<=>?[\\]|";
+    uint32_t length = 0;
+    uint32_t dot = 0; // Position of the dot, 0 while there is none
 
-// Read a cluster from disk into a buffer
-static inline int read_dir_cluster(uint32_t cluster, fat_directory_entry* dir_entry) {
-    return vio_read_sectors(cluster_to_lba(cluster), sectors_per_cluster, (uint8_t*)dir_entry);
-}
+    for (; name[length] != '\0'; length++) {
+        uint8_t c = (uint8_t)name[length];
+        if (c == '.') {
+            if (dot != 0 || length == 0) {
+                return false; // Second dot, or no name before it
+            }
+            dot = length;
+            continue;
+        }
+        if (c <= ' ' || c == 0x7F) {
+            return false;
+        }
+        for (const char* f = forbidden; *f != '\0'; f++) {
+            if (c == (uint8_t)*f) {
+                return false;
+            }
+        }
+    }
 
-// Get the starting cluster of a directory entry
-static inline uint32_t get_cluster(volatile fat_directory_entry* entry) {
-    return (entry->first_cluster_high << 16) | entry->first_cluster_low;
+    if (dot == 0) {
+        return length >= 1 && length <= 8;
+    }
+    return dot <= 8 && length - dot - 1 >= 1 && length - dot - 1 <= 3;
 }
 
-// Compare two filenames
-static bool filename_compare(const char* name1, const char* name2) {
-    for (int i = 0; i < 11; i++) {
-        if (name1[i] != name2[i]) {
-            return false;
+// Turn an 11-byte 8.3 name back into "NAME.EXT"
+static void display_filename(const char* name, char* display) {
+    int length = 0;
+    for (int i = 0; i < 8 && name[i] != ' '; i++) {
+        display[length++] = name[i];
+    }
+    if (name[8] != ' ') {
+        display[length++] = '.';
+        for (int i = 8; i < 11 && name[i] != ' '; i++) {
+            display[length++] = name[i];
         }
     }
-    return true;
+    display[length] = '\0';
 }
 
 
@@ -111,8 +1176,11 @@ void format_filename(const char* src, char* dest) {
 }
 
 int fat_init() {
+    // Metadata reads go through the block cache; start it empty
+    bcache_init();
+
     // Read the MBR
-    if (vio_read_sector(0, (uint8_t*)&mbr) < 0) {
+    if (bcache_read(0, 1, (uint8_t*)&mbr) < 0) {
         return -1;
     }
 
@@ -137,7 +1205,7 @@ int fat_mount(uint8_t partition_number) {
     uint32_t partition_start_lba = read_uint32_packed(&partition->start_lba);
     
     // Read the Volume ID sector
-    if (vio_read_sector(partition_start_lba, (uint8_t*)&volume_id) < 0) {
+    if (bcache_read(partition_start_lba, 1, (uint8_t*)&volume_id) < 0) {
         return -1;
     }
 
@@ -158,6 +1226,59 @@ int fat_mount(uint8_t partition_number) {
     cluster_start_lba = fat_begin_lba + (volume_id.num_fats * fat_size_32);
     sectors_per_cluster = volume_id.sectors_per_cluster;
     root_cluster = root_clust;
+    fat_size_sectors = fat_size_32;
+    fat_count = volume_id.num_fats;
+    dentry_cache_clear();
+    readahead_drop();
+
+    // Clusters that fit both the volume and the FAT
+    uint32_t total_sectors = read_uint32_packed(&volume_id.total_sectors_32);
+    uint32_t data_offset = cluster_start_lba - partition_start_lba;
+    max_cluster = total_sectors > data_offset ? (total_sectors - data_offset) / sectors_per_cluster + 1 : 1;
+    if (max_cluster >= fat_size_sectors * (FAT_SECTOR_SIZE / sizeof(uint32_t))) {
+        max_cluster = fat_size_sectors * (FAT_SECTOR_SIZE / sizeof(uint32_t)) - 1;
+    }
+
+    // Load the FAT (or as much of it as the cache holds) so chain walks are memory lookups
+    if (load_fat_table() < 0) {
+        return -1;
+    }
+
+    // Seed allocation from FSInfo; without it, count free clusters as the bitmap fills
+    fs_info_lba = 0;
+    free_count = FAT_FS_INFO_UNKNOWN;
+    next_free_hint = 2;
+    fs_info_dirty = false;
+    uint16_t fs_info_sector = read_uint16_packed(&volume_id.fs_info_sector);
+    if (fs_info_sector != 0 && fs_info_sector != 0xFFFF &&
+        bcache_read(partition_start_lba + fs_info_sector, 1, sector_buffer) == 0) {
+        fat_fs_info* fs_info = (fat_fs_info*)sector_buffer;
+        if (fs_info->lead_signature == FAT_FS_INFO_LEAD_SIGNATURE &&
+            fs_info->struct_signature == FAT_FS_INFO_STRUCT_SIGNATURE) {
+            fs_info_lba = partition_start_lba + fs_info_sector;
+            if (fs_info->free_count <= max_cluster - 1) {
+                free_count = fs_info->free_count;
+            }
+            if (fs_info->next_free >= 2 && fs_info->next_free <= max_cluster) {
+                next_free_hint = fs_info->next_free;
+            }
+        }
+    }
+
+    for (uint32_t window = 0; window < FAT_BITMAP_WINDOWS; window++) {
+        free_bitmap_scanned[window] = false;
+    }
+    free_bitmap_windows_scanned = 0;
+
+    // With the whole FAT in memory the bitmap costs no I/O, so build it now
+    if (fat_size_sectors <= FAT_TABLE_WINDOWS * FAT_TABLE_WINDOW_SECTORS) {
+        for (uint32_t window = 0; window < FAT_BITMAP_WINDOWS && window * FAT_TABLE_WINDOW_ENTRIES <= max_cluster; window++) {
+            if (scan_bitmap_window(window) < 0) {
+                return -1;
+            }
+        }
+        count_free_clusters();
+    }
 
     return 0;
 }
@@ -165,74 +1286,38 @@ int fat_mount(uint8_t partition_number) {
 static int fat_open_r(
         const char* filename, 
         fat_file* file, 
-        uint32_t cluster
+        uint32_t cluster,
+        uint32_t depth
     ) {
 
-    // Use our static directory buffer to avoid stack overflow
-    volatile fat_directory_entry* current_dir = dir_entry_buffer;
+    dir_cursor cursor = { cluster, 0, 0, 0 };
+    fat_directory_entry entry;
 
-    // Read the directory entries from the specified cluster
-    if (read_dir_cluster(cluster, (fat_directory_entry*)current_dir) < 0) {
-        // Read failed
-        return -1;
-    }
-    
-    // Memory barrier to ensure directory data is visible after DMA
-    __sync_synchronize();
-    
     // Search for the file in the directory entries
-    for (
-            size_t i = 0; 
-            i < (sectors_per_cluster * FAT_SECTOR_SIZE) / sizeof(fat_directory_entry);
-            i++
-        ) {
-        if (current_dir[i].name[0] == 0x00) {
-            // No more entries, file not found
-            return -1;
-        }
-
-        if ((current_dir[i].attr & 0x0F) == 0x0F) {
-            // Long file name entry, skip
+    while (next_dir_entry(&cursor, &entry) > 0) {
+        if (!(entry.attr & 0x10)) {
+            if (filename_compare((const char*)entry.name, filename)) {
+                // File found
+                return open_entry(file, get_cluster(&entry), entry.file_size,
+                    cursor.entry_sector, cursor.entry_offset);
+            }
             continue;
         }
 
-        if (current_dir[i].name[0] == 0xE5) {
-            // Deleted file, skip
+        // Is a directory; "." and ".." lead back up the tree
+        if (entry.name[0] == '.' || depth + 1 >= FAT_MAX_SEARCH_DEPTH) {
             continue;
         }
-        
-        // Check for edge case of 0x05 representing 0xE5
-        char compare_name[11];
-        // Copy name for comparison
-        for (size_t j = 0; j < 11; j++) {
-            compare_name[j] = current_dir[i].name[j];
-        }
-
-        if (current_dir[i].name[0] == 0x05) {
-            compare_name[0] = (char)0xE5;
-        }
-
-        if (filename_compare(compare_name, filename) && !(current_dir[i].attr & 0x10)) {
-            // File found
-            file->start_cluster = get_cluster(&current_dir[i]);
-            file->file_size = current_dir[i].file_size;
-            file->current_cluster = file->start_cluster;
-            file->is_open = true;
-
-            return 0;
-        }
 
         // File found in recursive call
-        if (current_dir[i].attr & 0x10) {
-            // Is a directory
-            if (fat_open_r(
-                    filename, 
-                    file, 
-                    get_cluster(&current_dir[i])
-                ) == 0
-            ) {
-                return 0;
-            }
+        if (fat_open_r(
+                filename, 
+                file, 
+                get_cluster(&entry),
+                depth + 1
+            ) == 0
+        ) {
+            return 0;
         }
     }
 
@@ -247,102 +1332,521 @@ int fat_open(const char* filename, fat_file* file) {
     return fat_open_r(
         filename, 
         file, 
-        root_cluster
+        root_cluster,
+        0
     );
 }
 
-int fat_read(fat_file* file, uint8_t* buffer) {
-    if (file == NULL || buffer == NULL) {
-        // uart_puts("DEBUG fat_read: NULL parameter\\n\\r");
+int fat_open_path(const char* path, fat_file* file) {
+    if (file == NULL || path == NULL) {
         return -1; // Invalid parameters
     }
 
-    uint64_t sp_start;
-    asm volatile("mov %0, sp" : "=r"(sp_start));
-    uint64_t lr_start;
-    asm volatile("mov %0, x30" : "=r"(lr_start));
-    
-    // uart_puts("DEBUG fat_read: SP at start: 0x");
-    // uart_print_hex(sp_start);
-    // uart_puts(", LR at start: 0x");
-    // uart_print_hex(lr_start);
-    // uart_puts(", Buffer: 0x");
-    // uart_print_hex((uint64_t)buffer);
-    // uart_puts(", File struct: 0x");
-    // uart_print_hex((uint64_t)file);
-    // uart_puts("\\n\\r");
+    fat_dentry* dentry;
+    if (resolve_path(path, path_end(path), &dentry) < 0) {
+        return -1; // Not found
+    }
+
+    if (dentry == NULL || (dentry->attr & 0x10)) {
+        return -1; // Root or another directory
+    }
+
+    return open_entry(file, dentry->first_cluster, dentry->file_size,
+        dentry->entry_sector, dentry->entry_offset);
+}
+
+int fat_opendir(const char* path, fat_dir* dir) {
+    if (path == NULL || dir == NULL) {
+        return -1; // Invalid parameters
+    }
+
+    fat_dentry* dentry;
+    if (resolve_path(path, path_end(path), &dentry) < 0) {
+        return -1; // Not found
+    }
+
+    if (dentry != NULL && !(dentry->attr & 0x10)) {
+        return -1; // Not a directory
+    }
+
+    dir->cluster = dentry == NULL ? root_cluster : dentry_directory(dentry);
+    dir->index = 0;
+    dir->is_open = true;
+
+    return 0;
+}
+
+int fat_readdir(fat_dir* dir, fat_dirent* dirent) {
+    if (dir == NULL || dirent == NULL || !dir->is_open) {
+        return -1; // Invalid parameters
+    }
+
+    dir_cursor cursor = { dir->cluster, dir->index, 0, 0 };
+    fat_directory_entry entry;
+    int result = next_dir_entry(&cursor, &entry);
+    dir->cluster = cursor.cluster;
+    dir->index = cursor.index;
+    if (result <= 0) {
+        return result; // End of directory or read failed
+    }
+
+    for (int i = 0; i < 11; i++) {
+        dirent->short_name[i] = (char)entry.name[i];
+    }
+    display_filename(dirent->short_name, dirent->name);
+    dirent->attr = entry.attr;
+    dirent->first_cluster = get_cluster(&entry);
+    dirent->file_size = entry.file_size;
+    dirent->is_directory = (entry.attr & 0x10) != 0;
+
+    return 1;
+}
 
+int fat_read(fat_file* file, uint8_t* buffer) {
+    if (file == NULL || buffer == NULL) {
+        return -1; // Invalid parameters
+    }
     if (!file->is_open) {
-        // uart_puts("DEBUG fat_read: File not open\\n\\r");
         return -1; // File not open
     }
-    
-    // uart_puts("DEBUG fat_read: Starting read, current_cluster=0x");
-    // uart_print_hex(file->current_cluster);
-    // uart_puts("\\n\\r");
-    
-    // FAT32 EOC markers are 0x0FFFFFF8 through 0x0FFFFFFF
-    while (file->current_cluster < 0x0FFFFFF8) {
-        // uart_puts("DEBUG fat_read: Reading cluster 0x");
-        // uart_print_hex(file->current_cluster);
-        // uart_puts(" at LBA 0x");
-        // uart_print_hex(cluster_to_lba(file->current_cluster));
-        // uart_puts("\\n\\r");
-        
-        // Read the current cluster into the buffer
-        if (vio_read_sectors(
-                cluster_to_lba(file->current_cluster), 
-                sectors_per_cluster, 
-                buffer
-            ) < 0) {
-            // uart_puts("DEBUG fat_read: vio_read_sectors failed\\n\\r");
+
+    TRACE(TRACE_FAT_READ, file->start_cluster, file->file_size);
+
+    // Read from the start of the current cluster up to file_size, not to the end
+    // of the last cluster, so the buffer only needs room for the file itself
+    uint32_t cluster_bytes = cluster_size_bytes();
+    uint32_t file_clusters = (file->file_size + cluster_bytes - 1) / cluster_bytes;
+    if (file->current_cluster < FAT_END_OF_CHAIN && file->current_index < file_clusters) {
+        uint32_t offset = file->current_index * cluster_bytes;
+        if (fat_read_at(file, offset, file->file_size - offset, buffer) < 0) {
             return -1; // Read failed
         }
+    }
+
+    file->current_cluster = FAT_END_OF_CHAIN;
+    file->current_extent = file->extent_count;
+    file->current_index = file_clusters;
+
+    return 0;
+}
+
+int fat_seek(fat_file* file, uint32_t offset) {
+    if (file == NULL || !file->is_open || offset > file->file_size) {
+        return -1; // Invalid parameters
+    }
+
+    uint32_t index = offset / cluster_size_bytes();
+    run_cursor cursor;
+    if (locate_cluster(file, index, &cursor) < 0) {
+        return -1;
+    }
+
+    file->current_cluster = cursor.cluster;
+    file->current_extent = cursor.extent;
+    file->current_index = index;
+    return 0;
+}
+
+int fat_read_at(fat_file* file, uint32_t offset, uint32_t length, uint8_t* buffer) {
+    if (file == NULL || buffer == NULL || !file->is_open) {
+        return -1; // Invalid parameters
+    }
+    if (offset >= file->file_size) {
+        return 0; // Nothing left to read
+    }
+    if (length > file->file_size - offset) {
+        length = file->file_size - offset;
+    }
+
+    // Sequential reads grow the readahead window, anything else resets it
+    uint32_t cluster_bytes = cluster_size_bytes();
+    if (offset == file->readahead_offset) {
+        uint32_t window = file->readahead_window == 0 ? cluster_bytes : file->readahead_window * 2;
+        file->readahead_window = window < FAT_READAHEAD_SIZE ? window : FAT_READAHEAD_SIZE;
+    } else {
+        file->readahead_window = 0;
+    }
+    file->readahead_offset = offset + length;
 
-        // uart_puts("DEBUG fat_read: Cluster read successfully\\n\\r");
-        buffer += cluster_size_bytes();
+    // Take what the last readahead brought in
+    int copied = readahead_copy(file, offset, length, buffer);
+    if (copied < 0) {
+        return -1;
+    }
+    uint32_t remaining = length - (uint32_t)copied;
+    offset += (uint32_t)copied;
+    buffer += copied;
 
-        // Calculate which sector of the FAT contains the entry for the current cluster
-        uint32_t fat_sector_offset = (file->current_cluster * 4) / FAT_SECTOR_SIZE;
-        uint32_t fat_entry_index = file->current_cluster % (FAT_SECTOR_SIZE / sizeof(uint32_t));
+    run_cursor cursor;
+    if (remaining > 0 && locate_cluster(file, offset / cluster_bytes, &cursor) < 0) {
+        return -1;
+    }
 
-        // uart_puts("DEBUG fat_read: Reading FAT sector at LBA 0x");
-        // uart_print_hex(fat_begin_lba + fat_sector_offset);
-        // uart_puts(", entry index ");
-        // uart_print_dec(fat_entry_index);
-        // uart_puts("\\n\\r");
+    uint32_t skip = offset % cluster_bytes; // Bytes of the first run before offset
+    while (remaining > 0) {
+        uint32_t first_cluster;
+        uint32_t run_length;
+        if (next_run(file, &cursor, &first_cluster, &run_length) <= 0) {
+            return -1; // Chain shorter than file_size
+        }
 
-        // Read the specific FAT sector into our static buffer
-        if (vio_read_sector(
-                fat_begin_lba + fat_sector_offset, 
-                (uint8_t*)fat_sector_buffer
-            ) < 0) {
-            // uart_puts("DEBUG fat_read: FAT sector read failed\\n\\r");
+        uint32_t run_bytes = run_length * cluster_bytes - skip;
+        uint32_t take = run_bytes < remaining ? run_bytes : remaining;
+        uint32_t lba = cluster_to_lba(first_cluster) + skip / FAT_SECTOR_SIZE;
+        if (read_bytes(lba, skip % FAT_SECTOR_SIZE, take, buffer) < 0) {
             return -1; // Read failed
         }
-        
-        // uart_puts("DEBUG fat_read: FAT sector read successfully\\n\\r");
-        
-        // Get the next cluster from the FAT sector
-        file->current_cluster = fat_sector_buffer[fat_entry_index] & 0x0FFFFFFF;
-        
-        // uart_puts("DEBUG fat_read: Next cluster = 0x");
-        // uart_print_hex(file->current_cluster);
-        // uart_puts("\\n\\r");
+
+        buffer += take;
+        remaining -= take;
+        skip = 0;
     }
 
-    // uart_puts("DEBUG fat_read: Read complete\\n\\r");
-    
-    uint64_t sp_end;
-    asm volatile("mov %0, sp" : "=r"(sp_end));
-    uint64_t lr_end;
-    asm volatile("mov %0, x30" : "=r"(lr_end));
-    
-    // uart_puts("DEBUG fat_read: SP at end: 0x");
-    // uart_print_hex(sp_end);
-    // uart_puts(", LR at end: 0x");
-    // uart_print_hex(lr_end);
-    // uart_puts("\\n\\r");
-    
-    return 0;
-}
\ No newline at end of file
+    // Get the next window loading while the caller works on this one
+    if (file->readahead_window > 0) {
+        readahead_submit(file, file->readahead_offset);
+    }
+
+    return (int)length;
+}
+
+int fat_read_stream(fat_file* file, fat_chunk_callback callback, void* context) {
+    if (file == NULL || callback == NULL || !file->is_open) {
+        return -1; // Invalid parameters
+    }
+
+    uint32_t chunk_sectors = FAT_STREAM_CHUNK_SIZE / FAT_SECTOR_SIZE;
+    if (chunk_sectors > vio_max_request_sectors()) {
+        chunk_sectors = vio_max_request_sectors();
+    }
+
+    TRACE(TRACE_FAT_READ, file->start_cluster, file->file_size);
+
+    run_cursor cursor = { file->start_cluster < 2 ? FAT_END_OF_CHAIN : file->start_cluster, 0 };
+    uint32_t run_lba = 0;
+    uint32_t run_sectors = 0;
+
+    int requests[2] = { -1, -1 };
+    uint32_t lengths[2] = { 0, 0 };
+    uint32_t queued = 0; // Bytes submitted so far
+    uint32_t delivered = 0; // Bytes handed to the callback so far
+    uint32_t slot = 0;
+    int result = 0;
+
+    for (;;) {
+        // Start loading the next chunk into the free buffer
+        if (queued < file->file_size) {
+            if (run_sectors == 0) {
+                uint32_t first_cluster;
+                uint32_t run_length;
+                if (next_run(file, &cursor, &first_cluster, &run_length) <= 0) {
+                    result = -1; // Chain shorter than file_size
+                    break;
+                }
+                run_lba = cluster_to_lba(first_cluster);
+                run_sectors = run_length * sectors_per_cluster;
+            }
+
+            uint32_t sectors = run_sectors < chunk_sectors ? run_sectors : chunk_sectors;
+            TRACE(TRACE_FAT_FETCH, run_lba, sectors);
+            requests[slot] = vio_submit_read(run_lba, sectors, stream_buffer[slot]);
+            if (requests[slot] < 0) {
+                result = -1; // Read failed
+                break;
+            }
+
+            uint32_t bytes = sectors * FAT_SECTOR_SIZE;
+            lengths[slot] = bytes < file->file_size - queued ? bytes : file->file_size - queued;
+            queued += lengths[slot];
+            run_lba += sectors;
+            run_sectors -= sectors;
+        }
+
+        // Hand out the previous chunk while the next one loads
+        uint32_t previous = slot ^ 1;
+        if (requests[previous] >= 0) {
+            int status = vio_wait(requests[previous]);
+            requests[previous] = -1;
+            if (status < 0) {
+                result = -1; // Read failed
+                break;
+            }
+
+            result = callback(stream_buffer[previous], lengths[previous], delivered, context);
+            if (result < 0) {
+                break; // Stopped by the callback
+            }
+            delivered += lengths[previous];
+        } else if (requests[slot] < 0) {
+            break; // Nothing loading and nothing left to hand out
+        }
+
+        slot = previous;
+    }
+
+    // Collect reads still in flight before their buffers are reused
+    for (uint32_t i = 0; i < 2; i++) {
+        if (requests[i] >= 0) {
+            vio_wait(requests[i]);
+        }
+    }
+
+    return result < 0 ? result : 0;
+}
+
+int fat_map(fat_file* file, uint32_t offset, uint32_t length, fat_view* view) {
+    if (file == NULL || view == NULL || !file->is_open) {
+        return -1; // Invalid parameters
+    }
+    view->data = NULL;
+    view->length = 0;
+    if (offset >= file->file_size || length == 0) {
+        return 0; // Nothing to map
+    }
+    if (length > file->file_size - offset) {
+        length = file->file_size - offset;
+    }
+
+    uint32_t cluster_bytes = cluster_size_bytes();
+    run_cursor cursor;
+    uint32_t first_cluster;
+    uint32_t run_length;
+    if (locate_cluster(file, offset / cluster_bytes, &cursor) < 0 ||
+        next_run(file, &cursor, &first_cluster, &run_length) <= 0) {
+        return -1; // Chain shorter than file_size
+    }
+
+    // Stop at the end of the run and at the end of the cache block
+    uint32_t skip = offset % cluster_bytes;
+    uint32_t sector = cluster_to_lba(first_cluster) + skip / FAT_SECTOR_SIZE;
+    uint32_t run_bytes = run_length * cluster_bytes - skip;
+    uint32_t block_bytes = (BCACHE_BLOCK_SECTORS - sector % BCACHE_BLOCK_SECTORS) * FAT_SECTOR_SIZE
+        - skip % FAT_SECTOR_SIZE;
+    if (length > run_bytes) {
+        length = run_bytes;
+    }
+    if (length > block_bytes) {
+        length = block_bytes;
+    }
+
+    const uint8_t* data = bcache_get(sector);
+    if (data == NULL) {
+        return -1;
+    }
+
+    view->data = data + skip % FAT_SECTOR_SIZE;
+    view->length = length;
+    view->sector = sector;
+    return (int)length;
+}
+
+void fat_unmap(fat_view* view) {
+    if (view == NULL || view->data == NULL) {
+        return;
+    }
+
+    bcache_release(view->sector);
+    view->data = NULL;
+    view->length = 0;
+}
+
+int fat_create(const char* path, fat_file* file) {
+    if (path == NULL || file == NULL) {
+        return -1; // Invalid parameters
+    }
+
+    // Split the path into the parent directory and the new name
+    const char* end = path_end(path);
+    const char* name_start = end;
+    while (name_start > path && name_start[-1] != '/') {
+        name_start--;
+    }
+    if (!valid_short_name(name_start)) {
+        return -1; // No name, "." / "..", or not an 8.3 name
+    }
+
+    fat_dentry* parent;
+    if (resolve_path(path, name_start, &parent) < 0) {
+        return -1; // Parent not found
+    }
+    if (parent != NULL && !(parent->attr & 0x10)) {
+        return -1; // Parent is a file
+    }
+    uint32_t directory = parent == NULL ? root_cluster : dentry_directory(parent);
+
+    char name[11];
+    format_filename(name_start, name);
+    fat_dentry* existing;
+    if (lookup(directory, name, &existing) != 0) {
+        return -1; // Already exists, or the directory could not be read
+    }
+
+    uint32_t sector;
+    uint32_t offset;
+    if (find_free_dir_slot(directory, &sector, &offset) < 0) {
+        return -1;
+    }
+
+    // An empty file: no clusters until the first append
+    fat_directory_entry entry;
+    memset(&entry, 0, sizeof(entry));
+    for (int i = 0; i < 11; i++) {
+        entry.name[i] = (uint8_t)name[i];
+    }
+    entry.attr = 0x20; // Archive
+
+    if (bcache_read(sector, 1, sector_buffer) < 0) {
+        return -1;
+    }
+    memcpy(sector_buffer + offset, &entry, sizeof(entry));
+    if (bcache_write(sector, 1, sector_buffer) < 0) {
+        return -1;
+    }
+
+    dentry_cache_insert(directory, &entry, sector, offset);
+    return open_entry(file, 0, 0, sector, offset);
+}
+
+int fat_append(fat_file* file, const uint8_t* data, uint32_t length) {
+    if (file == NULL || data == NULL || !file->is_open || file->file_size + length < file->file_size) {
+        return -1; // Invalid parameters
+    }
+    if (length == 0) {
+        return 0;
+    }
+    if (readahead_file == file) {
+        readahead_drop();
+    }
+
+    uint32_t cluster_bytes = cluster_size_bytes();
+    uint32_t have = (file->file_size + cluster_bytes - 1) / cluster_bytes;
+    uint32_t need = (file->file_size + length + cluster_bytes - 1) / cluster_bytes;
+
+    // Grow the chain first, so a full disk leaves the file as it was
+    if (need > have) {
+        uint32_t last_cluster = 0;
+        if (have > 0) {
+            run_cursor cursor;
+            if (locate_cluster(file, have - 1, &cursor) < 0 || cursor.cluster >= FAT_END_OF_CHAIN) {
+                return -1; // Chain shorter than file_size
+            }
+            last_cluster = cursor.cluster;
+        }
+
+        uint32_t first_new = 0;
+        uint32_t previous = last_cluster;
+        for (uint32_t index = have; index < need; index++) {
+            uint32_t cluster;
+            bool allocated = allocate_cluster(&cluster) == 0;
+            if (!allocated || (previous != 0 && write_fat_entry(previous, cluster) < 0)) {
+                // Undo the partial allocation; a cluster that could not be linked
+                // is not reachable from first_new, so it is freed on its own
+                if (allocated) {
+                    free_chain(cluster);
+                }
+                if (first_new != 0) {
+                    if (last_cluster != 0) {
+                        write_fat_entry(last_cluster, 0x0FFFFFFF);
+                    }
+                    free_chain(first_new);
+                }
+                return -1;
+            }
+            if (first_new == 0) {
+                first_new = cluster;
+            }
+            previous = cluster;
+        }
+
+        // Map the new clusters, keeping the read position
+        if (file->start_cluster < 2) {
+            file->start_cluster = first_new;
+        }
+        uint32_t cluster = first_new;
+        for (uint32_t index = have; index < need; index++) {
+            extend_extents(file, cluster, index);
+            if (index + 1 < need && read_fat_entry(cluster, &cluster) < 0) {
+                return -1;
+            }
+        }
+        if (file->current_cluster >= FAT_END_OF_CHAIN) {
+            run_cursor cursor;
+            if (locate_cluster(file, file->current_index, &cursor) < 0) {
+                return -1;
+            }
+            file->current_cluster = cursor.cluster;
+            file->current_extent = cursor.extent;
+        }
+    }
+
+    if (write_at(file, file->file_size, length, data) < 0) {
+        return -1;
+    }
+    file->file_size += length;
+
+    return update_dir_entry(file);
+}
+
+int fat_truncate(fat_file* file, uint32_t size) {
+    if (file == NULL || !file->is_open || size > file->file_size) {
+        return -1; // Invalid parameters
+    }
+
+    if (readahead_file == file) {
+        readahead_drop();
+    }
+
+    uint32_t cluster_bytes = cluster_size_bytes();
+    uint32_t keep = (size + cluster_bytes - 1) / cluster_bytes;
+    uint32_t have = (file->file_size + cluster_bytes - 1) / cluster_bytes;
+
+    if (keep < have) {
+        if (keep == 0) {
+            if (free_chain(file->start_cluster) < 0) {
+                return -1;
+            }
+            file->start_cluster = 0;
+        } else {
+            run_cursor cursor;
+            uint32_t tail;
+            if (locate_cluster(file, keep - 1, &cursor) < 0 || cursor.cluster >= FAT_END_OF_CHAIN ||
+                read_fat_entry(cursor.cluster, &tail) < 0 ||
+                write_fat_entry(cursor.cluster, 0x0FFFFFFF) < 0 ||
+                free_chain(tail) < 0) {
+                return -1;
+            }
+        }
+    }
+
+    // Remap the shortened chain and go back to the start of the file
+    file->file_size = size;
+    file->current_cluster = file->start_cluster;
+    if (map_extents(file) < 0) {
+        return -1;
+    }
+
+    return update_dir_entry(file);
+}
+
+int fat_sync() {
+    for (uint32_t slot = 0; slot < FAT_TABLE_WINDOWS; slot++) {
+        if (fat_table_dirty[slot] != 0 && flush_fat_slot(slot) < 0) {
+            return -1;
+        }
+    }
+
+    if (fs_info_lba != 0 && fs_info_dirty) {
+        if (bcache_read(fs_info_lba, 1, sector_buffer) < 0) {
+            return -1;
+        }
+        fat_fs_info* fs_info = (fat_fs_info*)sector_buffer;
+        fs_info->free_count = free_count;
+        fs_info->next_free = next_free_hint;
+        if (bcache_write(fs_info_lba, 1, sector_buffer) < 0) {
+            return -1;
+        }
+        fs_info_dirty = false;
+    }
+
+    return vio_flush();
+}
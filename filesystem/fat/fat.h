@@ -11,6 +11,45 @@
 #define FAT_PARTITION_TYPE_CHS 0x0B // FAT32 with CHS addressing
 #define FAT_PARTITION_TYPE_LBA 0x0C // FAT32 with LBA addressing
 
+// Memory for the FAT cache; a FAT that fits is loaded whole at mount
+#ifndef FAT_TABLE_CACHE_SIZE
+#define FAT_TABLE_CACHE_SIZE (64 * 1024)
+#endif
+
+// FAT sectors read together when the FAT does not fit the cache
+#define FAT_TABLE_WINDOW_SECTORS 16
+
+// FAT32 EOC markers are 0x0FFFFFF8 through 0x0FFFFFFF
+#define FAT_END_OF_CHAIN 0x0FFFFFF8
+
+// Runs of contiguous clusters remembered per open file; a file split into more
+// runs keeps working, the rest of its chain is followed through the FAT
+#ifndef FAT_MAX_EXTENTS
+#define FAT_MAX_EXTENTS 16
+#endif
+
+// Directory entries remembered by fat_open_path()
+#ifndef FAT_DENTRY_CACHE_SIZE
+#define FAT_DENTRY_CACHE_SIZE 64
+#endif
+
+// Bytes fat_read_stream() loads per request (two such buffers are used)
+#ifndef FAT_STREAM_CHUNK_SIZE
+#define FAT_STREAM_CHUNK_SIZE (8 * 1024)
+#endif
+
+// Largest readahead fat_read_at() keeps in flight for sequential reads; the
+// window starts at one cluster and doubles with every sequential read up to this
+#ifndef FAT_READAHEAD_SIZE
+#define FAT_READAHEAD_SIZE (32 * 1024)
+#endif
+
+// Clusters tracked by the free-cluster bitmap (one bit each); allocation only
+// hands out clusters below this
+#ifndef FAT_FREE_BITMAP_CLUSTERS
+#define FAT_FREE_BITMAP_CLUSTERS (256 * 1024)
+#endif
+
 typedef struct __attribute__((packed)) {
     uint8_t boot_flag; // 0x00: Boot flag
     uint8_t chs_start[3]; // 0x01 - 0x03: Starting CHS address
@@ -35,14 +74,30 @@ typedef struct __attribute__((packed)) {
     uint8_t sectors_per_cluster; // 0x0D: Sectors per cluster
     uint16_t reserved_sector_count; // 0x0E - 0x0F: Number of reserved sectors
     uint8_t num_fats; // 0x10: Number of FATs (usually 2)
-    uint8_t reserved_0[19]; // 0x11 - 0x23: Reserved data not needed for FAT32 driver
+    uint8_t reserved_0[15]; // 0x11 - 0x1F: Reserved data not needed for FAT32 driver
+    uint32_t total_sectors_32; // 0x20 - 0x23: Sectors in the volume
     uint32_t fat_size_32; // 0x24 - 0x27: Size of each FAT in sectors
     uint16_t reserved_1[2]; // 0x28 - 0x2B: Reserved data not needed for FAT32 driver
     uint32_t root_cluster; // 0x2C - 0x2F: Root directory starting cluster
-    uint8_t reserved_2[462]; // 0x30 - 0x1FD: Reserved data not needed for FAT32 driver
+    uint16_t fs_info_sector; // 0x30 - 0x31: FSInfo sector, relative to the volume start
+    uint8_t reserved_2[460]; // 0x32 - 0x1FD: Reserved data not needed for FAT32 driver
     uint16_t boot_signature; // 0x1FE - 0x1FF: Boot sector signature (0x55AA)
 } fat_volume_id;
 
+#define FAT_FS_INFO_LEAD_SIGNATURE 0x41615252
+#define FAT_FS_INFO_STRUCT_SIGNATURE 0x61417272
+#define FAT_FS_INFO_UNKNOWN 0xFFFFFFFF // Free count or next-free hint not set
+
+typedef struct __attribute__((packed)) {
+    uint32_t lead_signature; // 0x000 - 0x003: 0x41615252
+    uint8_t reserved_0[480]; // 0x004 - 0x1E3: Reserved
+    uint32_t struct_signature; // 0x1E4 - 0x1E7: 0x61417272
+    uint32_t free_count; // 0x1E8 - 0x1EB: Free clusters, or 0xFFFFFFFF if unknown
+    uint32_t next_free; // 0x1EC - 0x1EF: Where to start looking for a free cluster
+    uint8_t reserved_1[12]; // 0x1F0 - 0x1FB: Reserved
+    uint32_t trail_signature; // 0x1FC - 0x1FF: 0xAA550000
+} fat_fs_info;
+
 
 typedef struct __attribute__((packed)) {
     uint8_t name[11]; // 0x00 - 0x0A: File name (8.3 format without the dot)
@@ -60,13 +115,71 @@ typedef struct __attribute__((packed)) {
 } fat_directory_entry;
 
 
+typedef struct {
+    uint32_t start_cluster; // First cluster of the run
+    uint32_t cluster_count; // Clusters in the run
+    uint32_t file_cluster; // Index of start_cluster within the file
+} fat_extent;
+
 typedef struct {
     uint32_t start_cluster;
     uint32_t file_size;
     uint32_t current_cluster;
     bool is_open;
+
+    // The cluster chain as runs of contiguous clusters, built by fat_open()
+    fat_extent extents[FAT_MAX_EXTENTS];
+    uint32_t extent_count;
+    uint32_t current_extent; // Extent holding current_cluster
+    uint32_t current_index; // Index of current_cluster within the file
+    // First cluster past the last extent; FAT_END_OF_CHAIN or above when the
+    // extents cover the whole chain
+    uint32_t unmapped_cluster;
+
+    // Sequential-read detection for fat_read_at()
+    uint32_t readahead_offset; // Where the next read starts if access is sequential
+    uint32_t readahead_window; // Bytes to read ahead; 0 until reads look sequential
+
+    // Where the file's directory entry lives, for size and cluster updates
+    uint32_t entry_sector;
+    uint32_t entry_offset;
 } fat_file;
 
+// An open directory, read one entry at a time with fat_readdir()
+typedef struct {
+    uint32_t cluster; // Directory cluster being read
+    uint32_t index; // Next entry within the cluster
+    bool is_open;
+} fat_dir;
+
+// One directory entry returned by fat_readdir()
+typedef struct {
+    char name[13]; // "NAME.EXT", null-terminated
+    char short_name[11]; // 8.3 name as stored (space padded, no dot), for fat_open()
+    uint8_t attr; // FAT attribute bits
+    bool is_directory;
+    uint32_t first_cluster;
+    uint32_t file_size;
+} fat_dirent;
+
+// A read-only view of file data inside the block cache, from fat_map()
+typedef struct {
+    const uint8_t* data; // Points into a pinned cache block; do not write
+    uint32_t length;
+    uint32_t sector; // Sector the view pins, for fat_unmap()
+} fat_view;
+
+/**
+ * @brief Receives the next piece of a file from fat_read_stream().
+ *
+ * @param data The bytes read; only valid until the callback returns.
+ * @param length Number of bytes in data.
+ * @param offset Offset of data[0] within the file.
+ * @param context The context pointer passed to fat_read_stream().
+ * @return 0 to continue, negative value to stop the stream.
+ */
+typedef int (*fat_chunk_callback)(const uint8_t* data, uint32_t length, uint32_t offset, void* context);
+
 
 /**
  * @brief Formats a filename into 8.3 format.
@@ -97,6 +210,8 @@ int fat_init();
  * @brief Mounts a FAT32 partition located at the specified LBA.
  * 
  * This function must be called after fat_init() and before any file operations.
+ * It also loads the FAT into memory (up to FAT_TABLE_CACHE_SIZE bytes from its
+ * start) with one bulk read, so following a cluster chain needs no disk access.
  *
  * @param partition_number The partition number to mount (0-3).
  * @return 0 on success, negative value on error.
@@ -106,23 +221,192 @@ int fat_mount(uint8_t partition_number);
 /**
  * @brief Opens a file in the FAT32 filesystem.
  *
+ * Searches the whole directory tree, depth first, for the first file with
+ * this name. Prefer fat_open_path() when the location is known.
+ *
+ * The file's cluster chain is mapped into runs of contiguous clusters
+ * (file->extents) so reads and seeks do not have to walk the FAT again.
+ *
  * @param filename The name of the file to open (in 8.3 format).
  * @param file Pointer to a fat_file structure to be filled with file information.
  * @return 0 on success, negative value on error (e.g., file not found).
  */
 int fat_open(const char* filename, fat_file* file);
 
+/**
+ * @brief Opens a file by its path, e.g. "/BOOT/KERNEL.BIN".
+ *
+ * The path is resolved one directory at a time, so the cost depends on the
+ * depth of the path rather than on the number of files on the volume. Every
+ * entry found is kept in a cache keyed by (parent directory, name), so
+ * repeated lookups do not read the disk.
+ *
+ * @param path Components separated by '/', each in NAME.EXT form (case-insensitive).
+ *             "." and ".." are allowed; a leading '/' is optional.
+ * @param file Pointer to a fat_file structure to be filled with file information.
+ * @return 0 on success, negative value on error (e.g., not found, or the path
+ *         names a directory).
+ */
+int fat_open_path(const char* path, fat_file* file);
+
+/**
+ * @brief Opens a directory for reading with fat_readdir().
+ *
+ * @param path Path of the directory, e.g. "/" or "/BOOT" (same form as fat_open_path()).
+ * @param dir Pointer to a fat_dir structure to be initialized.
+ * @return 0 on success, negative value on error (e.g., not found, or not a directory).
+ */
+int fat_opendir(const char* path, fat_dir* dir);
+
+/**
+ * @brief Returns the next entry of an open directory.
+ *
+ * Follows the directory's whole cluster chain. Entries are copied one at a time out of
+ * the block cache, and the next cluster is prefetched while the current one is
+ * scanned. Long-name parts, deleted entries and the volume label are skipped;
+ * "." and ".." are returned like any other entry.
+ *
+ * @param dir Pointer to a directory opened with fat_opendir().
+ * @param dirent Filled with the entry.
+ * @return 1 with an entry, 0 at the end of the directory, negative value on error.
+ */
+int fat_readdir(fat_dir* dir, fat_dirent* dirent);
+
 /**
  * @brief Reads data from an open FAT32 file.
  *
- * This function reads the entire file starting from the current cluster position
- * and continues through the FAT chain until reaching the end-of-chain marker.
+ * This function reads the file from the start of the current cluster position
+ * to file_size. Every run of contiguous clusters is read with one multi-sector
+ * request; nothing is written past the end of the file.
  *
  * @param file Pointer to the fat_file structure representing the open file.
  * @param buffer Pointer to a buffer where the read data will be stored. 
- *               Must be large enough to hold the entire file (at least file_size bytes).
+ *               Must be large enough to hold the rest of the file (at most file_size bytes).
  * @return 0 on success, negative value on error (e.g., I/O error).
  */
 int fat_read(fat_file* file, uint8_t* buffer);
 
+/**
+ * @brief Moves the current cluster position of an open file.
+ *
+ * The cluster is found by a binary search of the file's extents; only a file
+ * with more than FAT_MAX_EXTENTS runs walks the FAT past its last extent.
+ * The next fat_read() starts at the beginning of the cluster holding offset.
+ *
+ * @param file Pointer to the fat_file structure representing the open file.
+ * @param offset Byte offset into the file (at most file_size).
+ * @return 0 on success, negative value on error (e.g., offset past the end).
+ */
+int fat_seek(fat_file* file, uint32_t offset);
+
+/**
+ * @brief Reads a byte range of an open file.
+ *
+ * Whole sectors are read straight into the buffer, one request per run of
+ * contiguous clusters. The current position of the file is not changed.
+ *
+ * A read that starts where the previous one ended counts as sequential: the
+ * bytes that follow it are then read ahead in the background, in a window that
+ * doubles with each sequential read up to FAT_READAHEAD_SIZE, so the next read
+ * is served from memory while the caller works on this one. A read elsewhere
+ * resets the window.
+ *
+ * @param file Pointer to the fat_file structure representing the open file.
+ * @param offset Byte offset of the first byte to read.
+ * @param length Number of bytes to read; clipped at file_size.
+ * @param buffer Receives the data. Must hold at least length bytes.
+ * @return Number of bytes read (0 at or past the end of the file),
+ *         negative value on error (e.g., I/O error).
+ */
+int fat_read_at(fat_file* file, uint32_t offset, uint32_t length, uint8_t* buffer);
+
+/**
+ * @brief Reads a whole file in chunks, handing each chunk to a callback.
+ *
+ * Chunks of up to FAT_STREAM_CHUNK_SIZE bytes are delivered in file order, and
+ * the next chunk is already loading while the callback runs, so callers can hash,
+ * decompress or copy the data without staging the whole file.
+ *
+ * @param file Pointer to the fat_file structure representing the open file.
+ * @param callback Called for each chunk.
+ * @param context Passed through to the callback.
+ * @return 0 on success, the callback's negative return value if it stopped
+ *         the stream, or another negative value on error (e.g., I/O error).
+ */
+int fat_read_stream(fat_file* file, fat_chunk_callback callback, void* context);
+
+/**
+ * @brief Maps a byte range of an open file without copying it.
+ *
+ * The view points straight into the block cache, whose block stays pinned
+ * until fat_unmap(). Views can overlap and each one holds its own pin. A view
+ * never crosses a cache block (BCACHE_BLOCK_SIZE bytes) or a break in the
+ * cluster chain, so it may be shorter than requested; map again from
+ * offset + view->length for the rest. Every view pins a block, so keep only a
+ * few mapped at a time.
+ *
+ * @param file Pointer to the fat_file structure representing the open file.
+ * @param offset Byte offset of the first byte to map.
+ * @param length Number of bytes wanted; clipped at file_size.
+ * @param view Filled with the mapped bytes.
+ * @return Number of bytes mapped (0 at or past the end of the file),
+ *         negative value on error (e.g., I/O error, every cache block pinned).
+ */
+int fat_map(fat_file* file, uint32_t offset, uint32_t length, fat_view* view);
+
+/**
+ * @brief Releases a view returned by fat_map().
+ *
+ * @param view The view; its data pointer must not be used afterwards.
+ */
+void fat_unmap(fat_view* view);
+
+/**
+ * @brief Creates an empty file and opens it.
+ *
+ * The parent directory must exist; it grows by a cluster if it has no free entry.
+ * The new name must be a valid 8.3 name as given: at most 8 characters, an
+ * optional extension of at most 3, one dot at most, and none of the characters
+ * FAT forbids in short names. It is never truncated to fit.
+ *
+ * @param path Path of the new file, e.g. "/LOGS/BOOT.LOG" (same form as fat_open_path()).
+ * @param file Pointer to a fat_file structure to be filled with file information.
+ * @return 0 on success, negative value on error (e.g., invalid name, the name
+ *         already exists, no free cluster, I/O error).
+ */
+int fat_create(const char* path, fat_file* file);
+
+/**
+ * @brief Appends data to the end of an open file.
+ *
+ * New clusters come from the free-cluster bitmap, starting at the FSInfo
+ * next-free hint, so a file written in one go usually stays contiguous.
+ * Data and the directory entry are written right away; FAT changes stay in
+ * the FAT cache until fat_sync().
+ *
+ * @param file Pointer to the fat_file structure representing the open file.
+ * @param data The bytes to append.
+ * @param length Number of bytes to append.
+ * @return 0 on success, negative value on error (e.g., disk full, I/O error).
+ */
+int fat_append(fat_file* file, const uint8_t* data, uint32_t length);
+
+/**
+ * @brief Shortens an open file, freeing the clusters past the new end.
+ *
+ * @param file Pointer to the fat_file structure representing the open file.
+ * @param size The new size in bytes (at most file_size).
+ * @return 0 on success, negative value on error.
+ */
+int fat_truncate(fat_file* file, uint32_t size);
+
+/**
+ * @brief Writes out pending FAT changes and the FSInfo sector, then flushes the disk.
+ *
+ * Dirty FAT sectors are written to every FAT copy in runs of consecutive sectors.
+ *
+ * @return 0 on success, negative value on error (e.g., I/O error).
+ */
+int fat_sync();
+
 #endif
\ No newline at end of file
@@ -1,20 +1,120 @@
-#include "vio.h"
+#include "vioqueue.h"
 #include "../../uart/uart.h"
+#include "../../irq/irq.h"
+#include "../../mmu/mmu.h"
+#include "../../trace/trace.h"
+#include "../../libc-lite/string.h"
 
 volatile vio_mmio_registers* vio_regs = (vio_mmio_registers*)VIO_BASE;
 
-// VirtIO queue layout - must be page-aligned for v1
-static vio_queue_layout __attribute__((aligned(4096))) vio_queue;
+// Request queues of the block device; each core uses vio_queues[cpu % vio_queue_total]
+static vio_queue vio_queues[VIO_MAX_QUEUES];
+static vio_queue_memory vio_queue_memories[VIO_MAX_QUEUES] MMU_UNCACHED;
+static uint32_t vio_queue_total = 1;
 
-static vio_descriptor* vio_descriptor_table;
-static vioqueue_available_ring* available_ring;
-static volatile vioqueue_used_ring* used_ring;
+static inline vio_queue* vio_current_queue(void) {
+    return &vio_queues[smp_cpu_id() % vio_queue_total];
+}
+
+// Request size limits negotiated with the device (size_max/seg_max)
+// Defaults allow one data segment per free descriptor and no size limit
+// beyond what a descriptor length can hold
+#define VIO_SEGMENT_DEFAULT_MAX_BYTES 0x80000000u
+static uint32_t vio_segment_max_bytes = VIO_SEGMENT_DEFAULT_MAX_BYTES;
+static uint32_t vio_segment_max_count = VIOQUEUE_MIN_SIZE - 2;
+
+// VIRTIO_RING_F_INDIRECT_DESC was negotiated
+static bool vio_indirect = false;
+
+// VIRTIO_BLK_F_RO / VIRTIO_BLK_F_FLUSH were negotiated
+static bool vio_read_only = false;
+static bool vio_flush_supported = false;
+
+// Write-back staging: writes land in the current buffer while they extend or
+// overwrite its range; the other buffer may be on its way to the device meanwhile
+#define VIO_WRITEBACK_BUFFERS 2
+#define VIO_WRITEBACK_SECTORS 32
+
+typedef struct {
+    uint8_t data[VIO_WRITEBACK_SECTORS * VIO_SECTOR_SIZE] __attribute__((aligned(64)));
+    uint32_t start_sector;
+    uint32_t sector_count; // 0 when nothing is staged
+    int request; // In-flight write of data, -1 when none
+} vio_writeback_buffer;
+
+static vio_writeback_buffer vio_writeback[VIO_WRITEBACK_BUFFERS];
+static int vio_writeback_current = 0;
+
+// Write-back state is shared by all cores; reads only take the lock while
+// some buffer holds data (vio_writeback_busy counts them)
+static spinlock vio_writeback_lock = SPINLOCK_INIT;
+static volatile uint32_t vio_writeback_busy = 0;
+
+// A staged write failed; reported (once) by the next vio_flush()
+static bool vio_writeback_failed = false;
+
+// Requests vio_transfer_sectors() keeps in flight, leaving a slot for each write-back buffer
+#define VIO_TRANSFER_MAX_REQUESTS (VIO_MAX_REQUESTS - VIO_WRITEBACK_BUFFERS)
+
+bool vio_event_index = false;
+
+// Use a packed ring when the device offers one (see vio_set_packed_ring())
+static bool vio_packed_allowed = true;
+
+// QEMU virt wires virtio-mmio slot n to SPI 16 + n
+#define VIO_MMIO_SLOT_SIZE 0x200
+#define VIO_MMIO_INTERRUPT_BASE 48
+
+// Completion mode: wait for the device interrupt, or spin on the used ring
+static uint32_t vio_interrupt_id;
+static bool vio_interrupt_registered = false;
+static bool vio_polling = false;
+
+// DMA cache maintenance: the device reads and writes memory behind the CPU
+// caches, so data buffers it reads are cleaned to memory before it is told
+// about them, and buffers it writes are dropped from the cache before the CPU
+// looks at them. On a cache-coherent bus these only cost the cache walks.
+
+// Rings and request slots are uncached (see vio_queue_memory): a barrier is
+// enough to make the CPU's writes visible to the device before a kick, and to
+// read what the device wrote only after it
+static inline void vio_sync_ring(void) {
+    asm volatile("dsb sy" : : : "memory");
+}
+
+// Release all request slots and start over with an empty ring
+static void vio_reset_queue(vio_queue* queue, bool legacy) {
+    for (int i = 0; i < VIO_MAX_REQUESTS; i++) {
+        queue->requests[i].state = VIO_REQUEST_FREE;
+    }
+    queue->requests_in_flight = 0;
+    queue->batch_depth = 0;
+    queue->free_count = queue->size;
+
+    queue->ring->setup(queue, legacy);
+    vio_sync_ring();
 
-static vio_block_request vio_request_header;
-static volatile uint8_t vio_request_status;
+    // Nobody is waiting yet; vio_wait() asks for interrupts when it sleeps
+    queue->ring->set_interrupts(queue, false);
+}
+
+static void vio_reset_writeback(void) {
+    for (int i = 0; i < VIO_WRITEBACK_BUFFERS; i++) {
+        vio_writeback[i].sector_count = 0;
+        vio_writeback[i].request = -1;
+    }
+    vio_writeback_current = 0;
+    vio_writeback_busy = 0;
+    vio_writeback_failed = false;
+}
 
-// Track which used ring entry we've processed up to
-static uint16_t last_used_index = 0;
+// Runs from the IRQ vector: only acknowledge, the waiter reaps the ring itself
+// so the ring bookkeeping is never touched from interrupt context
+static void vio_handle_interrupt(void* context) {
+    (void)context;
+    uint32_t status = vio_regs->interrupt_status;
+    vio_regs->interrupt_acknowledgement = status;
+}
 
 int vio_init() {
     // Scan MMIO slots to find VirtIO block device
@@ -44,9 +144,40 @@ int vio_init() {
     vio_regs->device_status |= VIO_DEVICE_STATUS_ACKNOWLEDGE;
     vio_regs->device_status |= VIO_DEVICE_STATUS_DRIVER;
 
-    // Negotiate features (legacy VirtIO doesn't require VIRTIO_F_VERSION_1)
-    vio_regs->selected_device_features = 0;
-    vio_regs->selected_driver_features = 0;
+    bool legacy = vio_regs->version == 1;
+
+    // Negotiate features
+    // Accept the request size limits so we know how far one request can go,
+    // indirect descriptors so a long chain only takes one ring slot,
+    // and event indexes so kicks and interrupts only happen when someone waits
+    // Several queues let every core submit without sharing ring state
+    vio_regs->selected_device_features = VIO_FEATURES_PAGE_1;
+    uint32_t features = vio_regs->device_features &
+        (VIO_BLOCK_FEATURE_SIZE_MAX | VIO_BLOCK_FEATURE_SEG_MAX |
+         VIO_BLOCK_FEATURE_RO | VIO_BLOCK_FEATURE_FLUSH | VIO_BLOCK_FEATURE_MQ |
+         VIO_RING_FEATURE_INDIRECT_DESC | VIO_RING_FEATURE_EVENT_IDX);
+    vio_regs->selected_driver_features = VIO_FEATURES_PAGE_1;
+    vio_regs->driver_features = features;
+
+    // Modern devices refuse drivers that do not accept VIRTIO_F_VERSION_1
+    // (legacy VirtIO doesn't require it and has no second feature page)
+    // They may also offer the packed ring, which touches fewer cache lines per request
+    uint32_t transport_features = 0;
+    if (!legacy) {
+        vio_regs->selected_device_features = VIO_FEATURES_PAGE_2;
+        uint32_t offered = vio_regs->device_features;
+        if (!(offered & VIO_FEATURE_VERSION_1)) {
+            vio_regs->device_status |= VIO_DEVICE_STATUS_FAILED;
+            return -1; // Version 2 transport without the version 1 interface
+        }
+        transport_features = VIO_FEATURE_VERSION_1;
+        if (vio_packed_allowed) {
+            transport_features |= offered & VIO_FEATURE_RING_PACKED;
+        }
+        vio_regs->selected_driver_features = VIO_FEATURES_PAGE_2;
+        vio_regs->driver_features = transport_features;
+    }
+
     vio_regs->device_status |= VIO_DEVICE_STATUS_FEATURES_OK;
 
     if (!(vio_regs->device_status & VIO_DEVICE_STATUS_FEATURES_OK)) {
@@ -54,27 +185,84 @@ int vio_init() {
         return -1; // Device did not accept features
     }
 
-    vio_regs->selected_queue = 0;
+    vio_indirect = (features & VIO_RING_FEATURE_INDIRECT_DESC) != 0;
+    vio_event_index = (features & VIO_RING_FEATURE_EVENT_IDX) != 0;
+    vio_read_only = (features & VIO_BLOCK_FEATURE_RO) != 0;
+    vio_flush_supported = (features & VIO_BLOCK_FEATURE_FLUSH) != 0;
+
+    const vio_ring_ops* ring = (transport_features & VIO_FEATURE_RING_PACKED) ? &vio_packed_ring : &vio_split_ring;
+
+    vio_queue_total = 1;
+    if (features & VIO_BLOCK_FEATURE_MQ) {
+        uint32_t num_queues = vio_regs->config.num_queues;
+        vio_queue_total = num_queues < VIO_MAX_QUEUES ? num_queues : VIO_MAX_QUEUES;
+        if (vio_queue_total == 0) {
+            vio_queue_total = 1;
+        }
+    }
+
+    uint16_t smallest_size = VIOQUEUE_MAX_SIZE;
+    for (uint32_t i = 0; i < vio_queue_total; i++) {
+        vio_queue* queue = &vio_queues[i];
+        queue->ring = ring;
+        queue->number = (uint16_t)i;
+        queue->lock.locked = 0;
+        queue->memory = vio_queue_memories[i].ring;
+        queue->requests = vio_queue_memories[i].requests;
+        vio_regs->selected_queue = queue->number;
+
+        // Use the deepest queue both sides support (split rings need a power of 2)
+        uint32_t maximum_size = vio_regs->queue_maximum_size;
+        if (maximum_size > VIOQUEUE_MAX_SIZE) {
+            maximum_size = VIOQUEUE_MAX_SIZE;
+        }
+        if (maximum_size < VIOQUEUE_MIN_SIZE) {
+            return -1; // Queue too small
+        }
+        queue->size = VIOQUEUE_MIN_SIZE;
+        while (queue->size * 2 <= maximum_size) {
+            queue->size *= 2;
+        }
+        if (queue->size < smallest_size) {
+            smallest_size = queue->size;
+        }
+
+        vio_regs->selected_queue_size = queue->size;
 
-    if (vio_regs->queue_maximum_size < 16) {
-        return -1; // Queue too small
+        // Lay out the ring and hand it to the device (selected_queue picks which)
+        vio_reset_queue(queue, legacy);
     }
 
-    vio_regs->selected_queue_size = VIOQUEUE_SIZE;
+    // Read the request size limits from the device configuration space
+    vio_segment_max_bytes = VIO_SEGMENT_DEFAULT_MAX_BYTES;
+    vio_segment_max_count = smallest_size - 2;
+
+    if (features & VIO_BLOCK_FEATURE_SIZE_MAX) {
+        // Segments must hold whole sectors
+        uint32_t size_max = vio_regs->config.size_max & ~(uint32_t)(VIO_SECTOR_SIZE - 1);
+        if (size_max >= VIO_SECTOR_SIZE && size_max < vio_segment_max_bytes) {
+            vio_segment_max_bytes = size_max;
+        }
+    }
 
-    // Set up queue layout pointers
-    vio_descriptor_table = vio_queue.descriptors;
-    available_ring = &vio_queue.available;
-    used_ring = &vio_queue.used;
+    if (features & VIO_BLOCK_FEATURE_SEG_MAX) {
+        uint32_t seg_max = vio_regs->config.seg_max;
+        if (seg_max >= 1 && seg_max < vio_segment_max_count) {
+            vio_segment_max_count = seg_max;
+        }
+    }
 
-    // Set guest page size BEFORE setting PFN
-    vio_regs->guest_page_size = VIO_PAGE_SIZE;
+    vio_reset_writeback();
 
-    // For VirtIO v1: Pass physical page frame number
-    // In bare metal, physical == virtual, so just divide by page size
-    uint64_t queue_addr = (uint64_t)&vio_queue;
-    uint32_t pfn = (uint32_t)(queue_addr / VIO_PAGE_SIZE);
-    vio_regs->queue_pfn = pfn;
+    // Route completions through the GIC when interrupts are available
+    if (vio_interrupt_registered) {
+        irq_unregister(vio_interrupt_id);
+        vio_interrupt_registered = false;
+    }
+    if (irq_is_initialized()) {
+        vio_interrupt_id = VIO_MMIO_INTERRUPT_BASE + (uint32_t)(((uint64_t)vio_regs - VIO_BASE) / VIO_MMIO_SLOT_SIZE);
+        vio_interrupt_registered = irq_register(vio_interrupt_id, vio_handle_interrupt, NULL) == 0;
+    }
 
     // Set final status
     vio_regs->device_status |= VIO_DEVICE_STATUS_DRIVER_OK;
@@ -82,105 +270,522 @@ int vio_init() {
     return 0;
 }
 
-int vio_read_sector(uint32_t sector, uint8_t* buffer) {
-    // Initialize status to non-OK value
-    vio_request_status = 0xFF;
+uint32_t vio_queue_count(void) {
+    return vio_queue_total;
+}
+
+uint32_t vio_max_request_sectors(void) {
+    // Keep the byte length of a request within 32 bits
+    uint64_t max_request_sectors = (uint64_t)(vio_segment_max_bytes / VIO_SECTOR_SIZE) * vio_segment_max_count;
+    if (max_request_sectors > UINT32_MAX / VIO_SECTOR_SIZE) {
+        max_request_sectors = UINT32_MAX / VIO_SECTOR_SIZE;
+    }
+    return (uint32_t)max_request_sectors;
+}
+
+static inline bool vio_ranges_overlap(uint32_t start_a, uint32_t count_a, uint32_t start_b, uint32_t count_b) {
+    return start_a < start_b + count_b && start_b < start_a + count_a;
+}
+
+static void vio_writeback_drain_overlapping(uint32_t start_sector, uint32_t sector_count);
+
+// Queue one request (header -> data segments -> status) without waiting for it
+// Each buffer is split into segments of at most vio_segment_max_bytes. When the
+// device supports it, the chain lives in the slot's indirect table and takes a
+// single ring descriptor, otherwise it takes one ring descriptor per segment
+static int vio_submit(uint32_t type, uint32_t sector, const vio_iovec* iov, int iovcnt) {
+    vio_queue* queue = vio_current_queue();
+
+    // Flushes are the only requests without data
+    if (type == VIO_BLOCK_REQUEST_TYPE_FLUSH ? iovcnt != 0 : (iov == NULL || iovcnt <= 0)) {
+        return -1; // Invalid parameters
+    }
+
+    uint32_t segments = 0;
+    uint64_t total_length = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        if (iov[i].buffer == NULL || iov[i].length == 0) {
+            return -1; // Invalid buffer
+        }
+        segments += (iov[i].length + vio_segment_max_bytes - 1) / vio_segment_max_bytes;
+        total_length += iov[i].length;
+    }
+    if (total_length % VIO_SECTOR_SIZE != 0 || total_length > UINT32_MAX) {
+        return -1; // Transfers are made of whole sectors
+    }
+    if (segments > vio_segment_max_count) {
+        return -1; // Request does not fit in a single chain
+    }
+
+    // Data the device reads goes to memory; buffers it fills must not hold
+    // dirty lines that could be evicted over the incoming data
+    uint64_t dma_start = UINT64_MAX;
+    uint64_t dma_end = 0;
+    for (int i = 0; i < iovcnt; i++) {
+        if (type == VIO_BLOCK_REQUEST_TYPE_READ) {
+            mmu_clean_invalidate_range(iov[i].buffer, iov[i].length);
+        } else {
+            mmu_clean_range(iov[i].buffer, iov[i].length);
+        }
+        uint64_t start = (uint64_t)iov[i].buffer;
+        dma_start = start < dma_start ? start : dma_start;
+        dma_end = start + iov[i].length > dma_end ? start + iov[i].length : dma_end;
+    }
+
+    // Reads must see staged and in-flight writes to the same sectors,
+    // and the device does not order requests against each other
+    if (type == VIO_BLOCK_REQUEST_TYPE_READ && vio_writeback_busy > 0) {
+        spin_lock(&vio_writeback_lock);
+        vio_writeback_drain_overlapping(sector, (uint32_t)(total_length / VIO_SECTOR_SIZE));
+        spin_unlock(&vio_writeback_lock);
+    }
+
+    uint16_t descriptor_count = (uint16_t)(segments + 2);
+    bool indirect = vio_indirect && descriptor_count <= VIO_INDIRECT_MAX_DESCRIPTORS;
+    uint16_t ring_descriptor_count = indirect ? 1 : descriptor_count;
+
+    spin_lock(&queue->lock);
+
+    // Find a free request slot
+    int slot = -1;
+    for (int i = 0; i < VIO_MAX_REQUESTS; i++) {
+        if (queue->requests[i].state == VIO_REQUEST_FREE) {
+            slot = i;
+            break;
+        }
+    }
+    if (slot < 0) {
+        spin_unlock(&queue->lock);
+        return -1; // Every slot holds a result nobody has collected
+    }
+
+    // Wait for in-flight requests to give back enough descriptors
+    // (they may still be sitting in an open batch, so make sure the device knows)
+    int timeout = 10000000;
+    if (queue->free_count < ring_descriptor_count) {
+        queue->ring->kick(queue);
+    }
+    while (queue->free_count < ring_descriptor_count) {
+        if (queue->requests_in_flight == 0 || timeout-- == 0) {
+            spin_unlock(&queue->lock);
+            return -1; // Nothing left to reap or device stopped responding
+        }
+        vio_sync_ring();
+        queue->ring->reap(queue);
+    }
 
-    // Memory barrier before preparing the request
-    __sync_synchronize();
+    vio_request_slot* request = &queue->requests[slot];
+
+    // Initialize status to non-OK value
+    request->status = 0xFF;
+    request->state = VIO_REQUEST_PENDING;
+    request->ring_descriptors = ring_descriptor_count;
 
     // Prepare block request
-    vio_request_header.type = VIO_BLOCK_REQUEST_TYPE_READ;
-    vio_request_header.reserved = 0;
-    vio_request_header.sector = sector;
-
-    // Set up descriptors (chain: request -> data -> status)
-    // Descriptor 0: Request header (read-only)
-    vio_descriptor_table[0].address = (uint64_t)&vio_request_header;
-    vio_descriptor_table[0].length = sizeof(vio_block_request);
-    vio_descriptor_table[0].flags = VIO_DESCRIPTOR_FLAG_NEXT;
-    vio_descriptor_table[0].next = 1;
-
-    // Descriptor 1: Data buffer (written by device)
-    vio_descriptor_table[1].address = (uint64_t)buffer;
-    vio_descriptor_table[1].length = VIO_SECTOR_SIZE;
-    vio_descriptor_table[1].flags = VIO_DESCRIPTOR_FLAG_WRITE | VIO_DESCRIPTOR_FLAG_NEXT;
-    vio_descriptor_table[1].next = 2;
-
-    // Descriptor 2: Status byte (written by device)
-    vio_descriptor_table[2].address = (uint64_t)&vio_request_status;
-    vio_descriptor_table[2].length = sizeof(uint8_t);
-    vio_descriptor_table[2].flags = VIO_DESCRIPTOR_FLAG_WRITE;
-    vio_descriptor_table[2].next = 0;
-
-    // Memory barrier before notifying device
-    __sync_synchronize();
-
-    // Add to available ring
-    uint16_t available_ring_index = available_ring->index % VIOQUEUE_SIZE;
-    available_ring->ring[available_ring_index] = 0;  // Descriptor chain starts at 0
-
-    // Save expected index BEFORE submitting the request
-    uint16_t expected_used_index = used_ring->index + 1;
-    
-    // Memory barrier before incrementing available index
-    __sync_synchronize();
-
-    // Notify device that new descriptor is available
-    available_ring->index++;
-
-    // Memory barrier before kicking device
-    __sync_synchronize();
-
-    // Kick the device - for v1 MMIO, write queue number to queue_notification
-    vio_regs->queue_notification = 0;
+    request->header.type = type;
+    request->header.reserved = 0;
+    request->header.sector = sector;
+    request->dma_start = type == VIO_BLOCK_REQUEST_TYPE_READ ? dma_start : 0;
+    request->dma_end = type == VIO_BLOCK_REQUEST_TYPE_READ ? dma_end : 0;
+
+    vio_chain chain = {
+        .request = request,
+        .iov = iov,
+        .iovcnt = iovcnt,
+        .count = descriptor_count,
+        .device_writes_data = type == VIO_BLOCK_REQUEST_TYPE_READ,
+        .segment_max_bytes = vio_segment_max_bytes,
+    };
+    queue->ring->publish(queue, (uint16_t)slot, &chain, indirect);
+    queue->requests_in_flight++;
+
+    queue->stats.requests++;
+    if (type == VIO_BLOCK_REQUEST_TYPE_READ) {
+        queue->stats.sectors_read += (uint32_t)(total_length / VIO_SECTOR_SIZE);
+    } else if (type == VIO_BLOCK_REQUEST_TYPE_WRITE) {
+        queue->stats.sectors_written += (uint32_t)(total_length / VIO_SECTOR_SIZE);
+    }
+
+    int handle = (int)(queue - vio_queues) * VIO_MAX_REQUESTS + slot;
+    TRACE(type == VIO_BLOCK_REQUEST_TYPE_READ ? TRACE_VIO_READ
+        : type == VIO_BLOCK_REQUEST_TYPE_WRITE ? TRACE_VIO_WRITE : TRACE_VIO_FLUSH,
+        sector, (uint32_t)(total_length / VIO_SECTOR_SIZE) << 8 | (uint32_t)handle);
+
+    // Header, indirect table and ring entries out to memory before the device looks
+    vio_sync_ring();
+
+    // Batched submissions kick once in vio_batch_end()
+    if (queue->batch_depth == 0) {
+        queue->ring->kick(queue);
+    }
+
+    spin_unlock(&queue->lock);
+
+    return handle;
+}
+
+int vio_submit_read(uint32_t start_sector, uint32_t sector_count, uint8_t* buffer) {
+    if (buffer == NULL || sector_count == 0 || sector_count > vio_max_request_sectors()) {
+        return -1; // Invalid parameters
+    }
+
+    vio_iovec iov = { buffer, sector_count * VIO_SECTOR_SIZE };
+    return vio_submit(VIO_BLOCK_REQUEST_TYPE_READ, start_sector, &iov, 1);
+}
+
+int vio_submit_readv(uint32_t start_sector, const vio_iovec* iov, int iovcnt) {
+    return vio_submit(VIO_BLOCK_REQUEST_TYPE_READ, start_sector, iov, iovcnt);
+}
+
+int vio_readv(uint32_t start_sector, const vio_iovec* iov, int iovcnt) {
+    int request = vio_submit_readv(start_sector, iov, iovcnt);
+    if (request < 0) {
+        return -1;
+    }
+
+    return vio_wait(request);
+}
+
+// Find the queue a request handle belongs to
+static vio_queue* vio_request_queue(int request) {
+    if (request < 0 || (uint32_t)request >= vio_queue_total * VIO_MAX_REQUESTS) {
+        return NULL;
+    }
+    return &vio_queues[request / VIO_MAX_REQUESTS];
+}
+
+int vio_poll(int request) {
+    vio_queue* queue = vio_request_queue(request);
+    if (queue == NULL) {
+        return -1; // Not a submitted request
+    }
+
+    spin_lock(&queue->lock);
+
+    vio_request_slot* slot = &queue->requests[request % VIO_MAX_REQUESTS];
+    if (slot->state == VIO_REQUEST_FREE) {
+        spin_unlock(&queue->lock);
+        return -1; // Not a submitted request
+    }
+
+    if (slot->state == VIO_REQUEST_PENDING) {
+        // A request still waiting in an open batch would never complete
+        queue->ring->kick(queue);
+        vio_sync_ring();
+        queue->ring->reap(queue);
+        if (slot->state == VIO_REQUEST_PENDING) {
+            spin_unlock(&queue->lock);
+            return 0; // Still owned by the device
+        }
+    }
+
+    // Drop lines fetched while the device was writing the data
+    if (slot->dma_end > slot->dma_start) {
+        mmu_clean_invalidate_range((const void*)slot->dma_start, slot->dma_end - slot->dma_start);
+    }
+
+    // Release the slot and report the status byte written by the device
+    slot->state = VIO_REQUEST_FREE;
+    uint8_t status = slot->status;
+    spin_unlock(&queue->lock);
+
+    if (status != VIO_REQUEST_STATUS_OK) {
+        uart_puts("I/O error from device\n");
+        return -1;
+    }
+
+    return 1;
+}
+
+void vio_batch_begin(void) {
+    vio_queue* queue = vio_current_queue();
+    spin_lock(&queue->lock);
+    queue->batch_depth++;
+    spin_unlock(&queue->lock);
+}
+
+void vio_batch_end(void) {
+    vio_queue* queue = vio_current_queue();
+    spin_lock(&queue->lock);
+    if (queue->batch_depth > 0 && --queue->batch_depth == 0) {
+        queue->ring->kick(queue);
+    }
+    spin_unlock(&queue->lock);
+}
+
+void vio_set_polling(bool polling) {
+    vio_polling = polling;
+}
+
+void vio_set_packed_ring(bool enabled) {
+    vio_packed_allowed = enabled;
+}
+
+void vio_get_ring_info(vio_ring_info* info) {
+    vio_queue* queue = vio_current_queue();
+
+    info->packed = queue->ring == &vio_packed_ring;
+    info->queue_size = queue->size;
+    info->ring_memory = queue->memory;
+    info->ring_memory_size = queue->memory_used;
+    info->request_memory = (const uint8_t*)queue->requests;
+    info->request_memory_size = sizeof(vio_queue_memories[0].requests);
+}
+
+void vio_get_stats(vio_stats* stats) {
+    stats->requests = 0;
+    stats->sectors_read = 0;
+    stats->sectors_written = 0;
+    for (uint32_t i = 0; i < VIO_MAX_QUEUES; i++) {
+        stats->requests += vio_queues[i].stats.requests;
+        stats->sectors_read += vio_queues[i].stats.sectors_read;
+        stats->sectors_written += vio_queues[i].stats.sectors_written;
+    }
+}
+
+int vio_wait(int request) {
+    vio_queue* queue = vio_request_queue(request);
+    int result;
+
+    if (queue == NULL) {
+        return -1; // Not a submitted request
+    }
+
+    // The GIC delivers the device interrupt to core 0 only
+    if (vio_interrupt_registered && !vio_polling && smp_cpu_id() == 0) {
+        // Keep IRQs masked between the ring check and WFI so a completion
+        // cannot slip in unnoticed; irq_wait() lets the handler run after waking
+        uint64_t flags = irq_save();
+        while ((result = vio_poll(request)) == 0) {
+            spin_lock(&queue->lock);
+            queue->ring->set_interrupts(queue, true);
+            vio_sync_ring();
+            bool completed = queue->ring->has_completions(queue);
+            spin_unlock(&queue->lock);
+            if (completed) {
+                continue; // Completed before the device saw the request for an interrupt
+            }
+            irq_wait();
+        }
+        spin_lock(&queue->lock);
+        queue->ring->set_interrupts(queue, false);
+        spin_unlock(&queue->lock);
+        irq_restore(flags);
+
+        return result < 0 ? -1 : 0;
+    }
 
     // Wait for the device to process THIS request
     int timeout = 10000000;
-    while (timeout > 0) {
-        // Memory barrier to ensure we see device updates
-        __sync_synchronize();
-        
-        // Check if device has processed our request
-        if (used_ring->index >= expected_used_index) {
-            // Device has completed our request
-            last_used_index = used_ring->index;
-            
-            // CRITICAL: Memory barrier after device completion to ensure
-            // buffer and status updates are visible to the CPU
-            __sync_synchronize();
-            break;
+    while ((result = vio_poll(request)) == 0) {
+        if (--timeout == 0) {
+            return -1; // Timeout waiting for device
         }
-        timeout--;
     }
 
-    if (timeout == 0) {
-        return -1; // Timeout waiting for device
+    return result < 0 ? -1 : 0;
+}
+
+// Move a range of sectors between the disk and one buffer, split into as many
+// requests as needed; several stay in flight, waiting for the oldest one only
+// when the request budget is used up
+static int vio_transfer_sectors(uint32_t type, uint32_t start_sector, uint32_t sector_count, uint8_t* buffer) {
+    if (buffer == NULL) {
+        return -1; // Invalid buffer
     }
 
-    // Acknowledge interrupt if one is pending
-    if (vio_regs->interrupt_status) {
-        vio_regs->interrupt_acknowledgement = vio_regs->interrupt_status;
+    uint32_t max_request_sectors = vio_max_request_sectors();
+
+    int requests[VIO_TRANSFER_MAX_REQUESTS];
+    int submitted = 0;
+    int completed = 0;
+    int result = 0;
+
+    // One kick for the whole range (waiting on the oldest request kicks early)
+    vio_batch_begin();
+
+    while (sector_count > 0 && result == 0) {
+        if (submitted - completed == VIO_TRANSFER_MAX_REQUESTS) {
+            if (vio_wait(requests[completed++ % VIO_TRANSFER_MAX_REQUESTS]) < 0) {
+                result = -1;
+            }
+        }
+
+        uint32_t request_sectors = sector_count < max_request_sectors ? sector_count : max_request_sectors;
+        vio_iovec iov = { buffer, request_sectors * VIO_SECTOR_SIZE };
+        int request = vio_submit(type, start_sector, &iov, 1);
+        if (request < 0) {
+            result = -1;
+            break;
+        }
+        requests[submitted++ % VIO_TRANSFER_MAX_REQUESTS] = request;
+
+        start_sector += request_sectors;
+        sector_count -= request_sectors;
+        buffer += request_sectors * VIO_SECTOR_SIZE;
     }
-    
-    // Another memory barrier to ensure all device writes are visible
-    __sync_synchronize();
 
-    // Check status byte written by device
-    if (vio_request_status != VIO_REQUEST_STATUS_OK) {
-        uart_puts("I/O error from device\n");
-        return -1; // Read failed
+    vio_batch_end();
+
+    // Every buffer belongs to the caller again only once all requests are done
+    while (completed < submitted) {
+        if (vio_wait(requests[completed++ % VIO_TRANSFER_MAX_REQUESTS]) < 0) {
+            result = -1;
+        }
     }
 
-    return 0;
+    return result;
+}
+
+int vio_read_sector(uint32_t sector, uint8_t* buffer) {
+    return vio_read_sectors(sector, 1, buffer);
 }
 
 int vio_read_sectors(uint32_t start_sector, uint32_t sector_count, uint8_t* buffer) {
-    for (uint32_t i = 0; i < sector_count; i++) {
-        uint8_t* sector_buffer = buffer + (i * VIO_SECTOR_SIZE);
-        if (vio_read_sector(start_sector + i, sector_buffer) != 0) {
-            return -1;
+    return vio_transfer_sectors(VIO_BLOCK_REQUEST_TYPE_READ, start_sector, sector_count, buffer);
+}
+
+// Wait for a write-back buffer's write to finish and empty the buffer
+static int vio_writeback_wait(vio_writeback_buffer* writeback) {
+    if (writeback->request < 0) {
+        return 0;
+    }
+
+    int result = vio_wait(writeback->request);
+    writeback->request = -1;
+    writeback->sector_count = 0;
+    vio_writeback_busy--;
+    if (result < 0) {
+        vio_writeback_failed = true;
+    }
+    return result;
+}
+
+// Start writing out whatever a buffer has staged
+// The device may reorder requests, so an overlapping write still in flight must finish first
+static int vio_writeback_submit(vio_writeback_buffer* writeback) {
+    if (writeback->sector_count == 0 || writeback->request >= 0) {
+        return 0; // Nothing staged, or already on its way
+    }
+
+    for (int i = 0; i < VIO_WRITEBACK_BUFFERS; i++) {
+        vio_writeback_buffer* other = &vio_writeback[i];
+        if (other != writeback && other->request >= 0 &&
+            vio_ranges_overlap(other->start_sector, other->sector_count,
+                writeback->start_sector, writeback->sector_count)) {
+            vio_writeback_wait(other);
         }
     }
+
+    vio_iovec iov = { writeback->data, writeback->sector_count * VIO_SECTOR_SIZE };
+    writeback->request = vio_submit(VIO_BLOCK_REQUEST_TYPE_WRITE, writeback->start_sector, &iov, 1);
+    if (writeback->request < 0) {
+        vio_writeback_failed = true;
+        writeback->sector_count = 0; // Dropped; vio_flush() reports it
+        vio_writeback_busy--;
+        return -1;
+    }
     return 0;
-}
\ No newline at end of file
+}
+
+// Get every staged or in-flight write to the given sectors onto the disk
+// All vio_writeback_* helpers expect vio_writeback_lock to be held
+static void vio_writeback_drain_overlapping(uint32_t start_sector, uint32_t sector_count) {
+    for (int i = 0; i < VIO_WRITEBACK_BUFFERS; i++) {
+        vio_writeback_buffer* writeback = &vio_writeback[i];
+        if (writeback->sector_count > 0 &&
+            vio_ranges_overlap(writeback->start_sector, writeback->sector_count, start_sector, sector_count)) {
+            vio_writeback_submit(writeback);
+            vio_writeback_wait(writeback);
+        }
+    }
+}
+
+static int vio_write_sectors_locked(uint32_t start_sector, uint32_t sector_count, const uint8_t* buffer) {
+    // Coalesce with the current buffer when the write extends or overwrites its range
+    vio_writeback_buffer* current = &vio_writeback[vio_writeback_current];
+    if (current->sector_count > 0 && current->request < 0 &&
+        start_sector >= current->start_sector &&
+        start_sector <= current->start_sector + current->sector_count &&
+        start_sector + sector_count <= current->start_sector + VIO_WRITEBACK_SECTORS) {
+        uint32_t offset = start_sector - current->start_sector;
+        memcpy(current->data + offset * VIO_SECTOR_SIZE, buffer, sector_count * VIO_SECTOR_SIZE);
+        if (offset + sector_count > current->sector_count) {
+            current->sector_count = offset + sector_count;
+        }
+        return 0;
+    }
+
+    // Send the current buffer off and stage into the other one once its write is done
+    int result = 0;
+    if (current->sector_count > 0) {
+        result = vio_writeback_submit(current);
+        vio_writeback_current = (vio_writeback_current + 1) % VIO_WRITEBACK_BUFFERS;
+        current = &vio_writeback[vio_writeback_current];
+    }
+    if (vio_writeback_wait(current) < 0) {
+        result = -1;
+    }
+
+    if (sector_count > VIO_WRITEBACK_SECTORS) {
+        // Too big to stage: write straight from the caller's buffer, after
+        // anything still in flight to the same sectors
+        vio_writeback_drain_overlapping(start_sector, sector_count);
+        if (vio_transfer_sectors(VIO_BLOCK_REQUEST_TYPE_WRITE, start_sector, sector_count, (uint8_t*)buffer) < 0) {
+            result = -1;
+        }
+        return result;
+    }
+
+    memcpy(current->data, buffer, sector_count * VIO_SECTOR_SIZE);
+    current->start_sector = start_sector;
+    current->sector_count = sector_count;
+    vio_writeback_busy++;
+
+    return result;
+}
+
+int vio_write_sectors(uint32_t start_sector, uint32_t sector_count, const uint8_t* buffer) {
+    if (buffer == NULL || sector_count == 0) {
+        return -1; // Invalid parameters
+    }
+    if (vio_read_only) {
+        return -1; // Device refuses writes
+    }
+
+    spin_lock(&vio_writeback_lock);
+    int result = vio_write_sectors_locked(start_sector, sector_count, buffer);
+    spin_unlock(&vio_writeback_lock);
+
+    return result;
+}
+
+int vio_flush(void) {
+    spin_lock(&vio_writeback_lock);
+
+    // Both buffers go out together, then we wait for both
+    vio_batch_begin();
+    for (int i = 0; i < VIO_WRITEBACK_BUFFERS; i++) {
+        vio_writeback_submit(&vio_writeback[i]);
+    }
+    vio_batch_end();
+
+    for (int i = 0; i < VIO_WRITEBACK_BUFFERS; i++) {
+        vio_writeback_wait(&vio_writeback[i]);
+    }
+
+    int result = vio_writeback_failed ? -1 : 0;
+    vio_writeback_failed = false;
+
+    spin_unlock(&vio_writeback_lock);
+
+    // Without VIRTIO_BLK_F_FLUSH the device has no volatile cache to empty
+    if (vio_flush_supported) {
+        int request = vio_submit(VIO_BLOCK_REQUEST_TYPE_FLUSH, 0, NULL, 0);
+        if (request < 0 || vio_wait(request) < 0) {
+            result = -1;
+        }
+    }
+
+    return result;
+}
@@ -6,7 +6,8 @@
 #include <stdbool.h>
 
 #define VIO_BASE 0x0A000000
-#define VIOQUEUE_SIZE 16
+#define VIOQUEUE_MAX_SIZE 256 // Deepest queue the driver will negotiate (power of 2)
+#define VIOQUEUE_MIN_SIZE 4 // Room for at least one request (header, data, status)
 #define VIO_SECTOR_SIZE 512
 #define VIO_PAGE_SIZE 4096
 
@@ -24,6 +25,37 @@
 #define VIO_FEATURES_PAGE_1 0x0
 #define VIO_FEATURES_PAGE_2 0x1
 
+// Transport feature bits (feature page 2, i.e. bits 32-63)
+#define VIO_FEATURE_VERSION_1 (1u << 0) // Device follows the modern (non-legacy) interface
+#define VIO_FEATURE_RING_PACKED (1u << 2) // Device supports the packed virtqueue layout
+
+// Block device feature bits (feature page 1)
+#define VIO_BLOCK_FEATURE_SIZE_MAX (1u << 1) // Device reports size_max in its config space
+#define VIO_BLOCK_FEATURE_SEG_MAX (1u << 2) // Device reports seg_max in its config space
+#define VIO_BLOCK_FEATURE_RO (1u << 5) // Device is read-only
+#define VIO_BLOCK_FEATURE_FLUSH (1u << 9) // Device has a volatile write cache and accepts flush requests
+#define VIO_BLOCK_FEATURE_MQ (1u << 12) // Device reports num_queues and serves several request queues
+
+// Ring feature bits (feature page 1)
+#define VIO_RING_FEATURE_INDIRECT_DESC (1u << 28) // Descriptors may point to a table of descriptors
+#define VIO_RING_FEATURE_EVENT_IDX (1u << 29) // used_event/available_event replace the ring flags
+
+// Block device configuration space, located at offset 0x100 of the MMIO registers
+// Only the fields the driver uses are listed; 64-bit fields are split into
+// 32-bit halves because MMIO accesses should not be wider than 32 bits
+typedef struct __attribute__((packed)) {
+    uint32_t capacity_low; // 0x100 - Device capacity in 512-byte sectors
+    uint32_t capacity_high; // 0x104
+    uint32_t size_max; // 0x108 - Maximum bytes in a single data segment (VIO_BLOCK_FEATURE_SIZE_MAX)
+    uint32_t seg_max; // 0x10C - Maximum data segments in a single request (VIO_BLOCK_FEATURE_SEG_MAX)
+    uint32_t geometry; // 0x110 - Cylinders, heads, sectors (unused)
+    uint32_t block_size; // 0x114 - Optimal block size (unused)
+    uint32_t topology[2]; // 0x118 - Physical block and I/O size hints (unused)
+    uint8_t writeback; // 0x120 - Cache mode (unused)
+    uint8_t reserved; // 0x121
+    uint16_t num_queues; // 0x122 - Number of request queues (VIO_BLOCK_FEATURE_MQ)
+} vio_block_config;
+
 typedef volatile struct __attribute__((packed)) { 
     uint32_t magic_value; // 0x000 - Should be 0x74726976
     uint32_t version; // 0x004 - Should be 1 or 2
@@ -41,7 +73,7 @@ typedef volatile struct __attribute__((packed)) {
     uint32_t selected_queue_size; // 0x038
     uint32_t queue_align; // 0x03C - v1 only  
     uint32_t queue_pfn; // 0x040 - v1 only (Page Frame Number)
-    uint32_t reserved_2; // 0x044
+    uint32_t queue_ready; // 0x044 - v2 only
     uint32_t reserved_3[2]; // 0x048 - 0x04F
     uint32_t queue_notification; // 0x050
     uint32_t reserved_4[3]; // 0x054 - 0x05F
@@ -58,11 +90,18 @@ typedef volatile struct __attribute__((packed)) {
     uint32_t reserved_8[2]; // 0x098 - 0x09F
     uint32_t used_ring_address_low; // 0x0A0 - v2 only
     uint32_t used_ring_address_high; // 0x0A4 - v2 only
+    uint32_t reserved_9[21]; // 0x0A8 - 0x0FB
+    uint32_t config_generation; // 0x0FC - v2 only
+    vio_block_config config; // 0x100 - Device-specific configuration space
 } vio_mmio_registers;
 
 
 #define VIO_DESCRIPTOR_FLAG_NEXT 0x0001
 #define VIO_DESCRIPTOR_FLAG_WRITE 0x0002
+#define VIO_DESCRIPTOR_FLAG_INDIRECT 0x0004
+
+#define VIO_AVAILABLE_FLAG_NO_INTERRUPT 0x0001 // Driver does not want used buffer interrupts
+#define VIO_USED_FLAG_NO_NOTIFY 0x0001 // Device does not need queue_notification kicks
 
 typedef struct __attribute__((packed)) { 
     uint64_t address;
@@ -72,10 +111,13 @@ typedef struct __attribute__((packed)) {
 } vio_descriptor;
 
 
+// The rings are sized at runtime from the negotiated queue size, so the event
+// index that follows each ring is reached through VIOQUEUE_USED_EVENT() and
+// VIOQUEUE_AVAILABLE_EVENT() rather than a named field
 typedef struct __attribute__((packed)) {
     uint16_t flags;
     uint16_t index;
-    uint16_t ring[VIOQUEUE_SIZE];
+    uint16_t ring[]; // One entry per queue slot, followed by used_event
 } vioqueue_available_ring;
 
 
@@ -87,22 +129,60 @@ typedef struct __attribute__((packed)) {
 typedef struct __attribute__((packed)) {
     uint16_t flags;
     volatile uint16_t index;
-    vioqueue_used_element ring[VIOQUEUE_SIZE];
+    vioqueue_used_element ring[]; // One entry per queue slot, followed by available_event
 } vioqueue_used_ring;
 
+// used_event: the device only interrupts once the used index passes this value (EVENT_IDX)
+#define VIOQUEUE_USED_EVENT(available, n) \
+    (*(volatile uint16_t*)&(available)->ring[(n)])
+// available_event: the driver only kicks once the available index passes this value (EVENT_IDX)
+#define VIOQUEUE_AVAILABLE_EVENT(used, n) \
+    (*(volatile uint16_t*)&(used)->ring[(n)])
 
-// VirtIO queue layout structure for version 1
-// Must be in contiguous memory with proper alignment
-typedef struct {
-    vio_descriptor descriptors[VIOQUEUE_SIZE];
-    vioqueue_available_ring available;
-    uint8_t padding[4096 - (sizeof(vio_descriptor) * VIOQUEUE_SIZE + sizeof(vioqueue_available_ring)) % 4096];
-    vioqueue_used_ring used __attribute__((aligned(4096)));
-} vio_queue_layout;
+
+// Split virtqueue part sizes for a queue of n entries, including the trailing event index
+#define VIOQUEUE_DESCRIPTOR_TABLE_SIZE(n) (sizeof(vio_descriptor) * (n))
+#define VIOQUEUE_AVAILABLE_RING_SIZE(n) (sizeof(vioqueue_available_ring) + sizeof(uint16_t) * ((n) + 1))
+#define VIOQUEUE_USED_RING_SIZE(n) (sizeof(vioqueue_used_ring) + sizeof(vioqueue_used_element) * (n) + sizeof(uint16_t))
+
+// Part alignments: v2 only needs natural alignment, v1 puts the used ring on its own page
+#define VIOQUEUE_DESCRIPTOR_TABLE_ALIGN 16
+#define VIOQUEUE_AVAILABLE_RING_ALIGN 2
+#define VIOQUEUE_USED_RING_ALIGN 4
+#define VIOQUEUE_LEGACY_ALIGN VIO_PAGE_SIZE
+
+
+// Packed virtqueue (VIO_FEATURE_RING_PACKED): one ring of descriptors that the
+// driver and device hand back and forth using the AVAIL/USED flag bits
+#define VIO_PACKED_DESCRIPTOR_FLAG_AVAIL (1u << 7)
+#define VIO_PACKED_DESCRIPTOR_FLAG_USED (1u << 15)
+
+typedef struct __attribute__((packed)) {
+    uint64_t address;
+    uint32_t length;
+    uint16_t id; // Buffer ID, returned by the device in the used descriptor
+    uint16_t flags; // VIO_DESCRIPTOR_FLAG_* and the AVAIL/USED wrap bits
+} vio_packed_descriptor;
+
+#define VIO_PACKED_EVENT_FLAG_ENABLE 0x0 // Notify on every event
+#define VIO_PACKED_EVENT_FLAG_DISABLE 0x1 // Never notify
+#define VIO_PACKED_EVENT_FLAG_DESC 0x2 // Notify at the position in offset_wrap (EVENT_IDX only)
+
+// Event suppression area; the driver area tells the device when to interrupt,
+// the device area tells the driver when to kick
+typedef struct __attribute__((packed)) {
+    uint16_t offset_wrap; // Bits 0-14: ring position, bit 15: wrap counter
+    uint16_t flags; // VIO_PACKED_EVENT_FLAG_*
+} vio_packed_event;
+
+#define VIOQUEUE_PACKED_RING_SIZE(n) (sizeof(vio_packed_descriptor) * (n))
+#define VIOQUEUE_PACKED_RING_ALIGN 16
+#define VIOQUEUE_PACKED_EVENT_ALIGN 4
 
 
 #define VIO_BLOCK_REQUEST_TYPE_READ 0x00
 #define VIO_BLOCK_REQUEST_TYPE_WRITE 0x01
+#define VIO_BLOCK_REQUEST_TYPE_FLUSH 0x04
 
 #define VIO_REQUEST_STATUS_OK 0x00
 #define VIO_REQUEST_STATUS_IO_ERROR 0x01
@@ -113,17 +193,88 @@ typedef struct __attribute__((packed)) {
     uint64_t sector;
 } vio_block_request;
 
+// One buffer of a scatter-gather transfer
+typedef struct {
+    uint8_t* buffer;
+    uint32_t length; // Bytes; the lengths of one transfer must add up to whole sectors
+} vio_iovec;
+
+// Where the driver keeps its queue, for benchmarks and debugging
+typedef struct {
+    bool packed; // Packed virtqueue in use (split otherwise)
+    uint16_t queue_size;
+    const uint8_t* ring_memory; // Descriptors, rings and event areas shared with the device
+    size_t ring_memory_size;
+    const uint8_t* request_memory; // Request headers, status bytes and indirect tables
+    size_t request_memory_size;
+} vio_ring_info;
+
+// Requests handed to the device since boot, for timing reports
+typedef struct {
+    uint32_t requests; // Reads, writes and flushes submitted
+    uint32_t sectors_read;
+    uint32_t sectors_written;
+} vio_stats;
+
 
 /**
  * @brief Initializes the VIO block device.
  *
  * This function must be called before any other VIO operations.
  * It sets up the device and prepares it for I/O.
+ * If irq_init() was called first, completions are interrupt-driven and waiters
+ * sleep in WFI; otherwise the driver polls the used ring.
+ * Version 2 (modern) devices are driven through the ring address registers,
+ * version 1 (legacy) devices through queue_pfn. The queue depth is the largest
+ * power of 2 allowed by both queue_maximum_size and VIOQUEUE_MAX_SIZE.
+ * Modern devices that offer VIO_FEATURE_RING_PACKED get a packed virtqueue,
+ * everything else a split virtqueue; the rest of the API is the same for both.
+ * Writes still staged from before are dropped; call vio_flush() first to keep them.
+ * With VIO_BLOCK_FEATURE_MQ every core gets its own request queue (up to the
+ * number the device offers); cores beyond that share them.
+ * Must be called before other cores start using the device.
  *
  * @return 0 on success, negative value on error.
  */
 int vio_init();
 
+/**
+ * @brief Returns the number of request queues set up by vio_init().
+ *
+ * Requests go to queue smp_cpu_id() % vio_queue_count(), so cores that do not
+ * share a queue submit and reap without contending for anything.
+ *
+ * @return The queue count, at least 1 after a successful vio_init().
+ */
+uint32_t vio_queue_count(void);
+
+/**
+ * @brief Allows or forbids the packed virtqueue at the next vio_init().
+ *
+ * Allowed by default. Forbidding it forces the split ring even when the device
+ * offers packed rings, e.g. to compare both in a benchmark.
+ *
+ * @param enabled true to use a packed ring when the device offers one.
+ */
+void vio_set_packed_ring(bool enabled);
+
+/**
+ * @brief Describes the queue set up by vio_init().
+ *
+ * @param info Filled with the ring type, depth and the memory shared with the device.
+ */
+void vio_get_ring_info(vio_ring_info* info);
+
+/**
+ * @brief Copies the request counters of every queue, added up.
+ *
+ * The counters start at zero and are not reset by vio_init(), so the
+ * difference between two calls is what was submitted in between.
+ *
+ * @param stats Filled with the counters.
+ */
+void vio_get_stats(vio_stats* stats);
+
 /**
  * @brief Reads a single sector from the VIO block device.
  *
@@ -138,6 +289,10 @@ int vio_read_sector(uint32_t sector, uint8_t* buffer);
 /**
  * @brief Reads multiple consecutive sectors from the VIO block device.
  *
+ * The range is issued as a single request whose data descriptors cover the
+ * whole buffer. It is only split into several requests when it exceeds the
+ * device's size_max/seg_max limits.
+ *
  * @param start_sector The first sector number to read.
  * @param sector_count The number of sectors to read.
  * @param buffer Pointer to a buffer of at least (sector_count * VIO_SECTOR_SIZE) bytes to receive the data.
@@ -147,4 +302,135 @@ int vio_read_sector(uint32_t sector, uint8_t* buffer);
  */
 int vio_read_sectors(uint32_t start_sector, uint32_t sector_count, uint8_t* buffer);
 
+/**
+ * @brief Writes consecutive sectors to the VIO block device.
+ *
+ * Small writes are staged in a write-back buffer and coalesced with the writes
+ * that follow them, so a run of adjacent sectors reaches the device as one
+ * request. Staged data is written when a non-adjacent write arrives, when the
+ * buffer is full, when a read overlaps it, or at vio_flush(). Writes larger than
+ * the buffer go to the device directly and are complete on return.
+ * Either way the caller may reuse buffer as soon as this returns.
+ *
+ * @param start_sector The first sector to write.
+ * @param sector_count The number of consecutive sectors to write.
+ * @param buffer The data to write. Must be at least sector_count * VIO_SECTOR_SIZE bytes.
+ *
+ * @return 0 on success, negative value on error (e.g., read-only device, I/O error
+ *         from an earlier staged write).
+ */
+int vio_write_sectors(uint32_t start_sector, uint32_t sector_count, const uint8_t* buffer);
+
+/**
+ * @brief Makes every write so far durable.
+ *
+ * Writes out the write-back buffers, waits for them, and then asks the device to
+ * empty its own write cache with a flush request when it advertises
+ * VIO_BLOCK_FEATURE_FLUSH.
+ *
+ * @return 0 on success, negative value if any write since the last vio_flush() failed.
+ */
+int vio_flush(void);
+
+/**
+ * @brief Returns the largest number of sectors a single request can carry.
+ *
+ * The limit follows the size_max/seg_max values negotiated in vio_init().
+ *
+ * @return Maximum sector_count accepted by vio_submit_read().
+ */
+uint32_t vio_max_request_sectors(void);
+
+/**
+ * @brief Queues a read of consecutive sectors without waiting for it to finish.
+ *
+ * Several requests can be in flight at once. If the queue has no free descriptors,
+ * this function waits for earlier requests to complete before queueing. The buffer
+ * must not be touched until the request is collected with vio_poll() or vio_wait().
+ *
+ * @param start_sector The first sector number to read.
+ * @param sector_count The number of sectors to read (at most vio_max_request_sectors()).
+ * @param buffer Pointer to a buffer of at least (sector_count * VIO_SECTOR_SIZE) bytes to receive the data.
+ *
+ * @return A request handle (>= 0) on success, negative value on error.
+ * @note The device must be initialized with vio_init() before calling this function.
+ */
+int vio_submit_read(uint32_t start_sector, uint32_t sector_count, uint8_t* buffer);
+
+/**
+ * @brief Reads consecutive sectors into several discontiguous buffers with one request.
+ *
+ * The device fills the buffers in order, e.g. one cluster into a cache page and the
+ * remainder straight into a caller's buffer. When the device supports indirect
+ * descriptors, the whole scatter-gather list takes a single ring slot.
+ *
+ * @param start_sector The first sector number to read.
+ * @param iov Array of buffers; their lengths must add up to a multiple of VIO_SECTOR_SIZE.
+ * @param iovcnt Number of entries in iov.
+ *
+ * @return 0 on success, negative value on error (e.g., list too long for one request, I/O error).
+ * @note The device must be initialized with vio_init() before calling this function.
+ */
+int vio_readv(uint32_t start_sector, const vio_iovec* iov, int iovcnt);
+
+/**
+ * @brief Queues a scatter-gather read without waiting for it to finish.
+ *
+ * Same as vio_readv(), but returns a request handle to collect with vio_poll() or vio_wait().
+ *
+ * @return A request handle (>= 0) on success, negative value on error.
+ */
+int vio_submit_readv(uint32_t start_sector, const vio_iovec* iov, int iovcnt);
+
+/**
+ * @brief Starts a batch of submissions that share a single device notification.
+ *
+ * Requests submitted until vio_batch_end() are published on the available ring
+ * right away, but the device is only kicked once at the end of the batch.
+ * Batches may nest; waiting on a request inside a batch kicks early.
+ */
+void vio_batch_begin(void);
+
+/**
+ * @brief Ends a batch started with vio_batch_begin() and notifies the device if needed.
+ */
+void vio_batch_end(void);
+
+/**
+ * @brief Checks whether a submitted request has completed, without blocking.
+ *
+ * Once a request is reported as completed (successfully or not), its handle is
+ * released and must not be used again.
+ *
+ * @param request The handle returned by vio_submit_read() or vio_submit_readv().
+ *
+ * @return 1 if the request completed successfully, 0 if it is still in flight,
+ *         negative value on error (e.g., I/O error, invalid handle).
+ */
+int vio_poll(int request);
+
+/**
+ * @brief Waits for a submitted request to complete and releases its handle.
+ *
+ * Handles name their queue, so any core may wait on them, but waiting on the
+ * submitting core avoids touching another core's queue.
+ *
+ * @param request The handle returned by vio_submit_read() or vio_submit_readv().
+ *
+ * @return 0 on success, negative value on error (e.g., I/O error, timeout, invalid handle).
+ */
+int vio_wait(int request);
+
+/**
+ * @brief Selects how vio_wait() waits for completions.
+ *
+ * Polling spins on the used ring and has the lowest latency, which is useful for
+ * benchmarking. Interrupt mode sleeps in WFI and is only used when the interrupt
+ * was registered during vio_init() (i.e., irq_init() was called first).
+ * The device has a single interrupt, routed to core 0; other cores always poll.
+ *
+ * @param polling true to spin on the used ring, false to wait for interrupts.
+ */
+void vio_set_polling(bool polling);
+
 #endif
\ No newline at end of file
@@ -0,0 +1,195 @@
+#ifndef VIOQUEUE_H
+#define VIOQUEUE_H
+
+#include "vio.h"
+#include "../../smp/smp.h"
+#include "../../trace/trace.h"
+
+// Internal to the VIO driver: the state of one virtqueue and the ring formats
+// (split or packed) that can drive it. Nothing outside filesystem/vio includes this.
+
+// Request slot states
+#define VIO_REQUEST_FREE 0 // Slot can be handed out by vio_submit_read()
+#define VIO_REQUEST_PENDING 1 // Chain is on the ring, device owns it
+#define VIO_REQUEST_DONE 2 // Device returned the chain, waiting for vio_poll()/vio_wait()
+
+// Per-request header and status live in a slot so several requests can be in flight
+// Without indirect descriptors every request uses at least 3 ring descriptors, so
+// the ring runs out first; with them every request uses one, so the slots do
+#define VIO_MAX_REQUESTS 32
+
+// Request queues the driver sets up with VIO_BLOCK_FEATURE_MQ
+// Each core submits to queue smp_cpu_id() % count; request handles are
+// queue index * VIO_MAX_REQUESTS + slot
+#define VIO_MAX_QUEUES 4
+
+// Descriptors in a request's indirect table (header + data segments + status)
+#define VIO_INDIRECT_MAX_DESCRIPTORS 32
+
+// Both descriptor formats are 16 bytes, so one table serves either ring
+#define VIO_INDIRECT_DESCRIPTOR_SIZE 16
+
+typedef struct {
+    uint8_t indirect[VIO_INDIRECT_MAX_DESCRIPTORS * VIO_INDIRECT_DESCRIPTOR_SIZE] __attribute__((aligned(16))); // Read by the device
+    vio_block_request header; // Read by the device
+    volatile uint8_t status; // Written by the device
+    uint8_t state;
+    uint16_t head; // First ring descriptor of the chain
+    uint16_t ring_descriptors; // Ring descriptors the chain occupies
+    // Span of the data buffers of a read, dropped from the cache again at
+    // completion in case lines were fetched while the device was writing
+    uint64_t dma_start;
+    uint64_t dma_end;
+} vio_request_slot;
+
+// One piece of a request chain, before it is written out in a ring's format
+typedef struct {
+    uint64_t address;
+    uint32_t length;
+    bool device_writes;
+} vio_segment;
+
+// A request chain (header -> data segments -> status) that is walked once while publishing
+typedef struct {
+    vio_request_slot* request;
+    const vio_iovec* iov;
+    int iovcnt;
+    uint16_t count; // Segments in the chain, header and status included
+    bool device_writes_data; // The device fills the data buffers (reads)
+    uint32_t segment_max_bytes;
+
+    // Walk position
+    uint16_t position;
+    int iov_index;
+    uint32_t iov_offset;
+} vio_chain;
+
+// Returns the next segment of the chain; call exactly chain->count times
+static inline vio_segment vio_chain_next(vio_chain* chain) {
+    vio_segment segment;
+
+    if (chain->position == 0) {
+        segment.address = (uint64_t)&chain->request->header;
+        segment.length = sizeof(vio_block_request);
+        segment.device_writes = false;
+    } else if (chain->position == chain->count - 1) {
+        segment.address = (uint64_t)&chain->request->status;
+        segment.length = sizeof(uint8_t);
+        segment.device_writes = true;
+    } else {
+        const vio_iovec* buffer = &chain->iov[chain->iov_index];
+        uint32_t remaining = buffer->length - chain->iov_offset;
+
+        segment.address = (uint64_t)(buffer->buffer + chain->iov_offset);
+        segment.length = remaining < chain->segment_max_bytes ? remaining : chain->segment_max_bytes;
+        segment.device_writes = chain->device_writes_data;
+
+        chain->iov_offset += segment.length;
+        if (chain->iov_offset == buffer->length) {
+            chain->iov_index++;
+            chain->iov_offset = 0;
+        }
+    }
+
+    chain->position++;
+    return segment;
+}
+
+typedef struct vio_queue vio_queue;
+
+// Operations that differ between the split and the packed ring
+typedef struct {
+    // Lay the ring out in queue->memory and hand it to the device
+    void (*setup)(vio_queue* queue, bool legacy);
+    // Write a chain to the ring and make it available (the caller kicks)
+    // indirect: put the chain in the request's indirect table behind one ring descriptor
+    void (*publish)(vio_queue* queue, uint16_t request, vio_chain* chain, bool indirect);
+    // Hand every chain the device has returned to vioqueue_complete()
+    void (*reap)(vio_queue* queue);
+    // Whether the device has returned a chain reap() has not seen yet
+    bool (*has_completions)(vio_queue* queue);
+    // Notify the device about newly available chains, unless it said it does not need it
+    void (*kick)(vio_queue* queue);
+    // Ask for (or stop asking for) an interrupt at the next completion
+    void (*set_interrupts)(vio_queue* queue, bool enabled);
+} vio_ring_ops;
+
+// Backing memory for one queue, sized for the largest layout: the legacy
+// split ring, whose used ring must start on its own page
+#define VIO_QUEUE_MEMORY_SIZE \
+    (((VIOQUEUE_DESCRIPTOR_TABLE_SIZE(VIOQUEUE_MAX_SIZE) + VIOQUEUE_AVAILABLE_RING_SIZE(VIOQUEUE_MAX_SIZE) \
+        + VIOQUEUE_LEGACY_ALIGN - 1) / VIOQUEUE_LEGACY_ALIGN) * VIOQUEUE_LEGACY_ALIGN \
+        + VIOQUEUE_USED_RING_SIZE(VIOQUEUE_MAX_SIZE))
+
+// Everything one queue shares with the device. Driver and device write the
+// same cache lines here (the split ring's used_event next to the used index,
+// the descriptors of a packed ring, a slot's status next to its header), so
+// cleaning a line the CPU dirtied would write stale data over the device's.
+// It lives in uncached memory (MMU_UNCACHED) and needs no cache maintenance.
+typedef struct {
+    uint8_t ring[VIO_QUEUE_MEMORY_SIZE] __attribute__((aligned(4096)));
+    vio_request_slot requests[VIO_MAX_REQUESTS];
+} vio_queue_memory;
+
+struct vio_queue {
+    uint8_t* memory; // Ring memory, in vio_queue_memory
+    uint32_t memory_used; // Bytes of memory the current layout shares with the device
+
+    // Uncontended unless more cores than queues are submitting
+    spinlock lock;
+
+    const vio_ring_ops* ring;
+    uint16_t number; // Written to queue_notification
+    uint16_t size; // Negotiated depth (power of 2, at most VIOQUEUE_MAX_SIZE)
+    uint16_t free_count; // Ring descriptors the device does not own
+    uint16_t requests_in_flight;
+    uint32_t batch_depth; // Open vio_batch_begin() calls; kicks wait until it drops to 0
+    vio_stats stats; // Requests submitted through this queue
+
+    // Split ring
+    vio_descriptor* descriptors;
+    vioqueue_available_ring* available;
+    volatile vioqueue_used_ring* used;
+    uint16_t free_head; // Free descriptors are linked through their next field
+    uint16_t last_used_index; // Used ring entry we've processed up to
+    uint16_t last_kicked_index; // Available index the device was last told about
+    uint8_t descriptor_request[VIOQUEUE_MAX_SIZE]; // Head descriptor -> request slot
+
+    // Packed ring
+    volatile vio_packed_descriptor* packed;
+    volatile vio_packed_event* driver_event;
+    volatile vio_packed_event* device_event;
+    uint16_t next_available;
+    uint16_t next_used;
+    bool available_wrap;
+    bool used_wrap;
+    uint16_t added_since_kick; // Descriptors made available since the last kick
+
+    vio_request_slot* requests; // VIO_MAX_REQUESTS slots, in vio_queue_memory
+};
+
+extern volatile vio_mmio_registers* vio_regs;
+
+// VIRTIO_RING_F_EVENT_IDX was negotiated
+extern bool vio_event_index;
+
+extern const vio_ring_ops vio_split_ring;
+extern const vio_ring_ops vio_packed_ring;
+
+// Called by reap() for every chain the device has returned
+static inline void vioqueue_complete(vio_queue* queue, uint16_t request) {
+    queue->requests[request].state = VIO_REQUEST_DONE;
+    queue->requests_in_flight--;
+    TRACE(TRACE_VIO_COMPLETE, queue->number * VIO_MAX_REQUESTS + request, queue->requests_in_flight);
+}
+
+static inline uint64_t vioqueue_align(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) & ~(alignment - 1);
+}
+
+// Same test the device uses: did the index move past event while going from old to new?
+static inline bool vioqueue_need_event(uint16_t event, uint16_t new_index, uint16_t old_index) {
+    return (uint16_t)(new_index - event - 1) < (uint16_t)(new_index - old_index);
+}
+
+#endif
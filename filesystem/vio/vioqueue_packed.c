@@ -0,0 +1,210 @@
+#include "vioqueue.h"
+#include "../../libc-lite/string.h"
+
+// Packed virtqueue: a single descriptor ring shared by driver and device.
+// The driver writes chains at next_available, the device overwrites them in place
+// with used descriptors, and the driver reads those back at next_used. Whose turn
+// a descriptor is follows from its AVAIL/USED bits and each side's wrap counter,
+// which flips every time that side goes around the ring.
+
+// AVAIL/USED bits of a descriptor the driver makes available during the given lap
+static inline uint16_t packed_available_flags(bool wrap) {
+    return wrap ? VIO_PACKED_DESCRIPTOR_FLAG_AVAIL : VIO_PACKED_DESCRIPTOR_FLAG_USED;
+}
+
+// Packed rings only exist on modern devices, which take the three area addresses
+static void packed_setup(vio_queue* queue, bool legacy) {
+    (void)legacy;
+
+    uint64_t base = (uint64_t)queue->memory;
+    uint64_t driver_event = vioqueue_align(base + VIOQUEUE_PACKED_RING_SIZE(queue->size), VIOQUEUE_PACKED_EVENT_ALIGN);
+    uint64_t device_event = driver_event + sizeof(vio_packed_event);
+
+    queue->packed = (volatile vio_packed_descriptor*)base;
+    queue->driver_event = (volatile vio_packed_event*)driver_event;
+    queue->device_event = (volatile vio_packed_event*)device_event;
+    queue->memory_used = (uint32_t)(device_event + sizeof(vio_packed_event) - base);
+
+    // Start from a clean ring: all flags clear means nothing is available yet
+    memset(queue->memory, 0, queue->memory_used);
+
+    // Both wrap counters start at 1
+    queue->next_available = 0;
+    queue->next_used = 0;
+    queue->available_wrap = true;
+    queue->used_wrap = true;
+    queue->added_since_kick = 0;
+
+    vio_regs->descriptor_table_address_low = (uint32_t)base;
+    vio_regs->descriptor_table_address_high = (uint32_t)(base >> 32);
+    vio_regs->available_ring_address_low = (uint32_t)driver_event;
+    vio_regs->available_ring_address_high = (uint32_t)(driver_event >> 32);
+    vio_regs->used_ring_address_low = (uint32_t)device_event;
+    vio_regs->used_ring_address_high = (uint32_t)(device_event >> 32);
+
+    vio_regs->queue_ready = 1;
+}
+
+static void packed_advance_available(vio_queue* queue) {
+    if (++queue->next_available == queue->size) {
+        queue->next_available = 0;
+        queue->available_wrap = !queue->available_wrap;
+    }
+}
+
+// The chain goes into consecutive ring descriptors (or one indirect descriptor).
+// Every descriptor carries the slot number as buffer ID. The head's flags are
+// written last so the device never sees a half-written chain.
+static void packed_publish(vio_queue* queue, uint16_t request, vio_chain* chain, bool indirect) {
+    vio_request_slot* slot = &queue->requests[request];
+    uint16_t head = queue->next_available;
+    uint16_t head_flags;
+    uint16_t ring_descriptors;
+
+    slot->head = head;
+
+    if (indirect) {
+        // Indirect tables are read in order, so they need no NEXT flags or IDs
+        vio_packed_descriptor* table = (vio_packed_descriptor*)slot->indirect;
+        for (uint16_t i = 0; i < chain->count; i++) {
+            vio_segment segment = vio_chain_next(chain);
+            table[i].address = segment.address;
+            table[i].length = segment.length;
+            table[i].id = 0;
+            table[i].flags = segment.device_writes ? VIO_DESCRIPTOR_FLAG_WRITE : 0;
+        }
+
+        queue->packed[head].address = (uint64_t)table;
+        queue->packed[head].length = chain->count * sizeof(vio_packed_descriptor);
+        queue->packed[head].id = request;
+        head_flags = VIO_DESCRIPTOR_FLAG_INDIRECT | packed_available_flags(queue->available_wrap);
+        packed_advance_available(queue);
+        ring_descriptors = 1;
+    } else {
+        head_flags = 0;
+        for (uint16_t i = 0; i < chain->count; i++) {
+            uint16_t position = queue->next_available;
+            vio_segment segment = vio_chain_next(chain);
+
+            // A chain that runs off the end of the ring continues in the next lap
+            uint16_t flags = packed_available_flags(queue->available_wrap);
+            if (i + 1 < chain->count) {
+                flags |= VIO_DESCRIPTOR_FLAG_NEXT;
+            }
+            if (segment.device_writes) {
+                flags |= VIO_DESCRIPTOR_FLAG_WRITE;
+            }
+
+            queue->packed[position].address = segment.address;
+            queue->packed[position].length = segment.length;
+            queue->packed[position].id = request;
+            if (i == 0) {
+                head_flags = flags;
+            } else {
+                queue->packed[position].flags = flags;
+            }
+            packed_advance_available(queue);
+        }
+        ring_descriptors = chain->count;
+    }
+
+    // Memory barrier so the whole chain is visible before the head flips
+    __sync_synchronize();
+
+    queue->packed[head].flags = head_flags;
+    queue->free_count -= ring_descriptors;
+    queue->added_since_kick += ring_descriptors;
+}
+
+// The device has returned the descriptor at position once both bits match its lap
+static inline bool packed_is_used(vio_queue* queue, uint16_t position) {
+    uint16_t flags = queue->packed[position].flags;
+    bool available = (flags & VIO_PACKED_DESCRIPTOR_FLAG_AVAIL) != 0;
+    bool used = (flags & VIO_PACKED_DESCRIPTOR_FLAG_USED) != 0;
+    return available == used && used == queue->used_wrap;
+}
+
+// Used descriptors come back one per chain; the chain's length (kept in its slot)
+// says where the next one will be written
+static void packed_reap(vio_queue* queue) {
+    // Memory barrier to ensure we see device updates
+    __sync_synchronize();
+
+    while (packed_is_used(queue, queue->next_used)) {
+        // Read the ID only after the flags said the descriptor is ours
+        __sync_synchronize();
+        uint16_t request = queue->packed[queue->next_used].id;
+        uint16_t ring_descriptors = queue->requests[request].ring_descriptors;
+
+        queue->next_used += ring_descriptors;
+        if (queue->next_used >= queue->size) {
+            queue->next_used -= queue->size;
+            queue->used_wrap = !queue->used_wrap;
+        }
+        queue->free_count += ring_descriptors;
+        vioqueue_complete(queue, request);
+    }
+
+    // CRITICAL: Memory barrier after device completion to ensure
+    // buffer and status updates are visible to the CPU
+    __sync_synchronize();
+}
+
+static bool packed_has_completions(vio_queue* queue) {
+    __sync_synchronize();
+    return packed_is_used(queue, queue->next_used);
+}
+
+// Notify the device unless its event suppression area says otherwise
+// With EVENT_IDX it may ask to be told only once a given ring position is passed
+static void packed_kick(vio_queue* queue) {
+    if (queue->added_since_kick == 0) {
+        return; // Nothing new since the last kick
+    }
+
+    // Memory barrier so the device's suppression state is read after our descriptors
+    __sync_synchronize();
+
+    // Offset and flags are read together so they belong to the same update
+    uint32_t event = *(volatile uint32_t*)queue->device_event;
+    uint16_t offset_wrap = (uint16_t)event;
+    uint16_t flags = (uint16_t)(event >> 16);
+
+    bool notify;
+    if (vio_event_index && flags == VIO_PACKED_EVENT_FLAG_DESC) {
+        // Positions from the other lap are moved back by one ring length so the
+        // usual index comparison works across the wrap
+        uint16_t event_index = offset_wrap & 0x7FFF;
+        bool event_wrap = (offset_wrap >> 15) != 0;
+        if (event_wrap != queue->available_wrap) {
+            event_index -= queue->size;
+        }
+
+        uint16_t new_index = queue->next_available;
+        uint16_t old_index = new_index - queue->added_since_kick;
+        notify = vioqueue_need_event(event_index, new_index, old_index);
+    } else {
+        notify = flags != VIO_PACKED_EVENT_FLAG_DISABLE;
+    }
+    queue->added_since_kick = 0;
+
+    if (notify) {
+        vio_regs->queue_notification = queue->number;
+    }
+}
+
+static void packed_set_interrupts(vio_queue* queue, bool enabled) {
+    queue->driver_event->flags = enabled ? VIO_PACKED_EVENT_FLAG_ENABLE : VIO_PACKED_EVENT_FLAG_DISABLE;
+
+    // Memory barrier so the ring is re-read after the request is visible
+    __sync_synchronize();
+}
+
+const vio_ring_ops vio_packed_ring = {
+    .setup = packed_setup,
+    .publish = packed_publish,
+    .reap = packed_reap,
+    .has_completions = packed_has_completions,
+    .kick = packed_kick,
+    .set_interrupts = packed_set_interrupts,
+};
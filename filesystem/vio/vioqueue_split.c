@@ -0,0 +1,208 @@
+#include "vioqueue.h"
+#include "../../libc-lite/string.h"
+
+// Split virtqueue: descriptor table, available ring (driver -> device) and
+// used ring (device -> driver) in three separate areas
+
+// Carve the descriptor table and both rings out of queue->memory
+// v2 packs them back to back; v1 needs the used ring on the next page boundary
+static void split_setup(vio_queue* queue, bool legacy) {
+    uint64_t base = (uint64_t)queue->memory;
+    uint64_t available = base + VIOQUEUE_DESCRIPTOR_TABLE_SIZE(queue->size);
+    uint64_t used = available + VIOQUEUE_AVAILABLE_RING_SIZE(queue->size);
+    used = vioqueue_align(used, legacy ? VIOQUEUE_LEGACY_ALIGN : VIOQUEUE_USED_RING_ALIGN);
+
+    queue->descriptors = (vio_descriptor*)base;
+    queue->available = (vioqueue_available_ring*)available;
+    queue->used = (volatile vioqueue_used_ring*)used;
+    queue->memory_used = (uint32_t)(used + VIOQUEUE_USED_RING_SIZE(queue->size) - base);
+
+    // Start from clean rings
+    memset(queue->memory, 0, queue->memory_used);
+
+    // Put every descriptor on the free list
+    for (uint16_t i = 0; i < queue->size; i++) {
+        queue->descriptors[i].next = i + 1;
+    }
+    queue->free_head = 0;
+    queue->last_used_index = 0;
+    queue->last_kicked_index = 0;
+
+    if (legacy) {
+        // Set guest page size BEFORE setting PFN
+        vio_regs->guest_page_size = VIO_PAGE_SIZE;
+        vio_regs->queue_align = VIOQUEUE_LEGACY_ALIGN;
+
+        // For VirtIO v1: Pass physical page frame number
+        // In bare metal, physical == virtual, so just divide by page size
+        vio_regs->queue_pfn = (uint32_t)(base / VIO_PAGE_SIZE);
+    } else {
+        // For VirtIO v2: Pass each part of the split ring separately
+        vio_regs->descriptor_table_address_low = (uint32_t)base;
+        vio_regs->descriptor_table_address_high = (uint32_t)(base >> 32);
+        vio_regs->available_ring_address_low = (uint32_t)available;
+        vio_regs->available_ring_address_high = (uint32_t)(available >> 32);
+        vio_regs->used_ring_address_low = (uint32_t)used;
+        vio_regs->used_ring_address_high = (uint32_t)(used >> 32);
+
+        vio_regs->queue_ready = 1;
+    }
+}
+
+// Take a chain of count linked descriptors off the free list
+static uint16_t split_alloc_descriptors(vio_queue* queue, uint16_t count) {
+    uint16_t head = queue->free_head;
+    uint16_t last = head;
+    for (uint16_t i = 1; i < count; i++) {
+        last = queue->descriptors[last].next;
+    }
+    queue->free_head = queue->descriptors[last].next;
+    queue->free_count -= count;
+    return head;
+}
+
+// Return a completed chain to the free list
+static void split_free_descriptors(vio_queue* queue, uint16_t head) {
+    uint16_t last = head;
+    uint16_t count = 1;
+    while (queue->descriptors[last].flags & VIO_DESCRIPTOR_FLAG_NEXT) {
+        last = queue->descriptors[last].next;
+        count++;
+    }
+    queue->descriptors[last].next = queue->free_head;
+    queue->free_head = head;
+    queue->free_count += count;
+}
+
+static void split_publish(vio_queue* queue, uint16_t request, vio_chain* chain, bool indirect) {
+    vio_request_slot* slot = &queue->requests[request];
+
+    uint16_t head = split_alloc_descriptors(queue, indirect ? 1 : chain->count);
+    slot->head = head;
+    queue->descriptor_request[head] = (uint8_t)request;
+
+    vio_descriptor* table;
+    uint16_t descriptor;
+    if (indirect) {
+        // The ring descriptor points at the slot's table, which holds the whole chain
+        table = (vio_descriptor*)slot->indirect;
+        for (uint16_t i = 0; i < chain->count; i++) {
+            table[i].next = i + 1;
+        }
+        descriptor = 0;
+
+        queue->descriptors[head].address = (uint64_t)table;
+        queue->descriptors[head].length = chain->count * sizeof(vio_descriptor);
+        queue->descriptors[head].flags = VIO_DESCRIPTOR_FLAG_INDIRECT;
+    } else {
+        // The free list already links the chain together through next
+        table = queue->descriptors;
+        descriptor = head;
+    }
+
+    // Every segment but the status byte links to the next one
+    // The last next keeps pointing past the chain; without FLAG_NEXT the device ignores it
+    for (uint16_t i = 0; i < chain->count; i++) {
+        vio_segment segment = vio_chain_next(chain);
+
+        table[descriptor].address = segment.address;
+        table[descriptor].length = segment.length;
+        table[descriptor].flags = 0;
+        if (i + 1 < chain->count) {
+            table[descriptor].flags |= VIO_DESCRIPTOR_FLAG_NEXT;
+        }
+        if (segment.device_writes) {
+            table[descriptor].flags |= VIO_DESCRIPTOR_FLAG_WRITE;
+        }
+        descriptor = table[descriptor].next;
+    }
+
+    // Memory barrier before notifying device
+    __sync_synchronize();
+
+    // Add to available ring
+    queue->available->ring[queue->available->index & (queue->size - 1)] = head;
+
+    // Memory barrier before incrementing available index
+    __sync_synchronize();
+
+    queue->available->index++;
+}
+
+// Collect every chain the device has returned since the last call
+// The used element index names the head of the chain, which may be any descriptor
+static void split_reap(vio_queue* queue) {
+    // Memory barrier to ensure we see device updates
+    __sync_synchronize();
+
+    if (queue->used->index == queue->last_used_index) {
+        return; // Nothing new
+    }
+
+    while (queue->used->index != queue->last_used_index) {
+        uint16_t head = (uint16_t)queue->used->ring[queue->last_used_index & (queue->size - 1)].index;
+
+        split_free_descriptors(queue, head);
+        vioqueue_complete(queue, queue->descriptor_request[head]);
+        queue->last_used_index++;
+    }
+
+    // CRITICAL: Memory barrier after device completion to ensure
+    // buffer and status updates are visible to the CPU
+    __sync_synchronize();
+}
+
+static bool split_has_completions(vio_queue* queue) {
+    __sync_synchronize();
+    return queue->used->index != queue->last_used_index;
+}
+
+// Notify the device about everything published since the last kick, unless it
+// told us (through available_event or the used ring flags) that it does not need it
+static void split_kick(vio_queue* queue) {
+    uint16_t new_index = queue->available->index;
+    if (new_index == queue->last_kicked_index) {
+        return; // Nothing new since the last kick
+    }
+
+    // Memory barrier so the device's suppression state is read after our index update
+    __sync_synchronize();
+
+    bool notify;
+    if (vio_event_index) {
+        notify = vioqueue_need_event(VIOQUEUE_AVAILABLE_EVENT(queue->used, queue->size),
+            new_index, queue->last_kicked_index);
+    } else {
+        notify = !(queue->used->flags & VIO_USED_FLAG_NO_NOTIFY);
+    }
+    queue->last_kicked_index = new_index;
+
+    if (notify) {
+        // Kick the device - for MMIO, write queue number to queue_notification
+        vio_regs->queue_notification = queue->number;
+    }
+}
+
+// With EVENT_IDX, used_event names the completion we want to hear about and
+// the flags are ignored; without it the flags switch interrupts on and off
+static void split_set_interrupts(vio_queue* queue, bool enabled) {
+    if (vio_event_index) {
+        if (enabled) {
+            VIOQUEUE_USED_EVENT(queue->available, queue->size) = queue->last_used_index;
+        }
+    } else {
+        queue->available->flags = enabled ? 0 : VIO_AVAILABLE_FLAG_NO_INTERRUPT;
+    }
+
+    // Memory barrier so the used ring is re-read after the request is visible
+    __sync_synchronize();
+}
+
+const vio_ring_ops vio_split_ring = {
+    .setup = split_setup,
+    .publish = split_publish,
+    .reap = split_reap,
+    .has_completions = split_has_completions,
+    .kick = split_kick,
+    .set_interrupts = split_set_interrupts,
+};
@@ -0,0 +1,67 @@
+#include "gic.h"
+
+static gic_distributor_registers* gic_distributor = (gic_distributor_registers*)GIC_DISTRIBUTOR_BASE;
+static gic_cpu_interface_registers* gic_cpu_interface = (gic_cpu_interface_registers*)GIC_CPU_INTERFACE_BASE;
+
+void gic_init(void) {
+    // Disable forwarding while the distributor is configured
+    gic_distributor->control = 0;
+
+    // Number of implemented interrupt lines is 32 * (ITLinesNumber + 1)
+    uint32_t lines = 32 * ((gic_distributor->type & 0x1F) + 1);
+    if (lines > GIC_MAX_INTERRUPTS) {
+        lines = GIC_MAX_INTERRUPTS;
+    }
+
+    // Start with every shared interrupt disabled, not pending, default priority, aimed at CPU 0
+    for (uint32_t i = GIC_SPI_BASE; i < lines; i += 32) {
+        gic_distributor->clear_enable[i / 32] = 0xFFFFFFFF;
+        gic_distributor->clear_pending[i / 32] = 0xFFFFFFFF;
+    }
+    for (uint32_t i = GIC_SPI_BASE; i < lines; i++) {
+        gic_distributor->priority[i] = GIC_DEFAULT_PRIORITY;
+        gic_distributor->target[i] = 0x01;
+    }
+
+    gic_distributor->control = GIC_DISTRIBUTOR_ENABLE;
+
+    // Let every priority through to this core
+    gic_cpu_interface->priority_mask = GIC_LOWEST_PRIORITY_MASK;
+    gic_cpu_interface->binary_point = 0;
+    gic_cpu_interface->control = GIC_CPU_INTERFACE_ENABLE;
+}
+
+void gic_shutdown(void) {
+    gic_cpu_interface->control = 0;
+    gic_distributor->control = 0;
+}
+
+void gic_enable_interrupt(uint32_t interrupt_id) {
+    if (interrupt_id >= GIC_MAX_INTERRUPTS) {
+        return;
+    }
+
+    gic_distributor->priority[interrupt_id] = GIC_DEFAULT_PRIORITY;
+    if (interrupt_id >= GIC_SPI_BASE) {
+        gic_distributor->target[interrupt_id] = 0x01;
+    }
+    gic_distributor->set_enable[interrupt_id / 32] = 1u << (interrupt_id % 32);
+}
+
+void gic_disable_interrupt(uint32_t interrupt_id) {
+    if (interrupt_id >= GIC_MAX_INTERRUPTS) {
+        return;
+    }
+
+    gic_distributor->clear_enable[interrupt_id / 32] = 1u << (interrupt_id % 32);
+}
+
+uint32_t gic_acknowledge(void) {
+    return gic_cpu_interface->interrupt_acknowledge;
+}
+
+void gic_end_interrupt(uint32_t acknowledge) {
+    // Device acknowledgements must land before the GIC sees the end of interrupt
+    __sync_synchronize();
+    gic_cpu_interface->end_of_interrupt = acknowledge;
+}
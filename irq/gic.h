@@ -0,0 +1,94 @@
+#ifndef GIC_H
+#define GIC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// GICv2 on the QEMU virt board
+#define GIC_DISTRIBUTOR_BASE 0x08000000
+#define GIC_CPU_INTERFACE_BASE 0x08010000
+
+#define GIC_MAX_INTERRUPTS 1020
+#define GIC_SPURIOUS_INTERRUPT 1023
+#define GIC_SPI_BASE 32 // First shared peripheral interrupt ID
+
+#define GIC_DEFAULT_PRIORITY 0xA0
+#define GIC_LOWEST_PRIORITY_MASK 0xFF
+
+#define GIC_DISTRIBUTOR_ENABLE 0x1
+#define GIC_CPU_INTERFACE_ENABLE 0x1
+
+typedef volatile struct __attribute__((packed)) {
+    uint32_t control; // 0x000 - GICD_CTLR
+    uint32_t type; // 0x004 - GICD_TYPER
+    uint32_t implementer; // 0x008 - GICD_IIDR
+    uint32_t reserved_0[29]; // 0x00C - 0x07F
+    uint32_t group[32]; // 0x080 - GICD_IGROUPRn
+    uint32_t set_enable[32]; // 0x100 - GICD_ISENABLERn
+    uint32_t clear_enable[32]; // 0x180 - GICD_ICENABLERn
+    uint32_t set_pending[32]; // 0x200 - GICD_ISPENDRn
+    uint32_t clear_pending[32]; // 0x280 - GICD_ICPENDRn
+    uint32_t set_active[32]; // 0x300 - GICD_ISACTIVERn
+    uint32_t clear_active[32]; // 0x380 - GICD_ICACTIVERn
+    uint8_t priority[1020]; // 0x400 - 0x7FB - GICD_IPRIORITYRn (byte accessible)
+    uint32_t reserved_1; // 0x7FC
+    uint8_t target[1020]; // 0x800 - 0xBFB - GICD_ITARGETSRn (byte accessible)
+    uint32_t reserved_2; // 0xBFC
+    uint32_t configuration[64]; // 0xC00 - 0xCFF - GICD_ICFGRn
+} gic_distributor_registers;
+
+typedef volatile struct __attribute__((packed)) {
+    uint32_t control; // 0x000 - GICC_CTLR
+    uint32_t priority_mask; // 0x004 - GICC_PMR
+    uint32_t binary_point; // 0x008 - GICC_BPR
+    uint32_t interrupt_acknowledge; // 0x00C - GICC_IAR
+    uint32_t end_of_interrupt; // 0x010 - GICC_EOIR
+    uint32_t running_priority; // 0x014 - GICC_RPR
+    uint32_t highest_pending; // 0x018 - GICC_HPPIR
+} gic_cpu_interface_registers;
+
+
+/**
+ * @brief Initializes the GICv2 distributor and the CPU interface of the calling core.
+ *
+ * All shared interrupts start disabled; use gic_enable_interrupt() to route one.
+ */
+void gic_init(void);
+
+/**
+ * @brief Disables the distributor and the CPU interface.
+ *
+ * Used before handing the machine over to another program (e.g., the kernel).
+ */
+void gic_shutdown(void);
+
+/**
+ * @brief Enables an interrupt and routes it to CPU 0.
+ *
+ * @param interrupt_id The GIC interrupt ID (SPIs start at GIC_SPI_BASE).
+ */
+void gic_enable_interrupt(uint32_t interrupt_id);
+
+/**
+ * @brief Disables an interrupt at the distributor.
+ *
+ * @param interrupt_id The GIC interrupt ID.
+ */
+void gic_disable_interrupt(uint32_t interrupt_id);
+
+/**
+ * @brief Acknowledges the highest priority pending interrupt.
+ *
+ * @return The raw GICC_IAR value; the interrupt ID is in bits [9:0].
+ *         An ID of GIC_SPURIOUS_INTERRUPT means nothing was pending.
+ */
+uint32_t gic_acknowledge(void);
+
+/**
+ * @brief Signals the end of an interrupt returned by gic_acknowledge().
+ *
+ * @param acknowledge The raw value returned by gic_acknowledge().
+ */
+void gic_end_interrupt(uint32_t acknowledge);
+
+#endif
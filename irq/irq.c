@@ -0,0 +1,123 @@
+#include "irq.h"
+#include "gic.h"
+#include "../uart/uart.h"
+
+// Defined in vectors.s, 2 KB aligned as VBAR_EL1 requires
+extern char irq_vector_table[];
+
+typedef struct {
+    uint32_t interrupt_id;
+    irq_handler handler;
+    void* context;
+} irq_handler_entry;
+
+static irq_handler_entry irq_handlers[IRQ_MAX_HANDLERS];
+static bool irq_initialized = false;
+
+void irq_init(void) {
+    // Point the CPU at our vector table
+    asm volatile("msr vbar_el1, %0" :: "r"(irq_vector_table) : "memory");
+    asm volatile("isb");
+
+    for (int i = 0; i < IRQ_MAX_HANDLERS; i++) {
+        irq_handlers[i].handler = NULL;
+    }
+
+    gic_init();
+    irq_initialized = true;
+}
+
+bool irq_is_initialized(void) {
+    return irq_initialized;
+}
+
+int irq_register(uint32_t interrupt_id, irq_handler handler, void* context) {
+    if (!irq_initialized || handler == NULL) {
+        return -1; // Invalid parameters
+    }
+
+    for (int i = 0; i < IRQ_MAX_HANDLERS; i++) {
+        if (irq_handlers[i].handler == NULL || irq_handlers[i].interrupt_id == interrupt_id) {
+            irq_handlers[i].interrupt_id = interrupt_id;
+            irq_handlers[i].context = context;
+            irq_handlers[i].handler = handler;
+            gic_enable_interrupt(interrupt_id);
+            return 0;
+        }
+    }
+
+    return -1; // Handler table full
+}
+
+void irq_unregister(uint32_t interrupt_id) {
+    if (!irq_initialized) {
+        return;
+    }
+
+    gic_disable_interrupt(interrupt_id);
+    for (int i = 0; i < IRQ_MAX_HANDLERS; i++) {
+        if (irq_handlers[i].handler != NULL && irq_handlers[i].interrupt_id == interrupt_id) {
+            irq_handlers[i].handler = NULL;
+        }
+    }
+}
+
+void irq_shutdown(void) {
+    irq_disable();
+    if (irq_initialized) {
+        gic_shutdown();
+        irq_initialized = false;
+    }
+}
+
+void irq_wait(void) {
+    // Sleep until an interrupt is pending, then open a window for the handler
+    asm volatile("wfi" ::: "memory");
+    asm volatile("msr daifclr, #2\n\tisb\n\tmsr daifset, #2" ::: "memory");
+}
+
+// Acknowledge the pending interrupt and run its handler
+static void irq_dispatch(void) {
+    uint32_t acknowledge = gic_acknowledge();
+    uint32_t interrupt_id = acknowledge & 0x3FF;
+
+    if (interrupt_id >= GIC_MAX_INTERRUPTS) {
+        return; // Spurious, nothing to end
+    }
+
+    for (int i = 0; i < IRQ_MAX_HANDLERS; i++) {
+        if (irq_handlers[i].handler != NULL && irq_handlers[i].interrupt_id == interrupt_id) {
+            irq_handlers[i].handler(irq_handlers[i].context);
+            break;
+        }
+    }
+
+    gic_end_interrupt(acknowledge);
+}
+
+void irq_handle_exception(uint64_t type, irq_exception_frame* frame) {
+    if (type == IRQ_VECTOR_CURRENT_SPX_IRQ || type == IRQ_VECTOR_CURRENT_SP0_IRQ) {
+        irq_dispatch();
+        return;
+    }
+
+    // Anything else is a fault we cannot recover from
+    uint64_t esr;
+    uint64_t far;
+    asm volatile("mrs %0, esr_el1" : "=r"(esr));
+    asm volatile("mrs %0, far_el1" : "=r"(far));
+
+    uart_puts("\n\rFATAL: Unhandled exception, vector ");
+    uart_print_dec((uint32_t)type);
+    uart_puts("\n\r    ESR: 0x");
+    uart_print_hex(esr);
+    uart_puts("\n\r    ELR: 0x");
+    uart_print_hex(frame->elr);
+    uart_puts("\n\r    FAR: 0x");
+    uart_print_hex(far);
+    uart_puts("\n\rSYSTEM HALTED\n\r");
+
+    while (1) {
+        asm volatile("wfe");
+    }
+}
@@ -0,0 +1,119 @@
+#ifndef IRQ_H
+#define IRQ_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Exception vector indices (offset in the vector table / 0x80)
+#define IRQ_VECTOR_CURRENT_SP0_SYNC 0
+#define IRQ_VECTOR_CURRENT_SP0_IRQ 1
+#define IRQ_VECTOR_CURRENT_SP0_FIQ 2
+#define IRQ_VECTOR_CURRENT_SP0_SERROR 3
+#define IRQ_VECTOR_CURRENT_SPX_SYNC 4
+#define IRQ_VECTOR_CURRENT_SPX_IRQ 5
+#define IRQ_VECTOR_CURRENT_SPX_FIQ 6
+#define IRQ_VECTOR_CURRENT_SPX_SERROR 7
+#define IRQ_VECTOR_LOWER_A64_SYNC 8
+#define IRQ_VECTOR_LOWER_A64_IRQ 9
+#define IRQ_VECTOR_LOWER_A64_FIQ 10
+#define IRQ_VECTOR_LOWER_A64_SERROR 11
+#define IRQ_VECTOR_LOWER_A32_SYNC 12
+#define IRQ_VECTOR_LOWER_A32_IRQ 13
+#define IRQ_VECTOR_LOWER_A32_FIQ 14
+#define IRQ_VECTOR_LOWER_A32_SERROR 15
+
+#define IRQ_MAX_HANDLERS 8
+
+// Register state saved by vectors.s on exception entry
+typedef struct {
+    uint64_t x[31]; // x0 - x30
+    uint64_t elr; // ELR_EL1: address the exception returns to
+    uint64_t spsr; // SPSR_EL1: saved processor state
+    uint64_t padding; // Keeps the frame 16-byte aligned
+} irq_exception_frame;
+
+// Interrupt handlers run with IRQs masked and must not use FP/SIMD registers,
+// since the vector entry only saves the general purpose registers
+typedef void (*irq_handler)(void* context);
+
+/**
+ * @brief Installs the exception vector table and initializes the GIC.
+ *
+ * IRQs stay masked at the CPU afterwards; drivers unmask them only while
+ * waiting (see irq_wait()), or the caller can use irq_enable().
+ */
+void irq_init(void);
+
+/**
+ * @brief Checks whether irq_init() has been called.
+ *
+ * @return true if interrupts can be registered, false otherwise.
+ */
+bool irq_is_initialized(void);
+
+/**
+ * @brief Registers a handler for a GIC interrupt and enables that interrupt.
+ *
+ * @param interrupt_id The GIC interrupt ID.
+ * @param handler Function called from the IRQ vector when the interrupt fires.
+ * @param context Pointer passed to the handler unchanged.
+ * @return 0 on success, negative value on error (e.g., not initialized, table full).
+ */
+int irq_register(uint32_t interrupt_id, irq_handler handler, void* context);
+
+/**
+ * @brief Disables a GIC interrupt and removes its handler.
+ *
+ * @param interrupt_id The GIC interrupt ID.
+ */
+void irq_unregister(uint32_t interrupt_id);
+
+/**
+ * @brief Masks IRQs and disables the GIC before handing control to another program.
+ */
+void irq_shutdown(void);
+
+/**
+ * @brief Sleeps until an interrupt is pending, then lets its handler run.
+ *
+ * Must be called with IRQs masked (see irq_save()). WFI still wakes on a masked
+ * pending interrupt, so a completion that arrives between the caller's check and
+ * the WFI is not lost. IRQs are briefly unmasked for the handler and masked again
+ * before returning.
+ */
+void irq_wait(void);
+
+/**
+ * @brief Called from vectors.s for every exception taken to EL1.
+ *
+ * IRQs are dispatched to registered handlers; any other exception is reported
+ * over the UART and halts the system.
+ *
+ * @param type The vector index (IRQ_VECTOR_*).
+ * @param frame Registers saved on exception entry.
+ */
+void irq_handle_exception(uint64_t type, irq_exception_frame* frame);
+
+// Masks IRQs and returns the previous DAIF state for irq_restore()
+static inline uint64_t irq_save(void) {
+    uint64_t daif;
+    asm volatile("mrs %0, daif" : "=r"(daif));
+    asm volatile("msr daifset, #2" ::: "memory");
+    return daif;
+}
+
+// Restores the DAIF state returned by irq_save()
+static inline void irq_restore(uint64_t daif) {
+    asm volatile("msr daif, %0" :: "r"(daif) : "memory");
+}
+
+static inline void irq_enable(void) {
+    asm volatile("msr daifclr, #2" ::: "memory");
+}
+
+static inline void irq_disable(void) {
+    asm volatile("msr daifset, #2" ::: "memory");
+}
+
+#endif
@@ -0,0 +1,94 @@
+/*
+ * vectors.s - AArch64 EL1 exception vector table
+ *
+ * Every entry saves the general purpose registers, ELR_EL1 and SPSR_EL1 into an
+ * irq_exception_frame on the current stack, then calls
+ * irq_handle_exception(type, frame) in irq.c, where type is the vector index.
+ * FP/SIMD registers are not saved, so handlers must not use them.
+ */
+
+.equ EXCEPTION_FRAME_SIZE, 272  // 31 registers + ELR + SPSR + padding (16-byte aligned)
+
+// Each vector slot is 0x80 bytes; keep the entry short and branch to the common code
+.macro VECTOR_ENTRY type
+    .balign 0x80
+    sub sp, sp, #EXCEPTION_FRAME_SIZE
+    stp x0, x1, [sp, #16 * 0]
+    mov x0, #\type
+    b exception_entry
+.endm
+
+.section ".text.vectors", "ax"
+.global irq_vector_table
+
+// VBAR_EL1 requires 2 KB alignment
+.balign 0x800
+irq_vector_table:
+    // Current EL with SP_EL0
+    VECTOR_ENTRY 0
+    VECTOR_ENTRY 1
+    VECTOR_ENTRY 2
+    VECTOR_ENTRY 3
+    // Current EL with SP_ELx
+    VECTOR_ENTRY 4
+    VECTOR_ENTRY 5
+    VECTOR_ENTRY 6
+    VECTOR_ENTRY 7
+    // Lower EL using AArch64
+    VECTOR_ENTRY 8
+    VECTOR_ENTRY 9
+    VECTOR_ENTRY 10
+    VECTOR_ENTRY 11
+    // Lower EL using AArch32
+    VECTOR_ENTRY 12
+    VECTOR_ENTRY 13
+    VECTOR_ENTRY 14
+    VECTOR_ENTRY 15
+
+exception_entry:
+    // x0 holds the vector type, x0/x1 are already saved
+    stp x2, x3, [sp, #16 * 1]
+    stp x4, x5, [sp, #16 * 2]
+    stp x6, x7, [sp, #16 * 3]
+    stp x8, x9, [sp, #16 * 4]
+    stp x10, x11, [sp, #16 * 5]
+    stp x12, x13, [sp, #16 * 6]
+    stp x14, x15, [sp, #16 * 7]
+    stp x16, x17, [sp, #16 * 8]
+    stp x18, x19, [sp, #16 * 9]
+    stp x20, x21, [sp, #16 * 10]
+    stp x22, x23, [sp, #16 * 11]
+    stp x24, x25, [sp, #16 * 12]
+    stp x26, x27, [sp, #16 * 13]
+    stp x28, x29, [sp, #16 * 14]
+    mrs x1, elr_el1
+    mrs x2, spsr_el1
+    stp x30, x1, [sp, #16 * 15]
+    str x2, [sp, #16 * 16]
+
+    // irq_handle_exception(type, frame)
+    mov x1, sp
+    bl irq_handle_exception
+
+    // Restore state (the handler may have changed ELR/SPSR in the frame)
+    ldp x30, x1, [sp, #16 * 15]
+    ldr x2, [sp, #16 * 16]
+    msr elr_el1, x1
+    msr spsr_el1, x2
+    ldp x0, x1, [sp, #16 * 0]
+    ldp x2, x3, [sp, #16 * 1]
+    ldp x4, x5, [sp, #16 * 2]
+    ldp x6, x7, [sp, #16 * 3]
+    ldp x8, x9, [sp, #16 * 4]
+    ldp x10, x11, [sp, #16 * 5]
+    ldp x12, x13, [sp, #16 * 6]
+    ldp x14, x15, [sp, #16 * 7]
+    ldp x16, x17, [sp, #16 * 8]
+    ldp x18, x19, [sp, #16 * 9]
+    ldp x20, x21, [sp, #16 * 10]
+    ldp x22, x23, [sp, #16 * 11]
+    ldp x24, x25, [sp, #16 * 12]
+    ldp x26, x27, [sp, #16 * 13]
+    ldp x28, x29, [sp, #16 * 14]
+    add sp, sp, #EXCEPTION_FRAME_SIZE
+    eret
@@ -0,0 +1,211 @@
+/*
+ * memory.s - memcpy, memset and memcmp for AArch64 (see string.h)
+ *
+ * Every routine first checks SCTLR_EL1.M. With the MMU on, memory is Normal and
+ * the block loops run from any alignment. With the MMU off every access is a
+ * Device access that must be naturally aligned, so the head is done byte by
+ * byte until the address is 16-byte aligned (or everything is done by bytes
+ * when the buffers can never line up), and the tails step down 8/4/2/1 bytes
+ * so each access stays aligned.
+ */
+
+.section ".text"
+.global memcpy
+.global memset
+.global memcmp
+
+// x0 = destination, x1 = source, x2 = length; returns destination
+memcpy:
+    mov x3, x0
+    mrs x5, sctlr_el1
+    tbnz x5, #0, .Lcopy_blocks          // MMU on: any alignment is fine
+    eor x5, x0, x1
+    tst x5, #15
+    b.ne .Lcopy_bytes                   // Buffers never line up: bytes only
+
+.Lcopy_align:
+    tst x3, #15
+    b.eq .Lcopy_blocks
+    cbz x2, .Lcopy_done
+    ldrb w4, [x1], #1
+    strb w4, [x3], #1
+    sub x2, x2, #1
+    b .Lcopy_align
+
+.Lcopy_blocks:
+    cmp x2, #64
+    b.lo .Lcopy_16
+.Lcopy_64:
+    ldp q0, q1, [x1], #32
+    ldp q2, q3, [x1], #32
+    sub x2, x2, #64
+    stp q0, q1, [x3], #32
+    stp q2, q3, [x3], #32
+    cmp x2, #64
+    b.hs .Lcopy_64
+.Lcopy_16:
+    cmp x2, #16
+    b.lo .Lcopy_tail
+    ldr q0, [x1], #16
+    str q0, [x3], #16
+    sub x2, x2, #16
+    b .Lcopy_16
+.Lcopy_tail:
+    tbz x2, #3, 1f
+    ldr x4, [x1], #8
+    str x4, [x3], #8
+1:
+    tbz x2, #2, 2f
+    ldr w4, [x1], #4
+    str w4, [x3], #4
+2:
+    tbz x2, #1, 3f
+    ldrh w4, [x1], #2
+    strh w4, [x3], #2
+3:
+    tbz x2, #0, .Lcopy_done
+    ldrb w4, [x1]
+    strb w4, [x3]
+.Lcopy_done:
+    ret
+
+.Lcopy_bytes:
+    cbz x2, .Lcopy_done
+    ldrb w4, [x1], #1
+    strb w4, [x3], #1
+    sub x2, x2, #1
+    b .Lcopy_bytes
+
+// x0 = destination, w1 = value, x2 = length; returns destination
+memset:
+    mov x3, x0
+    and x1, x1, #0xFF
+    mov x4, #0x0101010101010101
+    mul x4, x4, x1                      // Value in every byte
+    dup v0.2d, x4
+    mrs x5, sctlr_el1
+    tbz x5, #0, .Lset_align             // MMU off: align first
+
+    // Large zero fills clear whole cache blocks with DC ZVA, unless prohibited
+    cbnz x4, .Lset_blocks
+    mrs x6, dczid_el0
+    tbnz x6, #4, .Lset_blocks           // DZP: DC ZVA not allowed
+    and x6, x6, #15
+    mov x7, #4
+    lsl x7, x7, x6                      // Block size in bytes
+    cmp x2, x7, lsl #2
+    b.lo .Lset_blocks                   // Too short to be worth aligning
+    sub x8, x7, #1
+
+    // Unaligned head: one 16-byte store, then 16-byte steps to the block boundary
+    str q0, [x3]
+    add x9, x3, #16
+    and x9, x9, #0xFFFFFFFFFFFFFFF0
+    sub x10, x9, x3
+    sub x2, x2, x10
+    mov x3, x9
+.Lset_zva_head:
+    tst x3, x8
+    b.eq .Lset_zva
+    str q0, [x3], #16
+    sub x2, x2, #16
+    b .Lset_zva_head
+.Lset_zva:
+    dc zva, x3
+    add x3, x3, x7
+    sub x2, x2, x7
+    cmp x2, x7
+    b.hs .Lset_zva
+    b .Lset_blocks
+
+.Lset_align:
+    tst x3, #15
+    b.eq .Lset_blocks
+    cbz x2, .Lset_done
+    strb w4, [x3], #1
+    sub x2, x2, #1
+    b .Lset_align
+
+.Lset_blocks:
+    cmp x2, #64
+    b.lo .Lset_16
+.Lset_64:
+    stp q0, q0, [x3], #32
+    stp q0, q0, [x3], #32
+    sub x2, x2, #64
+    cmp x2, #64
+    b.hs .Lset_64
+.Lset_16:
+    cmp x2, #16
+    b.lo .Lset_tail
+    str q0, [x3], #16
+    sub x2, x2, #16
+    b .Lset_16
+.Lset_tail:
+    tbz x2, #3, 1f
+    str x4, [x3], #8
+1:
+    tbz x2, #2, 2f
+    str w4, [x3], #4
+2:
+    tbz x2, #1, 3f
+    strh w4, [x3], #2
+3:
+    tbz x2, #0, .Lset_done
+    strb w4, [x3]
+.Lset_done:
+    ret
+
+// x0 = a, x1 = b, x2 = length; returns <0, 0 or >0
+memcmp:
+    mrs x5, sctlr_el1
+    tbnz x5, #0, .Lcompare_16           // MMU on: any alignment is fine
+    orr x5, x0, x1
+    tst x5, #7
+    b.ne .Lcompare_bytes                // Device memory needs aligned words
+
+.Lcompare_16:
+    cmp x2, #16
+    b.lo .Lcompare_8
+    ldp x3, x6, [x0], #16
+    ldp x4, x7, [x1], #16
+    sub x2, x2, #16
+    cmp x3, x4
+    b.ne .Lcompare_differ
+    mov x3, x6
+    mov x4, x7
+    cmp x3, x4
+    b.ne .Lcompare_differ
+    b .Lcompare_16
+.Lcompare_8:
+    cmp x2, #8
+    b.lo .Lcompare_bytes
+    ldr x3, [x0], #8
+    ldr x4, [x1], #8
+    sub x2, x2, #8
+    cmp x3, x4
+    b.ne .Lcompare_differ
+
+.Lcompare_bytes:
+    cbz x2, .Lcompare_equal
+    ldrb w3, [x0], #1
+    ldrb w4, [x1], #1
+    subs w3, w3, w4
+    b.ne .Lcompare_byte_differ
+    sub x2, x2, #1
+    b .Lcompare_bytes
+
+.Lcompare_differ:
+    // Words are little-endian; byte-reversed, the first differing byte decides
+    rev x3, x3
+    rev x4, x4
+    cmp x3, x4
+    mov w0, #1
+    cneg w0, w0, lo
+    ret
+.Lcompare_byte_differ:
+    mov w0, w3
+    ret
+.Lcompare_equal:
+    mov w0, #0
+    ret
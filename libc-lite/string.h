@@ -0,0 +1,58 @@
+#ifndef LIBC_LITE_STRING_H
+#define LIBC_LITE_STRING_H
+
+#include <stddef.h>
+
+// Freestanding replacements for the <string.h> routines every module needs.
+// The compiler also emits calls to memcpy() and memset() on its own (struct
+// copies, zeroed locals), so every image that links C code links this library.
+//
+// With the MMU on, memory is Normal and accesses may be unaligned, so copies run
+// in 64-byte blocks of SIMD loads/stores from any address. With the MMU off all
+// memory is Device memory and faults on unaligned accesses; the routines then
+// only use wide accesses on naturally aligned addresses. Both cases need
+// CPACR_EL1.FPEN enabled, which every start.s does before calling into C.
+
+/**
+ * @brief Copies bytes between non-overlapping buffers.
+ *
+ * @param destination Receives length bytes.
+ * @param source Holds length bytes; must not overlap destination.
+ * @param length Number of bytes to copy.
+ * @return destination.
+ */
+void* memcpy(void* destination, const void* source, size_t length);
+
+/**
+ * @brief Fills bytes with a value.
+ *
+ * Large zero fills with the MMU on use DC ZVA, which clears a whole cache block
+ * (usually 64 bytes) without reading it first.
+ *
+ * @param destination First byte to fill.
+ * @param value Fill byte (converted to uint8_t).
+ * @param length Number of bytes to fill.
+ * @return destination.
+ */
+void* memset(void* destination, int value, size_t length);
+
+/**
+ * @brief Compares bytes as unsigned values.
+ *
+ * @param a First buffer.
+ * @param b Second buffer.
+ * @param length Number of bytes to compare.
+ * @return 0 if equal, otherwise negative or positive as the first differing byte
+ *         of a is lower or higher than the one of b.
+ */
+int memcmp(const void* a, const void* b, size_t length);
+
+/**
+ * @brief Counts the characters of a null-terminated string.
+ *
+ * @param string The string.
+ * @return Length of the string, not counting the terminator.
+ */
+size_t strlen(const char* string);
+
+#endif
@@ -0,0 +1,252 @@
+#include "mmu.h"
+
+// Translation table descriptor bits
+#define MMU_DESCRIPTOR_BLOCK 0x1ull // Valid block entry (levels 1 and 2)
+#define MMU_DESCRIPTOR_TABLE 0x3ull // Valid next-level table entry (levels 1 and 2)
+#define MMU_DESCRIPTOR_PAGE 0x3ull // Valid page entry (level 3)
+#define MMU_DESCRIPTOR_ATTR(index) ((uint64_t)(index) << 2)
+#define MMU_DESCRIPTOR_INNER_SHAREABLE (3ull << 8)
+#define MMU_DESCRIPTOR_ACCESS_FLAG (1ull << 10)
+#define MMU_DESCRIPTOR_PXN (1ull << 53)
+#define MMU_DESCRIPTOR_UXN (1ull << 54)
+
+// Attributes of every RAM mapping, cached or not
+#define MMU_DESCRIPTOR_RAM(index) (MMU_DESCRIPTOR_ATTR(index) | MMU_DESCRIPTOR_INNER_SHAREABLE | \
+    MMU_DESCRIPTOR_ACCESS_FLAG)
+
+#define MMU_TABLE_ENTRIES 512
+
+// MAIR_EL1 attribute encodings
+#define MMU_MAIR_DEVICE_NGNRE 0x04ull
+#define MMU_MAIR_NORMAL_WB 0xFFull
+#define MMU_MAIR_NORMAL_NC 0x44ull
+
+// TCR_EL1 fields for TTBR0 only: 39-bit addresses, 4 KB granule, walks cached
+// write-back and inner shareable like the memory they describe
+#define MMU_TCR_T0SZ (64 - 39)
+#define MMU_TCR_IRGN0_WB (1ull << 8)
+#define MMU_TCR_ORGN0_WB (1ull << 10)
+#define MMU_TCR_SH0_INNER (3ull << 12)
+#define MMU_TCR_EPD1 (1ull << 23) // No walks through TTBR1
+#define MMU_TCR_TG1_4K (2ull << 30)
+#define MMU_TCR_IPS_SHIFT 32
+
+static uint64_t mmu_level1_table[MMU_TABLE_ENTRIES] __attribute__((aligned(4096)));
+
+// The gigabyte holding .bss.uncached is split into 2 MB blocks, and the (at
+// most two) blocks the section touches into pages
+#define MMU_UNCACHED_TABLES 2
+static uint64_t mmu_level2_table[MMU_TABLE_ENTRIES] __attribute__((aligned(4096)));
+static uint64_t mmu_level3_tables[MMU_UNCACHED_TABLES][MMU_TABLE_ENTRIES] __attribute__((aligned(4096)));
+
+// Defined by the linker script
+extern uint8_t __uncached_start[];
+extern uint8_t __uncached_end[];
+
+// Written by the boot core before its caches come on, so secondary cores can
+// read them with theirs still off
+static volatile bool mmu_enabled = false;
+static uint64_t mmu_tcr;
+
+// Helper functions
+
+static inline size_t dcache_line_size(void) {
+    uint64_t ctr;
+    asm volatile("mrs %0, ctr_el0" : "=r"(ctr));
+    return (size_t)4 << ((ctr >> 16) & 0xF); // DminLine is log2 of the line size in words
+}
+
+// Map the pages of .bss.uncached Normal Non-cacheable; the rest of their
+// gigabyte keeps the write-back attributes of the level-1 block it replaces
+static void map_uncached(void) {
+    uint64_t start = (uint64_t)__uncached_start;
+    uint64_t end = (uint64_t)__uncached_end;
+    if (start == end) {
+        return;
+    }
+
+    uint64_t gigabyte = start & ~(MMU_BLOCK_SIZE - 1);
+    for (uint64_t i = 0; i < MMU_TABLE_ENTRIES; i++) {
+        mmu_level2_table[i] = (gigabyte + i * MMU_SECTION_SIZE) | MMU_DESCRIPTOR_BLOCK |
+            MMU_DESCRIPTOR_RAM(MMU_ATTR_NORMAL);
+    }
+
+    uint32_t tables = 0;
+    for (uint64_t section = start & ~(MMU_SECTION_SIZE - 1); section < end; section += MMU_SECTION_SIZE) {
+        uint64_t* table = mmu_level3_tables[tables++];
+        for (uint64_t i = 0; i < MMU_TABLE_ENTRIES; i++) {
+            uint64_t address = section + i * MMU_PAGE_SIZE;
+            uint32_t attribute = address >= start && address < end ? MMU_ATTR_NORMAL_NC : MMU_ATTR_NORMAL;
+            table[i] = address | MMU_DESCRIPTOR_PAGE | MMU_DESCRIPTOR_RAM(attribute);
+        }
+        mmu_level2_table[(section - gigabyte) / MMU_SECTION_SIZE] = (uint64_t)table | MMU_DESCRIPTOR_TABLE;
+    }
+
+    mmu_level1_table[gigabyte / MMU_BLOCK_SIZE] = (uint64_t)mmu_level2_table | MMU_DESCRIPTOR_TABLE;
+}
+
+// Load the translation registers and switch the MMU and caches on for this core
+static void enable_translation(void) {
+    uint64_t mair = (MMU_MAIR_DEVICE_NGNRE << (8 * MMU_ATTR_DEVICE)) | (MMU_MAIR_NORMAL_WB << (8 * MMU_ATTR_NORMAL)) |
+        (MMU_MAIR_NORMAL_NC << (8 * MMU_ATTR_NORMAL_NC));
+    asm volatile("msr mair_el1, %0" : : "r"(mair));
+    asm volatile("msr tcr_el1, %0" : : "r"(mmu_tcr));
+    asm volatile("msr ttbr0_el1, %0" : : "r"((uint64_t)mmu_level1_table));
+    asm volatile("isb");
+
+    // Nothing from before may linger in the TLB or the instruction cache
+    asm volatile("tlbi vmalle1\n dsb nsh\n ic iallu\n dsb nsh\n isb" : : : "memory");
+
+    uint64_t sctlr;
+    asm volatile("mrs %0, sctlr_el1" : "=r"(sctlr));
+    sctlr |= MMU_SCTLR_M | MMU_SCTLR_C | MMU_SCTLR_I;
+    asm volatile("msr sctlr_el1, %0\n isb" : : "r"(sctlr) : "memory");
+}
+
+// Library functions
+
+void mmu_init(void) {
+    if (mmu_enabled) {
+        return;
+    }
+
+    // Devices in the first gigabyte: strongly ordered enough for MMIO, never
+    // fetched from, even speculatively
+    mmu_level1_table[MMU_DEVICE_BASE / MMU_BLOCK_SIZE] = MMU_DEVICE_BASE | MMU_DESCRIPTOR_BLOCK |
+        MMU_DESCRIPTOR_ATTR(MMU_ATTR_DEVICE) | MMU_DESCRIPTOR_ACCESS_FLAG |
+        MMU_DESCRIPTOR_PXN | MMU_DESCRIPTOR_UXN;
+
+    for (uint64_t block = 0; block < MMU_RAM_BLOCKS; block++) {
+        uint64_t address = MMU_RAM_BASE + block * MMU_BLOCK_SIZE;
+        mmu_level1_table[address / MMU_BLOCK_SIZE] = address | MMU_DESCRIPTOR_BLOCK |
+            MMU_DESCRIPTOR_RAM(MMU_ATTR_NORMAL);
+    }
+    map_uncached();
+
+    // Output addresses as wide as the core supports, up to 48 bits (4 KB granule)
+    uint64_t mmfr0;
+    asm volatile("mrs %0, id_aa64mmfr0_el1" : "=r"(mmfr0));
+    uint64_t parange = mmfr0 & 0xF;
+    if (parange > 5) {
+        parange = 5;
+    }
+
+    mmu_tcr = MMU_TCR_T0SZ | MMU_TCR_IRGN0_WB | MMU_TCR_ORGN0_WB | MMU_TCR_SH0_INNER |
+        MMU_TCR_EPD1 | MMU_TCR_TG1_4K | (parange << MMU_TCR_IPS_SHIFT);
+    mmu_enabled = true;
+    asm volatile("dsb sy" : : : "memory");
+
+    enable_translation();
+}
+
+void mmu_init_secondary(void) {
+    if (!mmu_enabled) {
+        return; // The boot core runs uncached, so this core must too
+    }
+    enable_translation();
+}
+
+bool mmu_is_enabled(void) {
+    return mmu_enabled;
+}
+
+void mmu_disable(void) {
+    if (!mmu_enabled) {
+        return;
+    }
+
+    // Caches go off first, then every level is cleaned and invalidated by
+    // set/way. Nothing in between may touch memory: a store made uncached
+    // would be overwritten when its stale dirty line is written back.
+    asm volatile(
+        "mrs x0, sctlr_el1\n"
+        "mov x1, #0x1005\n" // M | C | I
+        "bic x0, x0, x1\n"
+        "msr sctlr_el1, x0\n"
+        "isb\n"
+
+        "mrs x0, clidr_el1\n"
+        "ubfx x3, x0, #24, #3\n" // Level of coherency
+        "lsl x3, x3, #1\n"
+        "cbz x3, 5f\n"
+        "mov x10, #0\n" // Cache level << 1, as CSSELR wants it
+        "1:\n"
+        "add x2, x10, x10, lsr #1\n"
+        "lsr x1, x0, x2\n"
+        "and x1, x1, #7\n" // Cache type at this level
+        "cmp x1, #2\n"
+        "b.lt 4f\n" // No data cache
+        "msr csselr_el1, x10\n"
+        "isb\n"
+        "mrs x1, ccsidr_el1\n"
+        "and x2, x1, #7\n"
+        "add x2, x2, #4\n" // log2 of the line size
+        "ubfx x4, x1, #3, #10\n" // Highest way
+        "clz w5, w4\n" // Way field position
+        "ubfx x7, x1, #13, #15\n" // Highest set
+        "2:\n"
+        "mov x9, x4\n"
+        "3:\n"
+        "lsl x6, x9, x5\n"
+        "orr x11, x10, x6\n"
+        "lsl x6, x7, x2\n"
+        "orr x11, x11, x6\n"
+        "dc cisw, x11\n"
+        "subs x9, x9, #1\n"
+        "b.ge 3b\n"
+        "subs x7, x7, #1\n"
+        "b.ge 2b\n"
+        "4:\n"
+        "add x10, x10, #2\n"
+        "cmp x3, x10\n"
+        "b.gt 1b\n"
+        "5:\n"
+        "msr csselr_el1, xzr\n"
+        "dsb sy\n"
+
+        // The next stage brings its own code and tables
+        "ic iallu\n"
+        "tlbi vmalle1\n"
+        "dsb sy\n"
+        "isb\n"
+        :
+        :
+        : "x0", "x1", "x2", "x3", "x4", "x5", "x6", "x7", "x9", "x10", "x11", "memory");
+
+    mmu_enabled = false;
+}
+
+void mmu_clean_range(const void* start, size_t length) {
+    if (length == 0) {
+        return;
+    }
+
+    size_t line = dcache_line_size();
+    uint64_t end = (uint64_t)start + length;
+    for (uint64_t address = (uint64_t)start & ~(uint64_t)(line - 1); address < end; address += line) {
+        asm volatile("dc cvac, %0" : : "r"(address) : "memory");
+    }
+    asm volatile("dsb sy" : : : "memory");
+}
+
+void mmu_clean_invalidate_range(const void* start, size_t length) {
+    if (length == 0) {
+        return;
+    }
+
+    size_t line = dcache_line_size();
+    uint64_t end = (uint64_t)start + length;
+    for (uint64_t address = (uint64_t)start & ~(uint64_t)(line - 1); address < end; address += line) {
+        asm volatile("dc civac, %0" : : "r"(address) : "memory");
+    }
+    asm volatile("dsb sy" : : : "memory");
+}
+
+void mmu_sync_icache(const void* start, size_t length) {
+    size_t line = dcache_line_size();
+    uint64_t end = (uint64_t)start + length;
+    for (uint64_t address = (uint64_t)start & ~(uint64_t)(line - 1); address < end; address += line) {
+        asm volatile("dc cvau, %0" : : "r"(address) : "memory");
+    }
+    asm volatile("dsb ish\n ic iallu\n dsb ish\n isb" : : : "memory");
+}
@@ -0,0 +1,111 @@
+#ifndef MMU_H
+#define MMU_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Identity map for the QEMU virt machine, 4 KB granule, 39-bit addresses:
+// one level-1 table of 1 GB blocks. The first gigabyte (flash, GIC, UART,
+// virtio-mmio) is Device-nGnRE and never executable; RAM from 0x40000000 is
+// Normal write-back memory, except for the pages of the .bss.uncached section
+// (see MMU_UNCACHED), which are Normal Non-cacheable. Everything else is unmapped.
+
+#define MMU_BLOCK_SIZE (1ull << 30)
+#define MMU_SECTION_SIZE (1ull << 21) // Level-2 block
+#define MMU_PAGE_SIZE 4096
+#define MMU_DEVICE_BASE 0x00000000ull
+#define MMU_RAM_BASE 0x40000000ull
+
+// Gigabytes of RAM mapped from MMU_RAM_BASE
+#ifndef MMU_RAM_BLOCKS
+#define MMU_RAM_BLOCKS 1
+#endif
+
+// MAIR_EL1 attribute indices
+#define MMU_ATTR_DEVICE 0 // Device-nGnRE
+#define MMU_ATTR_NORMAL 1 // Normal, inner/outer write-back, read/write-allocate
+#define MMU_ATTR_NORMAL_NC 2 // Normal, inner/outer non-cacheable
+
+// Places a zero-initialized variable in the .bss.uncached section, for memory
+// that the CPU and a device without cache coherency both write, down to the
+// same cache line (e.g. virtqueue rings). Loads and stores go straight to
+// memory, so only barriers are needed, no cache maintenance. The linker script
+// gathers the section page-aligned into [__uncached_start, __uncached_end) at
+// the start of .bss, at most MMU_SECTION_SIZE bytes.
+#define MMU_UNCACHED __attribute__((section(".bss.uncached"), aligned(MMU_PAGE_SIZE)))
+
+// SCTLR_EL1 bits
+#define MMU_SCTLR_M (1u << 0) // MMU
+#define MMU_SCTLR_C (1u << 2) // Data and unified caches
+#define MMU_SCTLR_I (1u << 12) // Instruction cache
+
+/**
+ * @brief Builds the identity map and turns on the MMU and the caches.
+ *
+ * Must run on the boot core with the MMU off, before anything else touches
+ * memory that a later mmu_disable() or DMA relies on being uncached. Code keeps
+ * running at the same addresses.
+ */
+void mmu_init(void);
+
+/**
+ * @brief Turns on the MMU and caches of a secondary core with the boot core's tables.
+ *
+ * Called by smp_entry.s before the core touches shared memory. Does nothing
+ * if mmu_init() has not been called on the boot core.
+ */
+void mmu_init_secondary(void);
+
+/**
+ * @brief Checks whether mmu_init() has turned the MMU on.
+ *
+ * @return true if the MMU and caches are on, false otherwise.
+ */
+bool mmu_is_enabled(void);
+
+/**
+ * @brief Turns the MMU and caches off and writes every dirty line to memory.
+ *
+ * Leaves the core the way the arm64 boot protocol expects for the next stage:
+ * MMU and data cache off, memory up to date, instruction cache invalidated.
+ * Does nothing if the MMU is off.
+ */
+void mmu_disable(void);
+
+/**
+ * @brief Writes cached data for a range back to memory (clean to the point of coherency).
+ *
+ * Use before a device reads the range (e.g., a DMA write to disk) or before
+ * another agent reads it with its caches off.
+ *
+ * @param start First byte of the range.
+ * @param length Length of the range in bytes.
+ */
+void mmu_clean_range(const void* start, size_t length);
+
+/**
+ * @brief Writes back and then drops cached data for a range.
+ *
+ * Use before and after a device writes the range (e.g., a DMA read from disk),
+ * so no dirty line is evicted over the new data and no stale line is read.
+ * Lines sharing the range's first or last cache line are written back too,
+ * never discarded.
+ *
+ * @param start First byte of the range.
+ * @param length Length of the range in bytes.
+ */
+void mmu_clean_invalidate_range(const void* start, size_t length);
+
+/**
+ * @brief Makes code written to memory visible to instruction fetch.
+ *
+ * Cleans the range to the point of unification and invalidates the whole
+ * instruction cache, e.g. after loading a kernel image.
+ *
+ * @param start First byte of the code.
+ * @param length Length of the code in bytes.
+ */
+void mmu_sync_icache(const void* start, size_t length);
+
+#endif
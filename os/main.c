@@ -1,8 +1,33 @@
 #include "../uart/uart.h"
+#include "../irq/irq.h"
+#include "../mmu/mmu.h"
+#include "../timer/timer.h"
+
+// The bootloader's timeline, continued through the kernel's own start-up
+static timer_timeline timeline;
+
+// x0 at entry is the bootloader's timeline, or whatever else started us put
+// there (QEMU's -kernel passes a device tree address); only read it if it lies
+// in mapped RAM
+static const timer_timeline* boot_timeline(uint64_t address) {
+    uint64_t ram_end = MMU_RAM_BASE + MMU_RAM_BLOCKS * MMU_BLOCK_SIZE;
+    if (address < MMU_RAM_BASE || address > ram_end - sizeof(timer_timeline) || address % 8 != 0) {
+        return NULL;
+    }
+    return (const timer_timeline*)address;
+}
+
+void main(uint64_t boot_argument) {
+    timer_timeline_adopt(&timeline, boot_timeline(boot_argument));
+    timer_mark(&timeline, "os init", 0, 0); // Ends the bootloader's handoff phase
 
-void main(void) {
     uart_init(); // literally does nothing because qemu pre-initializes it, but have this line for good practice
+    irq_init(); // install our own exception vectors so faults get reported instead of jumping into the bootloader's
+    timer_mark(&timeline, NULL, 0, 0);
+
     uart_puts("Hello World!\nHowdy World!, this is the OS!");
+    uart_puts("\n\nBoot timeline:\n");
+    timer_timeline_print(&timeline);
     
     while(1); //infinite loop so we don't leave the OS
 }
\ No newline at end of file
@@ -10,7 +10,7 @@ so this file needs:
 - _start label for entry point
 - setup stack pointer
 - clear bss because c requires uninitialized variables to be cleared
-- call to c main func
+- call to c main func, with the bootloader's x0 (its boot timeline) as the argument
 - hang in case of main returning
 */ 
 
@@ -18,22 +18,29 @@ so this file needs:
 .global _start
 
 _start:
+    # The bootloader passes a pointer to its boot timeline in x0; x19 survives the calls below
+    mov x19, x0
+
     # Set up stack pointer
     ldr x0, =boot_stack_top
     mov sp, x0
 
+    # C code and memcpy/memset use FP/SIMD registers; stop them from trapping (CPACR_EL1.FPEN = 0b11)
+    mov x0, #(3 << 20)
+    msr cpacr_el1, x0
+    isb
+
     # Clear BSS section (required for C runtime)
     ldr x0, =__bss_start
-    ldr x1, =__bss_end
+    ldr x2, =__bss_end
+    sub x2, x2, x0
+    mov w1, #0
+    bl memset
 
-clear_bss_loop:
-    cmp x0, x1
-    beq bss_cleared
-    str xzr, [x0]
-    add x0, x0, #8
-    b clear_bss_loop
+    # The bootloader hands over with the MMU off; map memory and turn the caches on
+    bl mmu_init
 
-bss_cleared:
+    mov x0, x19
     bl main
     # If main returns, hang forever
 hang:
@@ -0,0 +1,68 @@
+#!/usr/bin/env python3
+"""Append a CRC32C footer to kernel images so the bootloader can verify them.
+
+    crcstamp.py os.elf os.bin os.bin.lz4
+
+Each file is rewritten in place with a 12-byte footer at its end: the magic
+"C32C", the number of bytes before the footer and their CRC32C (Castagnoli),
+all little-endian. A footer the file already has is replaced, so stamping twice
+gives the same file. Only the Python standard library is needed.
+"""
+
+import struct
+import sys
+
+FOOTER_MAGIC = 0x43323343  # "C32C"
+FOOTER = struct.Struct("<III")
+POLYNOMIAL = 0x82F63B78  # CRC32C, reflected
+
+
+def make_table():
+    table = []
+    for byte in range(256):
+        crc = byte
+        for _ in range(8):
+            crc = (crc >> 1) ^ POLYNOMIAL if crc & 1 else crc >> 1
+        table.append(crc)
+    return table
+
+
+TABLE = make_table()
+
+
+def crc32c(data):
+    crc = 0xFFFFFFFF
+    for byte in data:
+        crc = TABLE[(crc ^ byte) & 0xFF] ^ (crc >> 8)
+    return crc ^ 0xFFFFFFFF
+
+
+def strip_footer(data):
+    if len(data) >= FOOTER.size:
+        magic, length, _ = FOOTER.unpack_from(data, len(data) - FOOTER.size)
+        if magic == FOOTER_MAGIC and length == len(data) - FOOTER.size:
+            return data[:length]
+    return data
+
+
+def main():
+    if len(sys.argv) < 2:
+        print(__doc__.strip().splitlines()[0])
+        print("usage: crcstamp.py FILE...")
+        return 2
+
+    assert crc32c(b"123456789") == 0xE3069283
+
+    for path in sys.argv[1:]:
+        with open(path, "rb") as f:
+            data = strip_footer(f.read())
+        crc = crc32c(data)
+        with open(path, "wb") as f:
+            f.write(data)
+            f.write(FOOTER.pack(FOOTER_MAGIC, len(data), crc))
+        print(f"crcstamp: {path} {len(data)} bytes, CRC32C 0x{crc:08X}")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
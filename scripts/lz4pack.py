@@ -0,0 +1,233 @@
+#!/usr/bin/env python3
+"""Pack a flat kernel image into an LZ4 frame the bootloader can stream.
+
+    lz4pack.py os.bin os.bin.lz4
+
+The frame uses 64 KB linked blocks (matches may reach into earlier blocks,
+which the bootloader allows because it decodes into one contiguous buffer),
+records the content size and ends with an xxHash32 content checksum. Blocks
+that do not shrink are stored uncompressed. Only the Python standard library
+is needed; the output is decoded again and compared before it is written.
+"""
+
+import struct
+import sys
+
+FRAME_MAGIC = 0x184D2204
+BLOCK_SIZE = 64 * 1024
+BLOCK_UNCOMPRESSED = 0x80000000
+
+FLAG_VERSION = 0x40
+FLAG_CONTENT_SIZE = 0x08
+FLAG_CONTENT_CHECKSUM = 0x04
+BLOCK_MAX_64KB = 4 << 4
+
+MIN_MATCH = 4
+MAX_OFFSET = 65535
+LAST_LITERALS = 5  # A block ends with at least this many literals
+MATCH_FIND_LIMIT = 12  # No match starts in the last 12 bytes of a block
+
+PRIME1 = 2654435761
+PRIME2 = 2246822519
+PRIME3 = 3266489917
+PRIME4 = 668265263
+PRIME5 = 374761393
+MASK = 0xFFFFFFFF
+
+
+def rotl(value, bits):
+    return ((value << bits) | (value >> (32 - bits))) & MASK
+
+
+def xxh32(data, seed=0):
+    length = len(data)
+    pos = 0
+    if length >= 16:
+        v = [(seed + PRIME1 + PRIME2) & MASK, (seed + PRIME2) & MASK, seed, (seed - PRIME1) & MASK]
+        while length - pos >= 16:
+            for i in range(4):
+                word = struct.unpack_from("<I", data, pos + 4 * i)[0]
+                v[i] = (rotl((v[i] + word * PRIME2) & MASK, 13) * PRIME1) & MASK
+            pos += 16
+        h = (rotl(v[0], 1) + rotl(v[1], 7) + rotl(v[2], 12) + rotl(v[3], 18)) & MASK
+    else:
+        h = (seed + PRIME5) & MASK
+    h = (h + length) & MASK
+    while length - pos >= 4:
+        h = (h + struct.unpack_from("<I", data, pos)[0] * PRIME3) & MASK
+        h = (rotl(h, 17) * PRIME4) & MASK
+        pos += 4
+    while pos < length:
+        h = (h + data[pos] * PRIME5) & MASK
+        h = (rotl(h, 11) * PRIME1) & MASK
+        pos += 1
+    h ^= h >> 15
+    h = (h * PRIME2) & MASK
+    h ^= h >> 13
+    h = (h * PRIME3) & MASK
+    h ^= h >> 16
+    return h
+
+
+def write_length(out, value):
+    while value >= 255:
+        out.append(255)
+        value -= 255
+    out.append(value)
+
+
+def write_sequence(out, literals, offset, match_length):
+    literal_count = len(literals)
+    match_code = match_length - MIN_MATCH if offset else 0
+    out.append((min(literal_count, 15) << 4) | min(match_code, 15))
+    if literal_count >= 15:
+        write_length(out, literal_count - 15)
+    out += literals
+    if offset:
+        out += struct.pack("<H", offset)
+        if match_code >= 15:
+            write_length(out, match_code - 15)
+
+
+def compress_block(data, start, end, table):
+    """Greedy LZ4 block of data[start:end]; table maps 4-byte strings to their
+    last position and carries over between blocks."""
+    out = bytearray()
+    anchor = start
+    pos = start
+    match_start_limit = end - MATCH_FIND_LIMIT
+    match_end_limit = end - LAST_LITERALS
+
+    while pos < match_start_limit:
+        key = data[pos:pos + MIN_MATCH]
+        candidate = table.get(key)
+        table[key] = pos
+        if candidate is None or pos - candidate > MAX_OFFSET:
+            pos += 1
+            continue
+
+        length = MIN_MATCH
+        while pos + length < match_end_limit and data[candidate + length] == data[pos + length]:
+            length += 1
+
+        write_sequence(out, data[anchor:pos], pos - candidate, length)
+        # Remember a few positions inside the match for later searches
+        for inside in range(pos + 1, min(pos + length, match_start_limit), 4):
+            table[data[inside:inside + MIN_MATCH]] = inside
+        pos += length
+        anchor = pos
+
+    write_sequence(out, data[anchor:end], 0, 0)
+    return out
+
+
+def compress_frame(data):
+    descriptor = bytes([FLAG_VERSION | FLAG_CONTENT_SIZE | FLAG_CONTENT_CHECKSUM, BLOCK_MAX_64KB])
+    descriptor += struct.pack("<Q", len(data))
+    out = bytearray(struct.pack("<I", FRAME_MAGIC))
+    out += descriptor
+    out.append((xxh32(descriptor) >> 8) & 0xFF)
+
+    table = {}
+    for start in range(0, len(data), BLOCK_SIZE):
+        end = min(start + BLOCK_SIZE, len(data))
+        block = compress_block(data, start, end, table)
+        if len(block) < end - start:
+            out += struct.pack("<I", len(block))
+            out += block
+        else:
+            out += struct.pack("<I", (end - start) | BLOCK_UNCOMPRESSED)
+            out += data[start:end]
+
+    out += struct.pack("<I", 0)
+    out += struct.pack("<I", xxh32(data))
+    return bytes(out)
+
+
+def decompress_frame(frame):
+    """Reference decoder used to check the packer's output."""
+    if struct.unpack_from("<I", frame, 0)[0] != FRAME_MAGIC:
+        raise ValueError("bad magic")
+    flags = frame[4]
+    pos = 6
+    content_size = None
+    if flags & FLAG_CONTENT_SIZE:
+        content_size = struct.unpack_from("<Q", frame, pos)[0]
+        pos += 8
+    if (xxh32(frame[4:pos]) >> 8) & 0xFF != frame[pos]:
+        raise ValueError("bad header checksum")
+    pos += 1
+
+    out = bytearray()
+    while True:
+        size = struct.unpack_from("<I", frame, pos)[0]
+        pos += 4
+        if size == 0:
+            break
+        if size & BLOCK_UNCOMPRESSED:
+            size &= ~BLOCK_UNCOMPRESSED
+            out += frame[pos:pos + size]
+            pos += size
+            continue
+
+        end = pos + size
+        while pos < end:
+            token = frame[pos]
+            pos += 1
+            literal_count = token >> 4
+            if literal_count == 15:
+                while True:
+                    extra = frame[pos]
+                    pos += 1
+                    literal_count += extra
+                    if extra != 255:
+                        break
+            out += frame[pos:pos + literal_count]
+            pos += literal_count
+            if pos == end:
+                break
+            offset = struct.unpack_from("<H", frame, pos)[0]
+            pos += 2
+            match_length = (token & 15) + MIN_MATCH
+            if token & 15 == 15:
+                while True:
+                    extra = frame[pos]
+                    pos += 1
+                    match_length += extra
+                    if extra != 255:
+                        break
+            source = len(out) - offset
+            if offset == 0 or source < 0:
+                raise ValueError("bad match offset")
+            for i in range(match_length):
+                out.append(out[source + i])
+
+    if flags & FLAG_CONTENT_CHECKSUM and struct.unpack_from("<I", frame, pos)[0] != xxh32(bytes(out)):
+        raise ValueError("bad content checksum")
+    if content_size is not None and content_size != len(out):
+        raise ValueError("bad content size")
+    return bytes(out)
+
+
+def main():
+    if len(sys.argv) != 3:
+        print(__doc__.strip().splitlines()[0])
+        print("usage: lz4pack.py INPUT OUTPUT")
+        return 2
+
+    with open(sys.argv[1], "rb") as f:
+        data = f.read()
+    frame = compress_frame(data)
+    if decompress_frame(frame) != data:
+        print("lz4pack: round trip failed", file=sys.stderr)
+        return 1
+    with open(sys.argv[2], "wb") as f:
+        f.write(frame)
+
+    ratio = len(frame) * 100 // len(data) if data else 100
+    print(f"lz4pack: {sys.argv[1]} {len(data)} bytes -> {sys.argv[2]} {len(frame)} bytes ({ratio}%)")
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,151 @@
+#!/usr/bin/env python3
+"""Decode trace ring dumps from a serial log into a timeline.
+
+    tracedecode.py [LOG]
+
+Reads the log (or standard input) and decodes every block between
+"TRACE BEGIN frequency=... records=... dropped=..." and "TRACE END", as printed
+by trace_dump(). Each record line is the 16 bytes of a trace_record in hex:
+the low 32 bits of the counter, the event id, the core, then two arguments,
+all little-endian. Disk requests are matched from submit to completion to show
+their latency. Only the Python standard library is needed.
+"""
+
+import re
+import struct
+import sys
+
+RECORD = struct.Struct("<IHHII")
+BEGIN = re.compile(r"TRACE BEGIN frequency=(\d+) records=(\d+) dropped=(\d+)")
+END = "TRACE END"
+
+# Event ids from trace/trace.h
+PHASE = 1
+VIO_READ = 2
+VIO_WRITE = 3
+VIO_FLUSH = 4
+VIO_COMPLETE = 5
+FAT_FETCH = 6
+FAT_CLUSTER = 7
+FAT_READ = 8
+FATAL = 9
+USER = 0x100
+
+NAMES = {
+    PHASE: "phase",
+    VIO_READ: "vio read",
+    VIO_WRITE: "vio write",
+    VIO_FLUSH: "vio flush",
+    VIO_COMPLETE: "vio complete",
+    FAT_FETCH: "fat fetch",
+    FAT_CLUSTER: "fat cluster",
+    FAT_READ: "fat read",
+    FATAL: "fatal",
+}
+
+
+def read_dumps(lines):
+    """Yield (frequency, dropped, records) for every complete dump in the log."""
+    header = None
+    records = []
+    for line in lines:
+        line = line.strip()
+        match = BEGIN.search(line)
+        if match:
+            header = (int(match.group(1)), int(match.group(3)))
+            records = []
+        elif header is not None and line == END:
+            yield header[0], header[1], records
+            header = None
+        elif header is not None and re.fullmatch(r"[0-9a-fA-F]{32}", line):
+            records.append(RECORD.unpack(bytes.fromhex(line)))
+
+
+def event_name(event):
+    if event >= USER:
+        return f"user {event - USER}"
+    return NAMES.get(event, f"event {event}")
+
+
+def describe(event, arg0, arg1):
+    if event == PHASE:
+        if arg0 == 0xFFFFFFFF:
+            return "last phase ended"
+        tag = arg1.to_bytes(4, "little").rstrip(b"\0").decode("ascii", "replace")
+        return f"#{arg0} \"{tag}...\""
+    if event in (VIO_READ, VIO_WRITE):
+        return f"sector {arg0}, {arg1 >> 8} sectors, request {arg1 & 0xFF}"
+    if event == VIO_FLUSH:
+        return f"request {arg1 & 0xFF}"
+    if event == VIO_COMPLETE:
+        return f"request {arg0}, {arg1} still in flight"
+    if event == FAT_FETCH:
+        return f"sector {arg0}, {arg1} sectors"
+    if event == FAT_CLUSTER:
+        return f"cluster {arg0}, run of {arg1}"
+    if event == FAT_READ:
+        return f"first cluster {arg0}, {arg1} bytes"
+    if event == FATAL:
+        return f"in phase #{arg0}"
+    return f"0x{arg0:08X} 0x{arg1:08X}"
+
+
+def decode(frequency, dropped, records):
+    if frequency == 0:
+        frequency = 1
+    print(f"{len(records)} records at {frequency} Hz"
+          + (f", {dropped} older records overwritten" if dropped else ""))
+    print("     time us    delta us  cpu  event          details")
+
+    ticks = 0
+    previous = None
+    submitted = {}  # Request handle -> submit time in ticks
+    latencies = []
+    for time, event, cpu, arg0, arg1 in records:
+        # The counter's low 32 bits wrap; records are in order, so add up deltas
+        delta = 0 if previous is None else (time - previous) & 0xFFFFFFFF
+        ticks += delta
+        previous = time
+
+        details = describe(event, arg0, arg1)
+        if event in (VIO_READ, VIO_WRITE, VIO_FLUSH):
+            submitted[arg1 & 0xFF] = ticks
+        elif event == VIO_COMPLETE and arg0 in submitted:
+            latency = (ticks - submitted.pop(arg0)) * 1e6 / frequency
+            latencies.append(latency)
+            details += f", {latency:.1f} us"
+
+        print(f"{ticks * 1e6 / frequency:12.1f} {delta * 1e6 / frequency:11.1f} {cpu:4}  {event_name(event):14} {details}")
+
+    counts = {}
+    for record in records:
+        counts[record[1]] = counts.get(record[1], 0) + 1
+    print("Events: " + ", ".join(f"{event_name(event)} {count}" for event, count in sorted(counts.items())))
+    if latencies:
+        print(f"Disk requests: {len(latencies)} completed, latency average "
+              f"{sum(latencies) / len(latencies):.1f} us, max {max(latencies):.1f} us")
+    if submitted:
+        print(f"Disk requests still in flight at the dump: {len(submitted)}")
+
+
+def main():
+    if len(sys.argv) > 2:
+        print(__doc__.strip().splitlines()[0])
+        print("usage: tracedecode.py [LOG]")
+        return 2
+
+    log = open(sys.argv[1], errors="replace") if len(sys.argv) == 2 else sys.stdin
+    dumps = 0
+    for frequency, dropped, records in read_dumps(log):
+        if dumps > 0:
+            print()
+        decode(frequency, dropped, records)
+        dumps += 1
+    if dumps == 0:
+        print("tracedecode: no complete trace dump found (is the build made with TRACE?)")
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
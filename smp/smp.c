@@ -0,0 +1,45 @@
+#include "smp.h"
+#include "../mmu/mmu.h"
+
+// Secondary core entry point in smp_entry.s; expects its smp_boot_record in x0
+extern void smp_secondary_entry(void);
+
+static smp_boot_record smp_boot_records[SMP_MAX_CPUS];
+
+// QEMU virt (without EL2/EL3) implements PSCI in the hypervisor conduit
+static int64_t psci_call(uint64_t function, uint64_t argument0, uint64_t argument1, uint64_t argument2) {
+    register uint64_t x0 asm("x0") = function;
+    register uint64_t x1 asm("x1") = argument0;
+    register uint64_t x2 asm("x2") = argument1;
+    register uint64_t x3 asm("x3") = argument2;
+    asm volatile("hvc #0"
+        : "+r"(x0), "+r"(x1), "+r"(x2), "+r"(x3)
+        :
+        : "x4", "x5", "x6", "x7", "x8", "x9", "x10", "x11",
+          "x12", "x13", "x14", "x15", "x16", "x17", "memory");
+    return (int64_t)x0;
+}
+
+int smp_start_cpu(uint32_t cpu, smp_entry entry, void* argument, uint8_t* stack_top) {
+    if (cpu >= SMP_MAX_CPUS || entry == NULL || stack_top == NULL ||
+        ((uint64_t)stack_top & 0xF) != 0) {
+        return PSCI_INVALID_PARAMETERS;
+    }
+    if (!mmu_is_enabled()) {
+        return PSCI_DENIED; // Exclusives, and so spinlocks, need cacheable memory
+    }
+
+    smp_boot_record* record = &smp_boot_records[cpu];
+    uint64_t vector_table;
+    asm volatile("mrs %0, vbar_el1" : "=r"(vector_table));
+
+    record->stack_top = (uint64_t)stack_top;
+    record->entry = (uint64_t)entry;
+    record->argument = (uint64_t)argument;
+    record->vector_table = vector_table;
+
+    // The new core reads the record with its caches off
+    mmu_clean_range(record, sizeof(*record));
+
+    return (int)psci_call(PSCI_CPU_ON, cpu, (uint64_t)smp_secondary_entry, (uint64_t)record);
+}
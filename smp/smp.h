@@ -0,0 +1,101 @@
+#ifndef SMP_H
+#define SMP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "../mmu/mmu.h"
+
+// QEMU virt puts up to 8 Cortex-A53 cores in one cluster (MPIDR Aff0 = 0-7)
+#define SMP_MAX_CPUS 8
+
+// PSCI 0.2+ function IDs (SMC64/HVC64 calling convention)
+#define PSCI_CPU_ON 0xC4000003u
+
+// PSCI return codes
+#define PSCI_SUCCESS 0
+#define PSCI_NOT_SUPPORTED -1
+#define PSCI_INVALID_PARAMETERS -2
+#define PSCI_DENIED -3
+#define PSCI_ALREADY_ON -4
+#define PSCI_ON_PENDING -5
+#define PSCI_INTERNAL_FAILURE -6
+
+// Function a secondary core runs once it is up; returning parks the core
+typedef void (*smp_entry)(void* argument);
+
+// Everything a secondary core needs before it can run C, read by smp_entry.s
+// Field offsets are hard-coded there
+typedef struct {
+    uint64_t stack_top; // 0x00 - Initial SP, 16-byte aligned
+    uint64_t entry; // 0x08 - smp_entry to call
+    uint64_t argument; // 0x10 - Passed to entry in x0
+    uint64_t vector_table; // 0x18 - VBAR_EL1, copied from the boot core
+} smp_boot_record;
+
+// Test-and-set lock; lives in shared memory, starts unlocked when zeroed
+typedef struct {
+    volatile uint32_t locked;
+} spinlock;
+
+#define SPINLOCK_INIT { 0 }
+
+/**
+ * @brief Returns the index of the calling core.
+ *
+ * @return MPIDR_EL1 affinity level 0, which is 0 for the boot core on QEMU virt.
+ */
+static inline uint32_t smp_cpu_id(void) {
+    uint64_t mpidr;
+    asm volatile("mrs %0, mpidr_el1" : "=r"(mpidr));
+    return (uint32_t)(mpidr & 0xFF);
+}
+
+/**
+ * @brief Powers on a secondary core through PSCI CPU_ON.
+ *
+ * The core starts at EL1 with the MMU off, enables FP/SIMD, installs the boot
+ * core's exception vectors, switches to stack_top, turns on the MMU and caches
+ * with the boot core's tables, and calls entry(argument).
+ * IRQs stay masked on the new core. mmu_init() must have run on the boot core,
+ * since spinlocks shared between cores need the Normal memory it maps.
+ *
+ * @param cpu The core index (MPIDR affinity level 0).
+ * @param entry Function to run on the core.
+ * @param argument Passed to entry unchanged.
+ * @param stack_top Top of the core's stack; must be 16-byte aligned.
+ * @return 0 on success, negative PSCI_* value on error (e.g., PSCI_ALREADY_ON,
+ *         or PSCI_DENIED with the MMU off).
+ */
+int smp_start_cpu(uint32_t cpu, smp_entry entry, void* argument, uint8_t* stack_top);
+
+// Spins until the lock is free, then takes it
+// WFE sleeps between attempts; the releasing store wakes the waiters.
+// With the MMU off all memory is Device memory, where load/store exclusives are
+// not guaranteed to work. Only the boot core runs then (secondary cores follow
+// its MMU state), so the lock is simply marked taken.
+static inline void spin_lock(spinlock* lock) {
+    if (!mmu_is_enabled()) {
+        lock->locked = 1;
+        return;
+    }
+
+    uint32_t value;
+    uint32_t failed;
+    asm volatile(
+        "   sevl\n"
+        "1: wfe\n"
+        "2: ldaxr %w0, [%2]\n"
+        "   cbnz %w0, 1b\n"
+        "   stxr %w1, %w3, [%2]\n"
+        "   cbnz %w1, 2b\n"
+        : "=&r"(value), "=&r"(failed)
+        : "r"(&lock->locked), "r"(1)
+        : "memory");
+}
+
+static inline void spin_unlock(spinlock* lock) {
+    asm volatile("stlr wzr, [%0]" :: "r"(&lock->locked) : "memory");
+}
+
+#endif
@@ -0,0 +1,38 @@
+/*
+ * smp_entry.s - first code a secondary core runs after PSCI CPU_ON
+ *
+ * x0 holds the core's smp_boot_record (see smp.h). The core arrives at EL1
+ * with the MMU and caches off, so everything here is position independent and
+ * only touches the record until the MMU is on (the boot core cleaned the record
+ * to memory for us).
+ */
+
+.section ".text"
+.global smp_secondary_entry
+
+smp_secondary_entry:
+    // C code may use FP/SIMD registers; stop them from trapping (CPACR_EL1.FPEN = 0b11)
+    mov x1, #(3 << 20)
+    msr cpacr_el1, x1
+
+    // Same exception vectors as the boot core
+    ldr x1, [x0, #0x18]
+    msr vbar_el1, x1
+    isb
+
+    ldr x1, [x0, #0x00]
+    mov sp, x1
+
+    // Same page tables and caches as the boot core, before touching shared memory
+    mov x19, x0
+    bl mmu_init_secondary
+    mov x0, x19
+
+    ldr x1, [x0, #0x08]
+    ldr x0, [x0, #0x10]
+    blr x1
+
+    // Entry returned: park the core
+park:
+    wfe
+    b park
@@ -0,0 +1,104 @@
+#include "../uart/uart.h"
+#include "../timer/timer.h"
+#include "../irq/irq.h"
+#include "../mmu/mmu.h"
+#include "../filesystem/vio/vio.h"
+#include "../filesystem/fat/fat.h"
+#include "../bootloader/lz4.h"
+#include "../libc-lite/string.h"
+
+// Load time with and without compression, the way the bootloader loads a flat
+// kernel: IMAGE.BIN is read whole with fat_read(), IMAGE.LZ4 (the same data
+// packed by scripts/lz4pack.py, see `make disk`) is decompressed chunk by chunk
+// from fat_read_stream() while the next chunk loads:
+//     make bench-lz4
+
+#define BENCH_IMAGE_CAPACITY (4 * 1024 * 1024)
+
+static uint8_t raw_image[BENCH_IMAGE_CAPACITY] __attribute__((aligned(64)));
+static uint8_t unpacked_image[BENCH_IMAGE_CAPACITY] __attribute__((aligned(64)));
+
+static int decompress_chunk(const uint8_t* data, uint32_t length, uint32_t offset, void* context) {
+    (void)offset;
+    return lz4_stream_feed((lz4_stream*)context, data, length);
+}
+
+static void print_load(const char* name, uint64_t ticks, uint32_t bytes_read, uint32_t bytes_loaded) {
+    uart_puts(name);
+    uart_print_dec((uint32_t)timer_ticks_to_us(ticks));
+    uart_puts(" us, ");
+    uart_print_dec(bytes_read);
+    uart_puts(" bytes read, ");
+    uart_print_dec(bytes_loaded);
+    uart_puts(" bytes loaded\n");
+}
+
+int main(void) {
+    uart_init();
+    irq_init();
+    mmu_init(); // Caches on, as in the bootloader
+
+    uart_puts("=== LZ4 Kernel Load Benchmark ===\n");
+
+    if (vio_init() < 0 || fat_init() < 0 || fat_mount(0) < 0) {
+        uart_puts("FAIL - Could not mount the test disk\n");
+        return -1;
+    }
+
+    fat_file raw_file = {0};
+    fat_file packed_file = {0};
+    if (fat_open_path("/IMAGE.BIN", &raw_file) < 0 || fat_open_path("/IMAGE.LZ4", &packed_file) < 0) {
+        uart_puts("FAIL - IMAGE.BIN or IMAGE.LZ4 missing (run make disk with mtools and python3)\n");
+        return -1;
+    }
+    if (raw_file.file_size > BENCH_IMAGE_CAPACITY) {
+        uart_puts("FAIL - IMAGE.BIN larger than the benchmark buffers\n");
+        return -1;
+    }
+
+    // Compression off
+    uint64_t start = timer_now();
+    if (fat_read(&raw_file, raw_image) < 0) {
+        uart_puts("FAIL - Could not read IMAGE.BIN\n");
+        return -1;
+    }
+    uint64_t raw_ticks = timer_now() - start;
+
+    // Compression on
+    lz4_stream stream;
+    lz4_stream_init(&stream, unpacked_image, BENCH_IMAGE_CAPACITY);
+    start = timer_now();
+    int result = fat_read_stream(&packed_file, decompress_chunk, &stream);
+    uint64_t packed_ticks = timer_now() - start;
+    if (result < 0 || !lz4_stream_done(&stream)) {
+        uart_puts("FAIL - Could not decompress IMAGE.LZ4\n");
+        return -1;
+    }
+
+    print_load("Raw: ", raw_ticks, raw_file.file_size, raw_file.file_size);
+    print_load("LZ4: ", packed_ticks, packed_file.file_size, (uint32_t)lz4_stream_output_size(&stream));
+
+    // Ratio and speedup with one decimal
+    uint64_t ratio = (uint64_t)packed_file.file_size * 1000 / raw_file.file_size;
+    uart_puts("Compressed size: ");
+    uart_print_dec((uint32_t)(ratio / 10));
+    uart_putc('.');
+    uart_print_dec((uint32_t)(ratio % 10));
+    uart_puts("%, speedup x");
+    uint64_t speedup = packed_ticks > 0 ? raw_ticks * 10 / packed_ticks : 0;
+    uart_print_dec((uint32_t)(speedup / 10));
+    uart_putc('.');
+    uart_print_dec((uint32_t)(speedup % 10));
+    uart_putc('\n');
+
+    if (lz4_stream_output_size(&stream) == raw_file.file_size &&
+        memcmp(raw_image, unpacked_image, raw_file.file_size) == 0) {
+        uart_puts("PASS - Decompressed image matches IMAGE.BIN\n");
+    } else {
+        uart_puts("FAIL - Decompressed image differs from IMAGE.BIN\n");
+    }
+
+    uart_puts("\n=== LZ4 Kernel Load Benchmark Completed ===\n");
+
+    return 0;
+}
@@ -0,0 +1,136 @@
+#include "../uart/uart.h"
+#include "../timer/timer.h"
+#include "../irq/irq.h"
+#include "../mmu/mmu.h"
+#include "../filesystem/vio/vio.h"
+
+// Compares the split and packed virtqueues: per-request latency for one request
+// at a time and for a batch in flight, and the ring cache lines each layout
+// needs for that batch. Packed rings need a modern device that offers them:
+//     make bench-vio VIO_PACKED=1
+
+#define BENCH_REQUESTS 256 // Requests per measurement
+#define BENCH_BATCH 16 // Requests in flight in the batched measurement
+#define BENCH_SECTORS 64 // Sectors the benchmark cycles through
+#define BENCH_CACHE_LINE 64
+
+static uint8_t bench_buffers[BENCH_BATCH][VIO_SECTOR_SIZE];
+
+static void print_ticks(const char* label, uint64_t ticks) {
+    uart_puts(label);
+    uart_print_dec((uint32_t)ticks);
+    uart_puts(" ticks (");
+    uart_print_dec((uint32_t)(ticks * 1000000000ull / timer_frequency()));
+    uart_puts(" ns)\n");
+}
+
+static uint32_t lines_spanned(uint32_t bytes) {
+    return (bytes + BENCH_CACHE_LINE - 1) / BENCH_CACHE_LINE;
+}
+
+// Ring cache lines BENCH_BATCH requests touch, counting from the start of each area
+// Split: descriptors + available ring + used ring; packed: the descriptor ring only,
+// since used descriptors overwrite the available ones in place
+static uint32_t ring_cache_lines(bool packed, uint32_t ring_descriptors) {
+    uint32_t descriptor_lines = lines_spanned(BENCH_BATCH * ring_descriptors * 16);
+    if (packed) {
+        return descriptor_lines;
+    }
+
+    uint32_t available_lines = lines_spanned(4 + BENCH_BATCH * 2);
+    uint32_t used_lines = lines_spanned(4 + BENCH_BATCH * 8);
+    return descriptor_lines + available_lines + used_lines;
+}
+
+static int bench_ring(bool packed) {
+    uart_puts(packed ? "\n--- Packed ring ---\n" : "\n--- Split ring ---\n");
+
+    vio_set_packed_ring(packed);
+    if (vio_init() < 0) {
+        uart_puts("FAIL - VirtIO initialization failed\n");
+        return -1;
+    }
+
+    vio_ring_info info;
+    vio_get_ring_info(&info);
+    if (info.packed != packed) {
+        uart_puts("SKIP - Device does not offer packed rings (use VIO_PACKED=1)\n");
+        return 0;
+    }
+
+    uart_puts("Queue depth: ");
+    uart_print_dec(info.queue_size);
+    uart_puts(", ring memory: ");
+    uart_print_dec((uint32_t)info.ring_memory_size);
+    uart_puts(" bytes\n");
+
+    // One request at a time: submit, kick, interrupt, reap
+    uint64_t minimum = UINT64_MAX;
+    uint64_t maximum = 0;
+    uint64_t total = 0;
+    for (int i = 0; i < BENCH_REQUESTS; i++) {
+        uint64_t start = timer_now();
+        if (vio_read_sector(i % BENCH_SECTORS, bench_buffers[0]) < 0) {
+            uart_puts("FAIL - Read failed\n");
+            return -1;
+        }
+        uint64_t ticks = timer_now() - start;
+
+        total += ticks;
+        minimum = ticks < minimum ? ticks : minimum;
+        maximum = ticks > maximum ? ticks : maximum;
+    }
+    print_ticks("Single request, min: ", minimum);
+    print_ticks("Single request, avg: ", total / BENCH_REQUESTS);
+    print_ticks("Single request, max: ", maximum);
+
+    // BENCH_BATCH requests per kick, collected once they are all submitted
+    int requests[BENCH_BATCH];
+    uint64_t start = timer_now();
+    for (int round = 0; round < BENCH_REQUESTS / BENCH_BATCH; round++) {
+        vio_batch_begin();
+        for (int i = 0; i < BENCH_BATCH; i++) {
+            requests[i] = vio_submit_read((round * BENCH_BATCH + i) % BENCH_SECTORS, 1, bench_buffers[i]);
+            if (requests[i] < 0) {
+                vio_batch_end();
+                uart_puts("FAIL - Could not submit batched read\n");
+                return -1;
+            }
+        }
+        vio_batch_end();
+
+        for (int i = 0; i < BENCH_BATCH; i++) {
+            if (vio_wait(requests[i]) < 0) {
+                uart_puts("FAIL - Batched read failed\n");
+                return -1;
+            }
+        }
+    }
+    print_ticks("Batched, avg per request: ", (timer_now() - start) / BENCH_REQUESTS);
+
+    // Single-sector reads are header + data + status: one ring descriptor with
+    // indirect descriptors, three without
+    uart_puts("Ring cache lines for a batch (indirect / direct): ");
+    uart_print_dec(ring_cache_lines(packed, 1));
+    uart_puts(" / ");
+    uart_print_dec(ring_cache_lines(packed, 3));
+    uart_putc('\n');
+
+    return 0;
+}
+
+int main(void) {
+    uart_init();
+    irq_init();
+    mmu_init(); // Caches on, as in the bootloader
+
+    uart_puts("=== VirtIO Ring Benchmark ===\n");
+
+    if (bench_ring(false) < 0 || bench_ring(true) < 0) {
+        return -1;
+    }
+
+    uart_puts("\n=== VirtIO Ring Benchmark Completed ===\n");
+
+    return 0;
+}
@@ -0,0 +1,143 @@
+#include "../uart/uart.h"
+#include "../timer/timer.h"
+#include "../irq/irq.h"
+#include "../mmu/mmu.h"
+#include "../smp/smp.h"
+#include "../filesystem/vio/vio.h"
+
+// Read throughput with 1 to N cores submitting at once. With VIO_BLOCK_FEATURE_MQ
+// every core gets its own request queue, so throughput should grow with the
+// core count instead of flattening on a shared queue:
+//     make bench-vio-mq SMP=4
+
+#define BENCH_REQUESTS 128 // Requests per core per round
+#define BENCH_REQUEST_SECTORS 8 // One 4 KB read per request
+#define BENCH_SECTOR_SPAN 512 // Each core cycles through its own 256 KB of the disk
+#define BENCH_STACK_SIZE 8192
+
+static uint8_t bench_stacks[SMP_MAX_CPUS][BENCH_STACK_SIZE] __attribute__((aligned(16)));
+static uint8_t bench_buffers[SMP_MAX_CPUS][BENCH_REQUEST_SECTORS * VIO_SECTOR_SIZE];
+
+// Core 0 bumps bench_round to start a round with bench_active_cores cores;
+// every core reports back through its own slot so no atomics are needed
+static volatile uint32_t bench_round = 0;
+static volatile uint32_t bench_active_cores = 0;
+static volatile uint32_t bench_finished_round[SMP_MAX_CPUS];
+static volatile int bench_errors[SMP_MAX_CPUS];
+static volatile bool bench_online[SMP_MAX_CPUS];
+
+static void bench_run_requests(uint32_t cpu) {
+    uint32_t base = 2048 + cpu * BENCH_SECTOR_SPAN;
+    for (uint32_t i = 0; i < BENCH_REQUESTS; i++) {
+        uint32_t sector = base + (i * BENCH_REQUEST_SECTORS) % BENCH_SECTOR_SPAN;
+        if (vio_read_sectors(sector, BENCH_REQUEST_SECTORS, bench_buffers[cpu]) < 0) {
+            bench_errors[cpu]++;
+        }
+    }
+}
+
+// Secondary cores wait for each round, run it if they are part of it, and report back
+static void bench_secondary(void* argument) {
+    uint32_t cpu = (uint32_t)(uint64_t)argument;
+    uint32_t seen_round = 0;
+
+    bench_online[cpu] = true;
+    __sync_synchronize();
+
+    for (;;) {
+        while (bench_round == seen_round) {
+            __asm__ volatile("yield");
+        }
+        seen_round = bench_round;
+        __sync_synchronize();
+
+        if (cpu < bench_active_cores) {
+            bench_run_requests(cpu);
+        }
+
+        __sync_synchronize();
+        bench_finished_round[cpu] = seen_round;
+    }
+}
+
+int main(void) {
+    uart_init();
+    irq_init();
+    mmu_init(); // Caches on, as in the bootloader
+
+    uart_puts("=== VirtIO Multi-Queue Benchmark ===\n");
+
+    if (vio_init() < 0) {
+        uart_puts("FAIL - VirtIO initialization failed\n");
+        return -1;
+    }
+
+    // Secondary cores cannot take the device interrupt, so everyone polls
+    vio_set_polling(true);
+
+    // Bring up every core QEMU was started with; CPU_ON fails past the last one
+    uint32_t cores = 1;
+    while (cores < SMP_MAX_CPUS &&
+        smp_start_cpu(cores, bench_secondary, (void*)(uint64_t)cores, bench_stacks[cores] + BENCH_STACK_SIZE) == PSCI_SUCCESS) {
+        while (!bench_online[cores]) {
+        }
+        cores++;
+    }
+
+    uart_puts("Cores: ");
+    uart_print_dec(cores);
+    uart_puts(", request queues: ");
+    uart_print_dec(vio_queue_count());
+    uart_putc('\n');
+
+    uint64_t frequency = timer_frequency();
+    uint64_t single_core_ticks = 0;
+
+    for (uint32_t active = 1; active <= cores; active++) {
+        bench_active_cores = active;
+        __sync_synchronize();
+
+        uint64_t start = timer_now();
+        uint32_t round = ++bench_round;
+
+        bench_run_requests(0);
+        for (uint32_t cpu = 1; cpu < cores; cpu++) {
+            while (bench_finished_round[cpu] != round) {
+            }
+        }
+        uint64_t ticks = timer_now() - start;
+        if (active == 1) {
+            single_core_ticks = ticks;
+        }
+
+        uint32_t requests = active * BENCH_REQUESTS;
+        uart_print_dec(active);
+        uart_puts(active == 1 ? " core:  " : " cores: ");
+        uart_print_dec(requests);
+        uart_puts(" requests in ");
+        uart_print_dec((uint32_t)timer_ticks_to_us(ticks));
+        uart_puts(" us, ");
+        uart_print_dec((uint32_t)(requests * frequency / ticks));
+        uart_puts(" requests/s, speedup x");
+        // Throughput relative to one core, with one decimal
+        uint64_t speedup = active * single_core_ticks * 10 / ticks;
+        uart_print_dec((uint32_t)(speedup / 10));
+        uart_putc('.');
+        uart_print_dec((uint32_t)(speedup % 10));
+        uart_putc('\n');
+    }
+
+    int errors = 0;
+    for (uint32_t cpu = 0; cpu < cores; cpu++) {
+        errors += bench_errors[cpu];
+    }
+    if (errors > 0) {
+        uart_puts("FAIL - Reads failed: ");
+        uart_print_dec((uint32_t)errors);
+        uart_putc('\n');
+    }
+
+    uart_puts("\n=== VirtIO Multi-Queue Benchmark Completed ===\n");
+
+    return 0;
+}
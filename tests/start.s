@@ -11,15 +11,17 @@ _start:
     ldr x0, =__stack_top
     mov sp, x0
 
+    // memcpy/memset use FP/SIMD registers; stop them from trapping
+    mov x0, #(3 << 20)
+    msr cpacr_el1, x0
+    isb
+
     // Clear BSS section
     ldr x0, =__bss_start
-    ldr x1, =__bss_end
-clear_bss:
-    cmp x0, x1
-    beq bss_done
-    str xzr, [x0], #8
-    b clear_bss
-bss_done:
+    ldr x2, =__bss_end
+    sub x2, x2, x0
+    mov w1, #0
+    bl memset
 
     // Call main function
     bl main
@@ -0,0 +1,186 @@
+#include "../uart/uart.h"
+#include "../irq/irq.h"
+#include "../mmu/mmu.h"
+#include "../filesystem/vio/vio.h"
+#include "../filesystem/cache/bcache.h"
+
+static uint8_t cached_buffer[BCACHE_BYPASS_SECTORS * VIO_SECTOR_SIZE];
+static uint8_t direct_buffer[BCACHE_BYPASS_SECTORS * VIO_SECTOR_SIZE];
+
+static bool buffers_match(const uint8_t* a, const uint8_t* b, uint32_t bytes) {
+    for (uint32_t i = 0; i < bytes; i++) {
+        if (a[i] != b[i]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static void print_stats(void) {
+    bcache_stats stats;
+    bcache_get_stats(&stats);
+    uart_puts("Hits: ");
+    uart_print_dec(stats.hits);
+    uart_puts(", misses: ");
+    uart_print_dec(stats.misses);
+    uart_puts(", evictions: ");
+    uart_print_dec(stats.evictions);
+    uart_puts(", bypasses: ");
+    uart_print_dec(stats.bypasses);
+    uart_puts(", prefetches: ");
+    uart_print_dec(stats.prefetches);
+    uart_putc('\n');
+}
+
+// Test the block buffer cache
+int main(void) {
+    uart_init();
+    irq_init();
+    mmu_init(); // Caches on, as in the bootloader
+
+    uart_puts("=== Block Cache Test ===\n");
+
+    // Test 1: Initialize VirtIO device and the cache
+    uart_puts("Test 1: Initializing VirtIO device and block cache...\n");
+    if (vio_init() < 0) {
+        uart_puts("FAIL - VirtIO initialization failed\n");
+        return -1;
+    }
+    bcache_init();
+    uart_puts("PASS - Initialized successfully\n");
+
+    // Test 2: A miss followed by a hit, both matching the device
+    uart_puts("\nTest 2: Reading sectors 0-3 twice through the cache...\n");
+    if (vio_read_sectors(0, 4, direct_buffer) < 0 || bcache_read(0, 4, cached_buffer) < 0) {
+        uart_puts("FAIL - Could not read sectors 0-3\n");
+        return -1;
+    }
+    bool first_match = buffers_match(cached_buffer, direct_buffer, 4 * VIO_SECTOR_SIZE);
+    if (bcache_read(1, 2, cached_buffer) < 0) {
+        uart_puts("FAIL - Could not read sectors 1-2\n");
+        return -1;
+    }
+    bool second_match = buffers_match(cached_buffer, direct_buffer + VIO_SECTOR_SIZE, 2 * VIO_SECTOR_SIZE);
+
+    bcache_stats stats;
+    bcache_get_stats(&stats);
+    print_stats();
+    if (first_match && second_match && stats.misses == 1 && stats.hits == 1) {
+        uart_puts("PASS - One miss, then a hit with the same data\n");
+    } else {
+        uart_puts("FAIL - Unexpected data or counters\n");
+    }
+
+    // Test 3: A pinned block survives pressure from other blocks
+    uart_puts("\nTest 3: Pinning sector 0 under a 2-block budget...\n");
+    if (bcache_set_budget(2 * BCACHE_BLOCK_SIZE) != 2) {
+        uart_puts("FAIL - Budget not applied\n");
+        return -1;
+    }
+    bcache_reset_stats();
+    const uint8_t* pinned = bcache_get(0);
+    if (pinned == NULL) {
+        uart_puts("FAIL - Could not pin sector 0\n");
+        return -1;
+    }
+    for (uint32_t block = 1; block <= 4; block++) {
+        if (bcache_read(block * BCACHE_BLOCK_SECTORS, 1, cached_buffer) < 0) {
+            uart_puts("FAIL - Could not read under pressure\n");
+            bcache_release(0);
+            return -1;
+        }
+    }
+    bcache_get_stats(&stats);
+    bool pinned_match = buffers_match(pinned, direct_buffer, VIO_SECTOR_SIZE);
+    bool pinned_kept = bcache_get(0) == pinned;
+    bcache_release(0);
+    bcache_release(0);
+    print_stats();
+    if (pinned_match && pinned_kept && stats.evictions == 3) {
+        uart_puts("PASS - Pinned block stayed while others were evicted\n");
+    } else {
+        uart_puts("FAIL - Pinned block was disturbed\n");
+    }
+
+    // Test 4: Large reads skip the cache
+    uart_puts("\nTest 4: Reading 64 sectors...\n");
+    bcache_set_budget(BCACHE_POOL_BLOCKS * BCACHE_BLOCK_SIZE);
+    bcache_reset_stats();
+    if (bcache_read(0, BCACHE_BYPASS_SECTORS, cached_buffer) < 0 ||
+        vio_read_sectors(0, BCACHE_BYPASS_SECTORS, direct_buffer) < 0) {
+        uart_puts("FAIL - Could not read 64 sectors\n");
+        return -1;
+    }
+    bcache_get_stats(&stats);
+    if (stats.bypasses == 1 && stats.misses == 0 &&
+        buffers_match(cached_buffer, direct_buffer, BCACHE_BYPASS_SECTORS * VIO_SECTOR_SIZE)) {
+        uart_puts("PASS - Read bypassed the cache\n");
+    } else {
+        uart_puts("FAIL - Large read went through the cache\n");
+    }
+
+    // Test 5: Prefetched blocks turn the next read into hits
+    uart_puts("\nTest 5: Prefetching sectors 32-63, then reading them...\n");
+    bcache_invalidate(32, 32);
+    bcache_reset_stats();
+    int submitted = bcache_prefetch(32, 32);
+    if (submitted != 4 || bcache_read(32, 32, cached_buffer) < 0) {
+        uart_puts("FAIL - Prefetch or read failed\n");
+        return -1;
+    }
+    bcache_get_stats(&stats);
+    print_stats();
+    if (stats.prefetches == 4 && stats.hits == 4 && stats.misses == 0 &&
+        buffers_match(cached_buffer, direct_buffer + 32 * VIO_SECTOR_SIZE, 32 * VIO_SECTOR_SIZE)) {
+        uart_puts("PASS - Prefetched blocks served the read\n");
+    } else {
+        uart_puts("FAIL - Prefetch did not help\n");
+    }
+
+    // Test 6: Invalidated blocks are read again
+    uart_puts("\nTest 6: Invalidating sector 32 and reading it...\n");
+    bcache_invalidate(32, 1);
+    bcache_reset_stats();
+    if (bcache_read(32, 1, cached_buffer) < 0) {
+        uart_puts("FAIL - Could not read sector 32\n");
+        return -1;
+    }
+    bcache_get_stats(&stats);
+    if (stats.misses == 1 && buffers_match(cached_buffer, direct_buffer + 32 * VIO_SECTOR_SIZE, VIO_SECTOR_SIZE)) {
+        uart_puts("PASS - Sector 32 was read from the device again\n");
+    } else {
+        uart_puts("FAIL - Stale block was served\n");
+    }
+
+    // Test 7: Prefetches nobody collects make room for lookups
+    uart_puts("\nTest 7: Looking up a block while a stray prefetch fills the budget...\n");
+    bcache_set_budget(2 * BCACHE_BLOCK_SIZE);
+    bcache_invalidate(64, 2 * BCACHE_BLOCK_SECTORS);
+    pinned = bcache_get(0);
+    submitted = bcache_prefetch(64, BCACHE_BLOCK_SECTORS);
+    bcache_reset_stats();
+    const uint8_t* looked_up = bcache_get(64 + BCACHE_BLOCK_SECTORS);
+    if (pinned == NULL || looked_up == NULL ||
+        vio_read_sectors(64 + BCACHE_BLOCK_SECTORS, 1, direct_buffer) < 0) {
+        uart_puts("FAIL - Lookup failed with the budget held by a prefetch\n");
+    } else {
+        bcache_get_stats(&stats);
+        print_stats();
+        if (submitted == 1 && stats.evictions == 1 && buffers_match(looked_up, direct_buffer, VIO_SECTOR_SIZE)) {
+            uart_puts("PASS - The uncollected prefetch was dropped\n");
+        } else {
+            uart_puts("FAIL - Wrong block dropped or data mismatch\n");
+        }
+    }
+    if (looked_up != NULL) {
+        bcache_release(64 + BCACHE_BLOCK_SECTORS);
+    }
+    if (pinned != NULL) {
+        bcache_release(0);
+    }
+    bcache_set_budget(BCACHE_POOL_BLOCKS * BCACHE_BLOCK_SIZE);
+
+    uart_puts("\n=== All Block Cache Tests Completed ===\n");
+
+    return 0;
+}
@@ -0,0 +1,147 @@
+#include "../uart/uart.h"
+#include "../timer/timer.h"
+#include "../irq/irq.h"
+#include "../mmu/mmu.h"
+#include "../filesystem/vio/vio.h"
+#include "../filesystem/fat/fat.h"
+#include "../crc/crc32c.h"
+
+#define CRC_BENCH_SIZE (256 * 1024)
+#define CRC_BAD_FILE_SIZE 1000
+
+static uint8_t crc_buffer[CRC_BENCH_SIZE + 8] __attribute__((aligned(64)));
+static uint8_t bad_file[CRC_BAD_FILE_SIZE + CRC32C_FOOTER_SIZE];
+
+// Bit-at-a-time CRC32C to check the instructions against
+static uint32_t reference_crc32c(const uint8_t* data, uint32_t length) {
+    uint32_t crc = 0xFFFFFFFF;
+    for (uint32_t i = 0; i < length; i++) {
+        crc ^= data[i];
+        for (int bit = 0; bit < 8; bit++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0x82F63B78 : crc >> 1;
+        }
+    }
+    return ~crc;
+}
+
+static void print_rate(const char* name, uint32_t bytes, uint64_t ticks, uint64_t frequency) {
+    uart_puts(name);
+    uart_print_dec((uint32_t)((uint64_t)bytes * frequency / (ticks > 0 ? ticks : 1) / (1024 * 1024)));
+    uart_puts(" MB/s\n");
+}
+
+// Test the CRC32C library
+int main(void) {
+    uart_init();
+    irq_init();
+    mmu_init(); // Caches on, as in the bootloader
+
+    uart_puts("=== CRC32C Test ===\n");
+
+    // Test 1: Check values from the CRC catalogue and RFC 3720
+    uart_puts("Test 1: Computing known check values...\n");
+    for (uint32_t i = 0; i < 32; i++) {
+        crc_buffer[i] = 0;
+    }
+    uint32_t zeros = crc32c_update(0, crc_buffer, 32);
+    for (uint32_t i = 0; i < 32; i++) {
+        crc_buffer[i] = 0xFF;
+    }
+    uint32_t ones = crc32c_update(0, crc_buffer, 32);
+    if (crc32c_update(0, "123456789", 9) == 0xE3069283 && zeros == 0x8A9136AA && ones == 0x62A8AB43) {
+        uart_puts("PASS - Check values match\n");
+    } else {
+        uart_puts("FAIL - Wrong check values\n");
+    }
+
+    // Test 2: Every length and alignment, whole and in two pieces
+    uart_puts("\nTest 2: Comparing lengths 0-100 at every alignment with a bitwise CRC...\n");
+    for (uint32_t i = 0; i < 128; i++) {
+        crc_buffer[i] = (uint8_t)(i * 37 + 11);
+    }
+    bool all_match = true;
+    for (uint32_t align = 0; align < 8 && all_match; align++) {
+        for (uint32_t length = 0; length <= 100 && all_match; length++) {
+            const uint8_t* data = crc_buffer + align;
+            uint32_t expected = reference_crc32c(data, length);
+            uint32_t split = length / 3;
+            all_match = crc32c_update(0, data, length) == expected &&
+                crc32c_update(crc32c_update(0, data, split), data + split, length - split) == expected;
+        }
+    }
+    uart_puts(all_match ? "PASS - All lengths and alignments match\n" : "FAIL - Mismatch\n");
+
+    // Test 3: Throughput against the bitwise loop
+    uart_puts("\nTest 3: Timing 256 KB...\n");
+    for (uint32_t i = 0; i < CRC_BENCH_SIZE; i++) {
+        crc_buffer[i] = (uint8_t)(i ^ (i >> 8));
+    }
+    uint64_t frequency = timer_frequency();
+    uint64_t start = timer_now();
+    uint32_t reference = reference_crc32c(crc_buffer, CRC_BENCH_SIZE);
+    uint64_t reference_ticks = timer_now() - start;
+    start = timer_now();
+    uint32_t fast = crc32c_update(0, crc_buffer, CRC_BENCH_SIZE);
+    uint64_t fast_ticks = timer_now() - start;
+    print_rate("Bitwise:  ", CRC_BENCH_SIZE, reference_ticks, frequency);
+    print_rate("crc32cx:  ", CRC_BENCH_SIZE, fast_ticks, frequency);
+    uart_puts(fast == reference ? "PASS - Same CRC\n" : "FAIL - Different CRC\n");
+
+    // Test 4: Files on the test disk
+    uart_puts("\nTest 4: Verifying /CRC.BIN and /TEST.TXT...\n");
+    if (vio_init() < 0 || fat_init() < 0 || fat_mount(0) < 0) {
+        uart_puts("FAIL - Could not mount the test disk\n");
+        return -1;
+    }
+    fat_file file;
+    if (fat_open_path("/CRC.BIN", &file) < 0) {
+        uart_puts("FAIL - CRC.BIN missing (run make disk with mtools and python3)\n");
+    } else {
+        start = timer_now();
+        int result = crc32c_verify_file(&file);
+        uint64_t ticks = timer_now() - start;
+        print_rate("File:     ", file.file_size, ticks, frequency);
+        if (result == 0) {
+            uart_puts("PASS - CRC.BIN matches its footer\n");
+        } else {
+            uart_puts("FAIL - CRC.BIN did not verify\n");
+        }
+    }
+    if (fat_open_path("/TEST.TXT", &file) < 0 || crc32c_verify_file(&file) != CRC32C_ERROR_NO_FOOTER) {
+        uart_puts("FAIL - TEST.TXT not reported as unstamped\n");
+    } else {
+        uart_puts("PASS - TEST.TXT has no footer\n");
+    }
+
+    // Test 5: A footer that does not match
+    uart_puts("\nTest 5: Writing /BADCRC.BIN with a wrong footer...\n");
+    for (uint32_t i = 0; i < CRC_BAD_FILE_SIZE; i++) {
+        bad_file[i] = (uint8_t)(i * 13);
+    }
+    crc32c_footer footer = {
+        .magic = CRC32C_FOOTER_MAGIC,
+        .length = CRC_BAD_FILE_SIZE,
+        .crc = crc32c_update(0, bad_file, CRC_BAD_FILE_SIZE) ^ 1,
+    };
+    const uint8_t* footer_bytes = (const uint8_t*)&footer;
+    for (uint32_t i = 0; i < CRC32C_FOOTER_SIZE; i++) {
+        bad_file[CRC_BAD_FILE_SIZE + i] = footer_bytes[i];
+    }
+
+    // A file left by an earlier run is emptied and reused
+    int bad_ready = fat_open_path("/BADCRC.BIN", &file) == 0
+        ? fat_truncate(&file, 0)
+        : fat_create("/BADCRC.BIN", &file);
+    if (bad_ready < 0 || fat_append(&file, bad_file, sizeof(bad_file)) < 0 || fat_sync() < 0 ||
+        fat_open_path("/BADCRC.BIN", &file) < 0) {
+        uart_puts("FAIL - Could not write the file\n");
+    } else if (crc32c_verify_file(&file) == CRC32C_ERROR_MISMATCH) {
+        uart_puts("PASS - Mismatch detected\n");
+    } else {
+        uart_puts("FAIL - Damaged file verified\n");
+    }
+
+    uart_puts("\n=== All CRC32C Tests Completed ===\n");
+
+    return 0;
+}
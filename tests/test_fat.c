@@ -1,6 +1,8 @@
 #include "../uart/uart.h"
+#include "../mmu/mmu.h"
 #include "../filesystem/vio/vio.h"
 #include "../filesystem/fat/fat.h"
+#include "../filesystem/cache/bcache.h"
 
 // Helper function to print a byte in hex
 static void print_hex_byte(uint8_t byte) {
@@ -26,9 +28,45 @@ static void print_fat_filename(const char* name) {
     }
 }
 
+// Collects streamed chunks into a buffer and checks they arrive in order
+typedef struct {
+    uint8_t* buffer;
+    uint32_t capacity;
+    uint32_t received;
+    uint32_t chunks;
+    bool in_order;
+} stream_state;
+
+static int collect_chunk(const uint8_t* data, uint32_t length, uint32_t offset, void* context) {
+    stream_state* state = (stream_state*)context;
+    if (offset != state->received) {
+        state->in_order = false;
+    }
+    for (uint32_t i = 0; i < length && offset + i < state->capacity; i++) {
+        state->buffer[offset + i] = data[i];
+    }
+    state->received += length;
+    state->chunks++;
+    return 0;
+}
+
 // Test FAT32 filesystem driver functionality
+// Data written by the write test: several pieces crossing cluster boundaries
+#define WRITE_TEST_SIZE 9000
+static uint8_t write_pattern[WRITE_TEST_SIZE];
+static uint8_t write_readback[WRITE_TEST_SIZE];
+
+// Whole-file reads of TEST.TXT for the seek test, and the range and stream test
+#define READ_TEST_SIZE 4096
+static uint8_t first_read[READ_TEST_SIZE];
+static uint8_t second_read[READ_TEST_SIZE];
+static uint8_t full_read[READ_TEST_SIZE];
+static uint8_t range_read[READ_TEST_SIZE];
+static uint8_t streamed[READ_TEST_SIZE];
+
 int main(void) {
     uart_init();
+    mmu_init(); // Caches on, as in the bootloader
 
     uart_puts("=== FAT32 Filesystem Driver Test ===\n");
 
@@ -82,6 +120,7 @@ int main(void) {
     // Test 5: Open a test file
     uart_puts("\nTest 5: Opening file 'TEST.TXT'...\n");
     fat_file test_file;
+    bool test_file_open = false;
     char test_filename[11];
     format_filename("TEST.TXT", test_filename);
     
@@ -90,12 +129,16 @@ int main(void) {
         uart_puts("This is expected if the test disk doesn't have this file\n");
     } else {
         uart_puts("PASS - File opened successfully\n");
+        test_file_open = true;
         uart_puts("File size: ");
         print_hex32(test_file.file_size);
         uart_puts(" bytes\n");
         uart_puts("Start cluster: ");
         print_hex32(test_file.start_cluster);
         uart_putc('\n');
+        uart_puts("Extents: ");
+        uart_print_dec(test_file.extent_count);
+        uart_putc('\n');
 
         // Test 6: Read the file
         uart_puts("\nTest 6: Reading file contents...\n");
@@ -133,6 +176,264 @@ int main(void) {
     uart_puts("'\n");
     uart_puts("PASS - Edge case formatting completed\n");
 
+    // Test 8: Seek back to the start and read again
+    if (test_file_open) {
+        uart_puts("\nTest 8: Seeking to offset 0 and re-reading 'TEST.TXT'...\n");
+        if (test_file.file_size > sizeof(first_read)) {
+            uart_puts("SKIP - TEST.TXT is larger than the read buffers\n");
+        } else if (fat_seek(&test_file, 0) < 0 || fat_read(&test_file, first_read) < 0) {
+            uart_puts("FAIL - Could not seek or read\n");
+        } else if (test_file.current_cluster < FAT_END_OF_CHAIN) {
+            uart_puts("FAIL - Read stopped before the end of the chain\n");
+        } else if (fat_seek(&test_file, test_file.file_size + 1) == 0) {
+            uart_puts("FAIL - Seek past the end succeeded\n");
+        } else if (fat_seek(&test_file, 0) < 0 || fat_read(&test_file, second_read) < 0) {
+            uart_puts("FAIL - Could not read after a failed seek\n");
+        } else {
+            int seek_match = 1;
+            for (uint32_t i = 0; i < test_file.file_size; i++) {
+                if (first_read[i] != second_read[i]) {
+                    seek_match = 0;
+                    break;
+                }
+            }
+            if (seek_match) {
+                uart_puts("PASS - Both reads returned the same data\n");
+            } else {
+                uart_puts("FAIL - Reads after seeking differ\n");
+            }
+        }
+    }
+
+    // Test 9: Byte ranges and streaming return the same bytes as a full read
+    if (test_file_open) {
+        uart_puts("\nTest 9: Reading 'TEST.TXT' by byte range and as a stream...\n");
+        uint32_t size = test_file.file_size < sizeof(full_read) ? test_file.file_size : sizeof(full_read);
+        uint32_t middle = size / 3;
+
+        // A guard byte after the range catches reads past the requested length
+        range_read[size - middle] = 0xA5;
+        stream_state state = { streamed, sizeof(streamed), 0, 0, true };
+
+        if (fat_read_at(&test_file, 0, size, full_read) != (int)size) {
+            uart_puts("FAIL - Could not read the whole range\n");
+        } else if (fat_read_at(&test_file, middle, size - middle, range_read) != (int)(size - middle)) {
+            uart_puts("FAIL - Could not read from the middle\n");
+        } else if (fat_read_at(&test_file, test_file.file_size, 16, full_read) != 0) {
+            uart_puts("FAIL - Read at the end of the file returned data\n");
+        } else if (fat_read_stream(&test_file, collect_chunk, &state) < 0) {
+            uart_puts("FAIL - Streaming read failed\n");
+        } else {
+            int range_match = range_read[size - middle] == 0xA5;
+            for (uint32_t i = 0; i < size - middle && range_match; i++) {
+                range_match = range_read[i] == full_read[middle + i];
+            }
+            int stream_match = state.in_order && state.received == test_file.file_size;
+            for (uint32_t i = 0; i < size && stream_match; i++) {
+                stream_match = streamed[i] == full_read[i];
+            }
+
+            uart_puts("Streamed ");
+            uart_print_dec(state.received);
+            uart_puts(" bytes in ");
+            uart_print_dec(state.chunks);
+            uart_puts(" chunks\n");
+            if (range_match && stream_match) {
+                uart_puts("PASS - Byte range and stream match the full read\n");
+            } else {
+                uart_puts("FAIL - Byte range or stream data mismatch\n");
+            }
+        }
+    }
+
+    // Test 10: Path lookups, the second one served by the directory-entry cache
+    if (test_file_open) {
+        uart_puts("\nTest 10: Opening '/test.txt' by path twice...\n");
+        fat_file path_file;
+        fat_file missing_file;
+        bcache_stats stats;
+
+        if (fat_open_path("/test.txt", &path_file) < 0) {
+            uart_puts("FAIL - Could not open by path\n");
+        } else {
+            bcache_reset_stats();
+            int second = fat_open_path("/test.txt", &path_file);
+            bcache_get_stats(&stats);
+
+            if (second < 0 || path_file.start_cluster != test_file.start_cluster ||
+                path_file.file_size != test_file.file_size) {
+                uart_puts("FAIL - Path lookup found a different file\n");
+            } else if (stats.hits + stats.misses != 0) {
+                uart_puts("FAIL - Repeated lookup read directory blocks\n");
+            } else if (fat_open_path("/NOSUCH.TXT", &missing_file) == 0 ||
+                fat_open_path("/test.txt/x", &missing_file) == 0) {
+                uart_puts("FAIL - Invalid path opened\n");
+            } else {
+                uart_puts("PASS - Path lookup matches, repeat served from the cache\n");
+            }
+        }
+    }
+
+    // Test 11: List the root directory
+    uart_puts("\nTest 11: Listing the root directory...\n");
+    fat_dir root;
+    if (fat_opendir("/", &root) < 0) {
+        uart_puts("FAIL - Could not open the root directory\n");
+    } else {
+        fat_dirent dirent;
+        uint32_t entries = 0;
+        bool found_test_file = false;
+        int result;
+        while ((result = fat_readdir(&root, &dirent)) > 0) {
+            uart_puts(dirent.is_directory ? "  <DIR> " : "        ");
+            uart_puts(dirent.name);
+            uart_putc('\n');
+            if (!dirent.is_directory && test_file_open &&
+                dirent.first_cluster == test_file.start_cluster) {
+                found_test_file = true;
+            }
+            entries++;
+        }
+
+        if (result < 0) {
+            uart_puts("FAIL - Directory read failed\n");
+        } else if (test_file_open && !found_test_file) {
+            uart_puts("FAIL - TEST.TXT missing from the listing\n");
+        } else if (fat_opendir("/TEST.TXT", &root) == 0) {
+            uart_puts("FAIL - Opened a file as a directory\n");
+        } else {
+            uart_puts("PASS - Listed ");
+            uart_print_dec(entries);
+            uart_puts(" entries\n");
+        }
+    }
+
+    // Test 12: Create a file, append to it, read it back and truncate it
+    uart_puts("\nTest 12: Writing /WRITE.TXT...\n");
+    fat_file write_file;
+    // A file left by an earlier run is emptied and reused
+    int write_ready = fat_open_path("/WRITE.TXT", &write_file) == 0
+        ? fat_truncate(&write_file, 0)
+        : fat_create("/WRITE.TXT", &write_file);
+    for (uint32_t i = 0; i < WRITE_TEST_SIZE; i++) {
+        write_pattern[i] = (uint8_t)(i * 7 + 1);
+    }
+
+    if (write_ready < 0) {
+        uart_puts("FAIL - Could not create the file\n");
+    } else if (fat_append(&write_file, write_pattern, 100) < 0 ||
+        fat_append(&write_file, write_pattern + 100, 4000) < 0 ||
+        fat_append(&write_file, write_pattern + 4100, WRITE_TEST_SIZE - 4100) < 0 ||
+        fat_sync() < 0) {
+        uart_puts("FAIL - Append failed\n");
+    } else {
+        fat_file reopened;
+        int read_bytes = fat_open_path("/WRITE.TXT", &reopened) < 0
+            ? -1
+            : fat_read_at(&reopened, 0, WRITE_TEST_SIZE, write_readback);
+
+        bool write_match = read_bytes == WRITE_TEST_SIZE && reopened.file_size == WRITE_TEST_SIZE;
+        for (uint32_t i = 0; write_match && i < WRITE_TEST_SIZE; i++) {
+            write_match = write_readback[i] == write_pattern[i];
+        }
+
+        if (!write_match) {
+            uart_puts("FAIL - Data read back does not match\n");
+        } else if (fat_truncate(&write_file, 1000) < 0 || fat_sync() < 0 ||
+            fat_open_path("/WRITE.TXT", &reopened) < 0 || reopened.file_size != 1000) {
+            uart_puts("FAIL - Truncate failed\n");
+        } else {
+            uart_puts("PASS - Wrote, read back and truncated ");
+            uart_print_dec(WRITE_TEST_SIZE);
+            uart_puts(" bytes\n");
+        }
+    }
+
+    // Test 13: Small sequential reads grow the readahead window
+    uart_puts("\nTest 13: Reading /WRITE.TXT in 100-byte pieces...\n");
+    fat_file sequential_file;
+    if (fat_open_path("/WRITE.TXT", &sequential_file) < 0 || sequential_file.file_size == 0) {
+        uart_puts("INFO - /WRITE.TXT not available, skipping\n");
+    } else {
+        bool sequential_match = true;
+        uint32_t offset = 0;
+        while (offset < sequential_file.file_size) {
+            int count = fat_read_at(&sequential_file, offset, 100, write_readback);
+            if (count <= 0) {
+                sequential_match = false;
+                break;
+            }
+            for (int i = 0; i < count; i++) {
+                sequential_match = sequential_match && write_readback[i] == write_pattern[offset + i];
+            }
+            offset += (uint32_t)count;
+        }
+
+        uart_puts("Readahead window: ");
+        uart_print_dec(sequential_file.readahead_window);
+        uart_puts(" bytes\n");
+        if (!sequential_match) {
+            uart_puts("FAIL - Sequential reads returned wrong data\n");
+        } else if (sequential_file.readahead_window == 0) {
+            uart_puts("FAIL - Sequential reads were not detected\n");
+        } else {
+            uart_puts("PASS - Sequential reads matched with readahead\n");
+        }
+    }
+
+    // Test 14: Map /WRITE.TXT in place and compare it with what was written
+    uart_puts("\nTest 14: Mapping /WRITE.TXT without copying...\n");
+    fat_file mapped_file;
+    if (fat_open_path("/WRITE.TXT", &mapped_file) < 0 || mapped_file.file_size == 0) {
+        uart_puts("INFO - /WRITE.TXT not available, skipping\n");
+    } else {
+        bool map_match = true;
+        uint32_t views = 0;
+        uint32_t offset = 0;
+        fat_view view;
+        int count;
+        while ((count = fat_map(&mapped_file, offset, mapped_file.file_size, &view)) > 0) {
+            for (int i = 0; i < count; i++) {
+                map_match = map_match && view.data[i] == write_pattern[offset + i];
+            }
+            fat_unmap(&view);
+            offset += (uint32_t)count;
+            views++;
+        }
+
+        if (count < 0 || offset != mapped_file.file_size) {
+            uart_puts("FAIL - Mapping failed\n");
+        } else if (!map_match) {
+            uart_puts("FAIL - Mapped data does not match\n");
+        } else {
+            uart_puts("PASS - Mapped the file in ");
+            uart_print_dec(views);
+            uart_puts(" views\n");
+        }
+    }
+
+    // Test 15: Names that do not fit 8.3 are refused, not truncated
+    uart_puts("\nTest 15: Creating files with invalid names...\n");
+    static const char* const bad_names[] = {
+        "/ABCDEFGHIJ", "/A.TEXT", "/A.B.C", "/.TXT", "/A.", "/A B.TXT", "/A*.TXT", "/"
+    };
+    bool all_refused = true;
+    for (uint32_t i = 0; i < sizeof(bad_names) / sizeof(bad_names[0]); i++) {
+        fat_file bad_file;
+        if (fat_create(bad_names[i], &bad_file) == 0) {
+            uart_puts("Created ");
+            uart_puts(bad_names[i]);
+            uart_putc('\n');
+            all_refused = false;
+        }
+    }
+    fat_file truncated_file;
+    if (all_refused && fat_open_path("/ABCDEFGH", &truncated_file) < 0) {
+        uart_puts("PASS - Every invalid name was refused\n");
+    } else {
+        uart_puts("FAIL - An invalid name was accepted\n");
+    }
+
     uart_puts("\n=== All FAT32 Tests Completed ===\n");
     
     return 0;
@@ -0,0 +1,138 @@
+#include "../uart/uart.h"
+#include "../timer/timer.h"
+#include "../mmu/mmu.h"
+
+#define WORK_WORDS 4096 // 16 KB, fits the L1 data cache
+#define WORK_PASSES 64
+
+static volatile uint32_t work_buffer[WORK_WORDS] __attribute__((aligned(64)));
+static volatile uint32_t uncached_buffer[16] MMU_UNCACHED;
+
+static inline uint64_t read_sctlr(void) {
+    uint64_t value;
+    __asm__ volatile("mrs %0, sctlr_el1" : "=r"(value));
+    return value;
+}
+
+// Memory attributes (MAIR encoding) a read of address translates with, or 0 if it faults
+static uint8_t translated_attributes(const volatile void* address) {
+    uint64_t par;
+    __asm__ volatile("at s1e1r, %1\n isb\n mrs %0, par_el1" : "=r"(par) : "r"(address) : "memory");
+    return (par & 1) ? 0 : (uint8_t)(par >> 56);
+}
+
+// Repeatedly read and write the buffer; returns elapsed counter ticks
+static uint64_t time_work(void) {
+    uint64_t start = timer_now();
+    for (uint32_t pass = 0; pass < WORK_PASSES; pass++) {
+        for (uint32_t i = 0; i < WORK_WORDS; i++) {
+            work_buffer[i] = work_buffer[i] + i + pass;
+        }
+    }
+    return timer_now() - start;
+}
+
+static void fill_pattern(uint32_t seed) {
+    for (uint32_t i = 0; i < WORK_WORDS; i++) {
+        work_buffer[i] = i * 2654435761u + seed;
+    }
+}
+
+static bool check_pattern(uint32_t seed) {
+    for (uint32_t i = 0; i < WORK_WORDS; i++) {
+        if (work_buffer[i] != i * 2654435761u + seed) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Test the identity map and cache maintenance
+int main(void) {
+    uart_init();
+
+    uart_puts("=== MMU Test ===\n");
+
+    // Test 1: Baseline with the MMU and caches off
+    uart_puts("Test 1: Timing a memory loop with caches off...\n");
+    if (mmu_is_enabled() || (read_sctlr() & MMU_SCTLR_M) != 0) {
+        uart_puts("FAIL - MMU already on at startup\n");
+        return -1;
+    }
+    uint64_t uncached_ticks = time_work();
+    uart_puts("Ticks: ");
+    uart_print_dec((uint32_t)uncached_ticks);
+    uart_puts("\nPASS - Baseline measured\n");
+
+    // Test 2: Turning the MMU on; printing at all means the UART is still mapped
+    uart_puts("\nTest 2: Enabling the MMU and caches...\n");
+    mmu_init();
+    uint64_t sctlr = read_sctlr();
+    uint64_t wanted = MMU_SCTLR_M | MMU_SCTLR_C | MMU_SCTLR_I;
+    if (mmu_is_enabled() && (sctlr & wanted) == wanted) {
+        uart_puts("PASS - SCTLR_EL1 M, C and I set\n");
+    } else {
+        uart_puts("FAIL - SCTLR_EL1 = ");
+        uart_print_hex(sctlr);
+        uart_putc('\n');
+    }
+
+    // Test 3: The same loop with caches on
+    uart_puts("\nTest 3: Timing the memory loop with caches on...\n");
+    uint64_t cached_ticks = time_work();
+    uart_puts("Ticks: ");
+    uart_print_dec((uint32_t)cached_ticks);
+    if (cached_ticks > 0) {
+        uart_puts(", speedup: ");
+        uart_print_dec((uint32_t)(uncached_ticks / cached_ticks));
+        uart_putc('x');
+    }
+    uart_putc('\n');
+    if (cached_ticks < uncached_ticks) {
+        uart_puts("PASS - Cached loop is faster\n");
+    } else {
+        uart_puts("FAIL - Caches made no difference\n");
+    }
+
+    // Test 4: Range maintenance keeps data intact
+    uart_puts("\nTest 4: Cleaning and invalidating a buffer...\n");
+    fill_pattern(1);
+    mmu_clean_range((const void*)work_buffer, sizeof(work_buffer));
+    bool clean_intact = check_pattern(1);
+    fill_pattern(2);
+    mmu_clean_invalidate_range((const void*)work_buffer, sizeof(work_buffer));
+    bool invalidate_intact = check_pattern(2);
+    if (clean_intact && invalidate_intact) {
+        uart_puts("PASS - Data survived clean and clean+invalidate\n");
+    } else {
+        uart_puts("FAIL - Data lost during maintenance\n");
+    }
+
+    // Test 5: The uncached section is Normal Non-cacheable, the rest of its gigabyte write-back
+    uart_puts("\nTest 5: Translating uncached and cached addresses...\n");
+    uint8_t uncached_attributes = translated_attributes(uncached_buffer);
+    uint8_t cached_attributes = translated_attributes(work_buffer);
+    if (uncached_attributes == 0x44 && cached_attributes == 0xFF) {
+        uart_puts("PASS - MMU_UNCACHED memory bypasses the caches\n");
+    } else {
+        uart_puts("FAIL - Attributes 0x");
+        uart_print_hex(uncached_attributes);
+        uart_puts(" uncached, 0x");
+        uart_print_hex(cached_attributes);
+        uart_puts(" cached\n");
+    }
+
+    // Test 6: Turning the MMU off writes dirty lines back
+    uart_puts("\nTest 6: Disabling the MMU and caches...\n");
+    fill_pattern(3);
+    mmu_disable();
+    if (!mmu_is_enabled() && (read_sctlr() & wanted) == 0 && check_pattern(3)) {
+        uart_puts("PASS - MMU off and dirty data reached memory\n");
+    } else {
+        uart_puts("FAIL - MMU still on or data lost\n");
+    }
+
+    uart_puts("\n=== All MMU Tests Completed ===\n");
+
+    return 0;
+}
@@ -0,0 +1,89 @@
+#include "../uart/uart.h"
+#include "../mmu/mmu.h"
+#include "../timer/timer.h"
+#include "../trace/trace.h"
+
+#if !TRACE_ENABLED
+#error "test_trace.c must be built with TRACE_ENABLED=1"
+#endif
+
+#define COST_EVENTS 10000
+
+static trace_record records[TRACE_RING_RECORDS];
+
+// Test the binary trace ring
+int main(void) {
+    uart_init();
+    mmu_init(); // Caches on, as in the bootloader
+
+    uart_puts("=== Trace Test ===\n");
+
+    // Test 1: Records come back in order with their arguments
+    uart_puts("Test 1: Emitting three events...\n");
+    trace_reset();
+    bool empty = trace_copy(records, TRACE_RING_RECORDS) == 0;
+    TRACE(TRACE_FAT_FETCH, 2048, 8);
+    TRACE(TRACE_FAT_CLUSTER, 5, 12);
+    TRACE(TRACE_USER + 1, 0xDEADBEEF, 7);
+    uint32_t count = trace_copy(records, TRACE_RING_RECORDS);
+    if (empty && count == 3 &&
+        records[0].event == TRACE_FAT_FETCH && records[0].arg0 == 2048 && records[0].arg1 == 8 &&
+        records[1].event == TRACE_FAT_CLUSTER && records[1].arg0 == 5 && records[1].arg1 == 12 &&
+        records[2].event == TRACE_USER + 1 && records[2].arg0 == 0xDEADBEEF && records[2].cpu == 0 &&
+        records[1].time - records[0].time < 0x80000000u && records[2].time - records[1].time < 0x80000000u) {
+        uart_puts("PASS - Events recorded in order\n");
+    } else {
+        uart_puts("FAIL - Unexpected records\n");
+    }
+
+    // Test 2: A full ring keeps the newest records
+    uart_puts("\nTest 2: Emitting 100 more events than the ring holds...\n");
+    trace_reset();
+    for (uint32_t i = 0; i < TRACE_RING_RECORDS + 100; i++) {
+        TRACE(TRACE_USER, i, 0);
+    }
+    count = trace_copy(records, TRACE_RING_RECORDS);
+    bool kept = count == TRACE_RING_RECORDS && records[0].arg0 == 100 &&
+        records[TRACE_RING_RECORDS - 1].arg0 == TRACE_RING_RECORDS + 99;
+    count = trace_copy(records, 4);
+    bool newest = count == 4 && records[0].arg0 == TRACE_RING_RECORDS + 96;
+    if (kept && newest) {
+        uart_puts("PASS - Oldest records overwritten\n");
+    } else {
+        uart_puts("FAIL - Wrong records kept\n");
+    }
+
+    // Test 3: Cost of an event, against a line of debug output
+    uart_puts("\nTest 3: Timing 10000 events...\n");
+    uint64_t start = timer_now();
+    for (uint32_t i = 0; i < COST_EVENTS; i++) {
+        TRACE(TRACE_USER, i, i);
+    }
+    uint64_t event_ns = timer_ticks_to_us((timer_now() - start) * 1000) / COST_EVENTS;
+    start = timer_now();
+    uart_puts("DEBUG fat_read: Read complete\n");
+    uint64_t line_ns = timer_ticks_to_us((timer_now() - start) * 1000);
+    uart_puts("Event: ");
+    uart_print_dec((uint32_t)event_ns);
+    uart_puts(" ns, debug line: ");
+    uart_print_dec((uint32_t)line_ns);
+    uart_puts(" ns\n");
+    if (event_ns < 1000) {
+        uart_puts("PASS - Event cost is below a microsecond\n");
+    } else {
+        uart_puts("FAIL - Events too slow for the hot path\n");
+    }
+
+    // Test 4: Dump for the host decoder
+    uart_puts("\nTest 4: Dumping a short trace...\n");
+    trace_reset();
+    TRACE(TRACE_VIO_READ, 2048, 8 << 8 | 3);
+    TRACE(TRACE_VIO_COMPLETE, 3, 0);
+    TRACE(TRACE_FAT_CLUSTER, 5, 12);
+    trace_dump();
+    uart_puts("PASS - Dump printed; decode the log with scripts/tracedecode.py\n");
+
+    uart_puts("\n=== All Trace Tests Completed ===\n");
+
+    return 0;
+}
@@ -1,4 +1,6 @@
 #include "../uart/uart.h"
+#include "../irq/irq.h"
+#include "../mmu/mmu.h"
 #include "../filesystem/vio/vio.h"
 
 // Helper function to print a byte in hex
@@ -19,11 +21,13 @@ static void print_hex32(uint32_t value) {
 // Test VirtIO block driver functionality
 int main(void) {
     uart_init();
+    mmu_init(); // Caches on, as in the bootloader
 
     uart_puts("=== VirtIO Block Driver Test ===\n");
 
-    // Test 1: Initialize VirtIO device
+    // Test 1: Initialize VirtIO device (interrupt-driven completions)
     uart_puts("Test 1: Initializing VirtIO device...\n");
+    irq_init();
     if (vio_init() < 0) {
         uart_puts("FAIL - VirtIO initialization failed\n");
         return -1;
@@ -55,6 +59,20 @@ int main(void) {
     }
     uart_puts("PASS - Multiple sectors read successfully\n");
 
+    // The single multi-sector request must return the same data as sector 0 read alone
+    int multi_match = 1;
+    for (int i = 0; i < 512; i++) {
+        if (multi_sector_buffer[i] != sector_buffer[i]) {
+            multi_match = 0;
+            break;
+        }
+    }
+    if (multi_match) {
+        uart_puts("PASS - Multi-sector data matches single-sector read\n");
+    } else {
+        uart_puts("FAIL - Multi-sector data does not match single-sector read\n");
+    }
+
     // Test 4: Read a different sector
     uart_puts("\nTest 4: Reading sector 1...\n");
     if (vio_read_sector(1, sector_buffer) < 0) {
@@ -73,6 +91,138 @@ int main(void) {
         }
     }
 
+    // Test 5: Several asynchronous requests in flight at once
+    uart_puts("\nTest 5: Submitting asynchronous reads (sectors 0 and 1)...\n");
+    uint8_t async_buffer_0[512];
+    uint8_t async_buffer_1[512];
+    int request_0 = vio_submit_read(0, 1, async_buffer_0);
+    int request_1 = vio_submit_read(1, 1, async_buffer_1);
+    if (request_0 < 0 || request_1 < 0) {
+        uart_puts("FAIL - Could not submit asynchronous reads\n");
+        return -1;
+    }
+    // Collect out of order to exercise used ring reaping by descriptor id
+    if (vio_wait(request_1) < 0 || vio_wait(request_0) < 0) {
+        uart_puts("FAIL - Asynchronous reads did not complete\n");
+        return -1;
+    }
+    int async_match = 1;
+    for (int i = 0; i < 512; i++) {
+        if (async_buffer_0[i] != multi_sector_buffer[i] ||
+            async_buffer_1[i] != multi_sector_buffer[512 + i]) {
+            async_match = 0;
+            break;
+        }
+    }
+    if (async_match) {
+        uart_puts("PASS - Asynchronous reads match synchronous reads\n");
+    } else {
+        uart_puts("FAIL - Asynchronous read data mismatch\n");
+    }
+
+    // Test 6: Opt-in polling mode returns the same data
+    uart_puts("\nTest 6: Reading sector 0 in polling mode...\n");
+    vio_set_polling(true);
+    if (vio_read_sector(0, async_buffer_0) < 0) {
+        uart_puts("FAIL - Polling read failed\n");
+        return -1;
+    }
+    vio_set_polling(false);
+    int polling_match = 1;
+    for (int i = 0; i < 512; i++) {
+        if (async_buffer_0[i] != multi_sector_buffer[i]) {
+            polling_match = 0;
+            break;
+        }
+    }
+    if (polling_match) {
+        uart_puts("PASS - Polling read matches interrupt-driven read\n");
+    } else {
+        uart_puts("FAIL - Polling read data mismatch\n");
+    }
+
+    // Test 7: Scatter-gather read into discontiguous buffers
+    uart_puts("\nTest 7: Reading sectors 0-1 into two buffers (100 + 924 bytes)...\n");
+    uint8_t head_buffer[100];
+    uint8_t tail_buffer[924];
+    vio_iovec iov[2] = {
+        { head_buffer, sizeof(head_buffer) },
+        { tail_buffer, sizeof(tail_buffer) },
+    };
+    if (vio_readv(0, iov, 2) < 0) {
+        uart_puts("FAIL - Scatter-gather read failed\n");
+        return -1;
+    }
+    int readv_match = 1;
+    for (int i = 0; i < 1024; i++) {
+        uint8_t value = i < 100 ? head_buffer[i] : tail_buffer[i - 100];
+        if (value != multi_sector_buffer[i]) {
+            readv_match = 0;
+            break;
+        }
+    }
+    if (readv_match) {
+        uart_puts("PASS - Scatter-gather data matches contiguous read\n");
+    } else {
+        uart_puts("FAIL - Scatter-gather data mismatch\n");
+    }
+
+    // Test 8: Coalesced writes, visible to reads before and after the flush
+    // Sectors 1000-1007 lie between the MBR and the partition, which starts at 2048
+    uart_puts("\nTest 8: Writing sectors 1000-1007 one at a time, then flushing...\n");
+    uint8_t write_buffer[512];
+    for (uint32_t sector = 0; sector < 8; sector++) {
+        for (int i = 0; i < 512; i++) {
+            write_buffer[i] = (uint8_t)(sector * 31 + i);
+        }
+        if (vio_write_sectors(1000 + sector, 1, write_buffer) < 0) {
+            uart_puts("FAIL - Write failed\n");
+            return -1;
+        }
+    }
+
+    // The writes are still staged; the read has to push them out first
+    uint8_t written_buffer[512 * 8];
+    if (vio_read_sectors(1000, 8, written_buffer) < 0) {
+        uart_puts("FAIL - Could not read back staged writes\n");
+        return -1;
+    }
+    if (vio_flush() < 0) {
+        uart_puts("FAIL - Flush failed\n");
+        return -1;
+    }
+    int write_match = 1;
+    for (uint32_t sector = 0; sector < 8 && write_match; sector++) {
+        for (int i = 0; i < 512; i++) {
+            if (written_buffer[sector * 512 + i] != (uint8_t)(sector * 31 + i)) {
+                write_match = 0;
+                break;
+            }
+        }
+    }
+    if (write_match) {
+        uart_puts("PASS - Written sectors read back correctly\n");
+    } else {
+        uart_puts("FAIL - Written data mismatch\n");
+    }
+
+    // Test 9: Request counters
+    uart_puts("\nTest 9: Counting a 4-sector read...\n");
+    vio_stats before;
+    vio_stats after;
+    vio_get_stats(&before);
+    if (vio_read_sectors(0, 4, written_buffer) < 0) {
+        uart_puts("FAIL - Could not read sectors 0-3\n");
+        return -1;
+    }
+    vio_get_stats(&after);
+    if (after.requests - before.requests == 1 && after.sectors_read - before.sectors_read == 4 &&
+        after.sectors_written == before.sectors_written) {
+        uart_puts("PASS - 1 request, 4 sectors read\n");
+    } else {
+        uart_puts("FAIL - Unexpected counters\n");
+    }
+
     uart_puts("\n=== All VirtIO Tests Completed ===\n");
     
     return 0;
@@ -0,0 +1,156 @@
+#include "timer.h"
+#include "uart.h"
+#include "trace.h"
+#include "string.h"
+
+// Width of the phase name column; the longest name still gets a space after it
+#define TIMER_NAME_COLUMN TIMER_PHASE_NAME_SIZE
+
+// Helper functions
+
+static uint32_t decimal_digits(uint64_t value) {
+    uint32_t digits = 1;
+    while (value >= 10) {
+        value /= 10;
+        digits++;
+    }
+    return digits;
+}
+
+static void print_spaces(uint32_t count) {
+    while (count-- > 0) {
+        uart_putc(' ');
+    }
+}
+
+// uart_print_dec() right-aligned in a column; values never exceed 32 bits here
+static void print_column(uint64_t value, uint32_t width) {
+    uint32_t digits = decimal_digits(value);
+    print_spaces(digits < width ? width - digits : 0);
+    uart_print_dec((uint32_t)value);
+}
+
+static void print_name(const char* name) {
+    uart_puts(name);
+    uint32_t length = (uint32_t)strlen(name);
+    print_spaces(length < TIMER_NAME_COLUMN ? TIMER_NAME_COLUMN - length : 0);
+}
+
+// Disk throughput in MB/s with one decimal
+static void print_throughput(uint32_t sectors, uint64_t microseconds) {
+    if (sectors == 0 || microseconds == 0) {
+        print_spaces(9);
+        uart_putc('-');
+        return;
+    }
+    uint64_t tenths = (uint64_t)sectors * 512 * 10 / microseconds; // Bytes per us is MB/s
+    print_column(tenths / 10, 8);
+    uart_putc('.');
+    uart_putc((char)('0' + tenths % 10));
+}
+
+// Library functions
+
+uint64_t timer_ticks_to_us(uint64_t ticks) {
+    uint64_t frequency = timer_frequency();
+    if (frequency == 0) {
+        return 0;
+    }
+    // Split so ticks * 1000000 cannot overflow
+    return ticks / frequency * 1000000 + ticks % frequency * 1000000 / frequency;
+}
+
+void timer_timeline_init(timer_timeline* timeline) {
+    memset(timeline, 0, sizeof(*timeline));
+    timeline->magic = TIMER_TIMELINE_MAGIC;
+    timeline->frequency = timer_frequency();
+}
+
+bool timer_timeline_adopt(timer_timeline* timeline, const timer_timeline* previous) {
+    if (previous == NULL || previous->magic != TIMER_TIMELINE_MAGIC ||
+        previous->phase_count > TIMER_MAX_PHASES || previous->frequency != timer_frequency()) {
+        timer_timeline_init(timeline);
+        return false;
+    }
+
+    memcpy(timeline, previous, sizeof(*timeline));
+    return true;
+}
+
+int timer_mark(timer_timeline* timeline, const char* name, uint32_t requests, uint32_t sectors) {
+    uint64_t now = timer_now();
+
+    if (timeline->phase_count > 0) {
+        timer_phase* running = &timeline->phases[timeline->phase_count - 1];
+        if (running->end == 0) {
+            running->end = now;
+            running->requests += requests;
+            running->sectors += sectors;
+        }
+    }
+
+    if (name == NULL) {
+        TRACE(TRACE_PHASE, 0xFFFFFFFF, 0);
+        return 0;
+    }
+    if (timeline->phase_count == TIMER_MAX_PHASES) {
+        return -1;
+    }
+
+    timer_phase* phase = &timeline->phases[timeline->phase_count++];
+    memset(phase, 0, sizeof(*phase));
+    phase->start = now;
+    for (uint32_t i = 0; i < TIMER_PHASE_NAME_SIZE - 1 && name[i] != '\0'; i++) {
+        phase->name[i] = name[i];
+    }
+
+    // The first four characters name the phase in the trace
+    uint32_t tag = 0;
+    for (uint32_t i = 0; i < 4 && phase->name[i] != '\0'; i++) {
+        tag |= (uint32_t)(uint8_t)phase->name[i] << (8 * i);
+    }
+    TRACE(TRACE_PHASE, timeline->phase_count - 1, tag);
+
+    return 0;
+}
+
+void timer_timeline_print(const timer_timeline* timeline) {
+    uart_puts("    Phase                us  Requests   Sectors      MB/s\n\r");
+
+    uint64_t total = 0;
+    uint32_t total_requests = 0;
+    uint32_t total_sectors = 0;
+    for (uint32_t i = 0; i < timeline->phase_count; i++) {
+        const timer_phase* phase = &timeline->phases[i];
+        if (phase->end == 0) {
+            continue; // Still running
+        }
+
+        uint64_t microseconds = timer_ticks_to_us(phase->end - phase->start);
+        uart_puts("    ");
+        print_name(phase->name);
+        print_column(microseconds, 7);
+        print_column(phase->requests, 10);
+        print_column(phase->sectors, 10);
+        print_throughput(phase->sectors, microseconds);
+        uart_puts("\n\r");
+
+        total += microseconds;
+        total_requests += phase->requests;
+        total_sectors += phase->sectors;
+    }
+
+    uart_puts("    ");
+    print_name("total");
+    print_column(total, 7);
+    print_column(total_requests, 10);
+    print_column(total_sectors, 10);
+    print_throughput(total_sectors, total);
+    uart_puts("\n\r");
+
+    if (timeline->phase_count > 0) {
+        uart_puts("    First phase started ");
+        uart_print_dec((uint32_t)timer_ticks_to_us(timeline->phases[0].start));
+        uart_puts(" us after power-on\n\r");
+    }
+}
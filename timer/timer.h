@@ -0,0 +1,109 @@
+#ifndef TIMER_H
+#define TIMER_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Timing from the ARM generic timer's virtual counter (CNTVCT_EL0), which
+// counts from power-on at CNTFRQ_EL0 ticks per second on every core.
+//
+// A timeline splits time into back-to-back phases: each timer_mark() ends the
+// running phase and starts the next. The bootloader passes its timeline to the
+// kernel in x0, and the kernel carries on with it after timer_timeline_adopt().
+
+#define TIMER_TIMELINE_MAGIC 0x454E4C54 // "TLNE" as a little-endian word
+#define TIMER_MAX_PHASES 16
+#define TIMER_PHASE_NAME_SIZE 16 // Including the terminator
+
+typedef struct {
+    uint64_t start; // Counter value when the phase started
+    uint64_t end; // Counter value when it ended, 0 while it runs
+    uint32_t requests; // Disk requests issued during the phase
+    uint32_t sectors; // Disk sectors read or written during the phase
+    char name[TIMER_PHASE_NAME_SIZE];
+} timer_phase;
+
+// Plain data only, so it stays valid when handed to another program
+typedef struct {
+    uint32_t magic; // TIMER_TIMELINE_MAGIC
+    uint32_t phase_count;
+    uint64_t frequency; // CNTFRQ_EL0 when the timeline was started
+    timer_phase phases[TIMER_MAX_PHASES];
+} timer_timeline;
+
+/**
+ * @brief Reads the virtual counter.
+ *
+ * @return Ticks since power-on.
+ */
+static inline uint64_t timer_now(void) {
+    uint64_t value;
+    asm volatile("isb\n mrs %0, cntvct_el0" : "=r"(value) : : "memory");
+    return value;
+}
+
+/**
+ * @brief Reads the counter frequency set up by the firmware.
+ *
+ * @return Ticks per second.
+ */
+static inline uint64_t timer_frequency(void) {
+    uint64_t value;
+    asm volatile("mrs %0, cntfrq_el0" : "=r"(value));
+    return value;
+}
+
+/**
+ * @brief Converts counter ticks to microseconds.
+ *
+ * @param ticks A number of ticks, e.g. the difference of two timer_now() values.
+ * @return The same time in microseconds.
+ */
+uint64_t timer_ticks_to_us(uint64_t ticks);
+
+/**
+ * @brief Starts an empty timeline.
+ *
+ * @param timeline The timeline to set up.
+ */
+void timer_timeline_init(timer_timeline* timeline);
+
+/**
+ * @brief Continues a timeline started by an earlier boot stage.
+ *
+ * The other stage's timeline is copied, so its memory may be reused
+ * afterwards. If it is not a timeline (wrong magic, phase count or counter
+ * frequency), an empty one is started instead.
+ *
+ * @param timeline The timeline to set up.
+ * @param previous The earlier stage's timeline, e.g. the pointer the bootloader
+ *                 passes in x0; may be NULL. Must be readable.
+ * @return true if the earlier timeline was adopted, false if an empty one was started.
+ */
+bool timer_timeline_adopt(timer_timeline* timeline, const timer_timeline* previous);
+
+/**
+ * @brief Ends the running phase and starts the next one.
+ *
+ * @param timeline The timeline.
+ * @param name Name of the phase that starts now (truncated to fit), or NULL to
+ *             only end the running one.
+ * @param requests Disk requests issued since the last mark, added to the phase that ends.
+ * @param sectors Disk sectors read or written since the last mark, added to the phase that ends.
+ * @return 0 on success, -1 if the timeline is full (the running phase still ends).
+ */
+int timer_mark(timer_timeline* timeline, const char* name, uint32_t requests, uint32_t sectors);
+
+/**
+ * @brief Prints the finished phases as a table over the UART.
+ *
+ * One line per phase with its time in microseconds, the disk requests and
+ * sectors it issued and the disk throughput in MB/s, then the total and the
+ * time since power-on. A phase still running is left out.
+ *
+ * @param timeline The timeline.
+ */
+void timer_timeline_print(const timer_timeline* timeline);
+
+#endif
@@ -0,0 +1,114 @@
+#include "trace.h"
+
+#if TRACE_ENABLED
+
+#include "uart.h"
+#include "smp.h"
+#include "mmu.h"
+#include "irq.h"
+
+_Static_assert((TRACE_RING_RECORDS & (TRACE_RING_RECORDS - 1)) == 0, "TRACE_RING_RECORDS must be a power of 2");
+_Static_assert(sizeof(trace_record) == 16, "trace_record must stay 16 bytes for the decoder");
+
+static trace_record trace_ring[TRACE_RING_RECORDS] __attribute__((aligned(64)));
+
+// Records ever emitted; record n lives at n % TRACE_RING_RECORDS
+static volatile uint64_t trace_head;
+
+// Helper functions
+
+// Claims the next record slot, atomically across cores and IRQ handlers.
+// Exclusives need Normal memory; with the MMU off only the boot core runs,
+// so masking IRQs around a plain increment is enough.
+static inline uint64_t claim_slot(void) {
+    if (!mmu_is_enabled()) {
+        uint64_t daif = irq_save();
+        uint64_t slot = trace_head;
+        trace_head = slot + 1;
+        irq_restore(daif);
+        return slot;
+    }
+
+    uint64_t slot;
+    uint64_t next;
+    uint32_t failed;
+    asm volatile(
+        "1: ldxr %0, [%3]\n"
+        "   add %1, %0, #1\n"
+        "   stxr %w2, %1, [%3]\n"
+        "   cbnz %w2, 1b\n"
+        : "=&r"(slot), "=&r"(next), "=&r"(failed)
+        : "r"(&trace_head)
+        : "memory");
+    return slot;
+}
+
+// No ISB before the read as timer_now() has: a record may be stamped a few
+// instructions early, which is well below what the trace resolves
+static inline uint32_t counter_low(void) {
+    uint64_t value;
+    asm volatile("mrs %0, cntvct_el0" : "=r"(value));
+    return (uint32_t)value;
+}
+
+static void print_hex_byte(uint8_t value) {
+    static const char hex_chars[] = "0123456789abcdef";
+    uart_putc(hex_chars[value >> 4]);
+    uart_putc(hex_chars[value & 0xF]);
+}
+
+// Library functions
+
+void trace_emit(uint16_t event, uint32_t arg0, uint32_t arg1) {
+    trace_record* record = &trace_ring[claim_slot() & (TRACE_RING_RECORDS - 1)];
+    record->time = counter_low();
+    record->event = event;
+    record->cpu = (uint16_t)smp_cpu_id();
+    record->arg0 = arg0;
+    record->arg1 = arg1;
+}
+
+void trace_reset(void) {
+    trace_head = 0;
+}
+
+uint32_t trace_copy(trace_record* records, uint32_t capacity) {
+    uint64_t head = trace_head;
+    uint64_t first = head > TRACE_RING_RECORDS ? head - TRACE_RING_RECORDS : 0;
+    if (head - first > capacity) {
+        first = head - capacity; // Keep the newest
+    }
+
+    uint32_t count = 0;
+    for (uint64_t n = first; n < head; n++) {
+        records[count++] = trace_ring[n & (TRACE_RING_RECORDS - 1)];
+    }
+    return count;
+}
+
+void trace_dump(void) {
+    uint64_t head = trace_head;
+    uint64_t first = head > TRACE_RING_RECORDS ? head - TRACE_RING_RECORDS : 0;
+    uint64_t frequency;
+    asm volatile("mrs %0, cntfrq_el0" : "=r"(frequency));
+
+    uart_puts("\n\r" TRACE_DUMP_BEGIN " frequency=");
+    uart_print_dec((uint32_t)frequency);
+    uart_puts(" records=");
+    uart_print_dec((uint32_t)(head - first));
+    uart_puts(" dropped=");
+    uart_print_dec((uint32_t)first);
+    uart_puts("\n\r");
+
+    for (uint64_t n = first; n < head; n++) {
+        const uint8_t* bytes = (const uint8_t*)&trace_ring[n & (TRACE_RING_RECORDS - 1)];
+        for (uint32_t i = 0; i < sizeof(trace_record); i++) {
+            print_hex_byte(bytes[i]);
+        }
+        uart_puts("\n\r");
+    }
+
+    uart_puts(TRACE_DUMP_END "\n\r");
+}
+
+#endif
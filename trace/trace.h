@@ -0,0 +1,109 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Binary event trace: a fixed-size ring of 16-byte records in memory, cheap
+// enough to leave in the disk and filesystem hot paths where a uart_puts()
+// would change the timing it is meant to show. The ring is printed over the
+// UART by trace_dump() and turned into a timeline on the host with
+// scripts/tracedecode.py. Once full, the oldest records are overwritten.
+//
+// Tracing is compiled in only when TRACE_ENABLED is 1 (cmake -DTRACE=ON, or
+// TRACE=1 for the tests); otherwise TRACE() and trace_dump() compile to nothing.
+
+#ifndef TRACE_ENABLED
+#define TRACE_ENABLED 0
+#endif
+
+// Records in the ring (power of 2)
+#ifndef TRACE_RING_RECORDS
+#define TRACE_RING_RECORDS 1024
+#endif
+
+// Event ids, with what their arguments hold
+#define TRACE_PHASE 1 // Phase index (0xFFFFFFFF: last phase ended), first 4 name characters
+#define TRACE_VIO_READ 2 // First sector, sector count << 8 | request handle
+#define TRACE_VIO_WRITE 3 // First sector, sector count << 8 | request handle
+#define TRACE_VIO_FLUSH 4 // 0, request handle
+#define TRACE_VIO_COMPLETE 5 // Request handle, requests still in flight on its queue
+#define TRACE_FAT_FETCH 6 // First sector, sector count
+#define TRACE_FAT_CLUSTER 7 // First cluster of a contiguous run, clusters in the run
+#define TRACE_FAT_READ 8 // First cluster of the file, file size
+#define TRACE_FATAL 9 // Index of the phase that failed, 0
+#define TRACE_USER 0x100 // First id free for ad hoc events
+
+// Lines framing a dump; the header line also carries the counter frequency
+#define TRACE_DUMP_BEGIN "TRACE BEGIN"
+#define TRACE_DUMP_END "TRACE END"
+
+typedef struct {
+    uint32_t time; // Low 32 bits of CNTVCT_EL0
+    uint16_t event; // TRACE_* id
+    uint16_t cpu; // Core that emitted the record
+    uint32_t arg0;
+    uint32_t arg1;
+} trace_record;
+
+#if TRACE_ENABLED
+
+/**
+ * @brief Appends a record to the ring.
+ *
+ * Safe to call from any core and from IRQ handlers; takes no lock and does
+ * not touch FP/SIMD registers. Use TRACE() instead, so the call disappears
+ * when tracing is compiled out.
+ *
+ * @param event The TRACE_* id.
+ * @param arg0 First argument, see the event id.
+ * @param arg1 Second argument, see the event id.
+ */
+void trace_emit(uint16_t event, uint32_t arg0, uint32_t arg1);
+
+/**
+ * @brief Empties the ring.
+ */
+void trace_reset(void);
+
+/**
+ * @brief Copies the records still in the ring, oldest first.
+ *
+ * @param records Receives up to capacity records.
+ * @param capacity The number of records that fit in records.
+ * @return The number of records copied.
+ */
+uint32_t trace_copy(trace_record* records, uint32_t capacity);
+
+/**
+ * @brief Prints the ring over the UART for scripts/tracedecode.py.
+ *
+ * A TRACE_DUMP_BEGIN line with the counter frequency and the record counts,
+ * one line of 32 hex digits per record (its 16 bytes in memory order), then
+ * a TRACE_DUMP_END line. The ring is left as it is.
+ */
+void trace_dump(void);
+
+#define TRACE(event, arg0, arg1) trace_emit((event), (uint32_t)(arg0), (uint32_t)(arg1))
+
+#else
+
+// Arguments stay type-checked but are never evaluated
+#define TRACE(event, arg0, arg1) do { (void)sizeof(event); (void)sizeof(arg0); (void)sizeof(arg1); } while (0)
+
+static inline void trace_reset(void) {
+}
+
+static inline uint32_t trace_copy(trace_record* records, uint32_t capacity) {
+    (void)records;
+    (void)capacity;
+    return 0;
+}
+
+static inline void trace_dump(void) {
+}
+
+#endif
+
+#endif